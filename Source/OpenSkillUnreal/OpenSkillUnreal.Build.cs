@@ -13,6 +13,7 @@ public class OpenSkillUnreal : ModuleRules
 
 		PrivateIncludePaths.Add(Path.Combine(ModuleDirectory, "Private"));
 
+		// The rating code only needs Core, so the module also links into standalone programs such as OpenSkillWorker.
 		PublicDependencyModuleNames.AddRange(
 			new string[]
 			{
@@ -25,10 +26,6 @@ public class OpenSkillUnreal : ModuleRules
 		PrivateDependencyModuleNames.AddRange(
 			new string[]
 			{
-				"CoreUObject",
-				"Engine",
-				"Slate",
-				"SlateCore",
 				// ... add private dependencies that you statically link with here ...	
 			}
 		);
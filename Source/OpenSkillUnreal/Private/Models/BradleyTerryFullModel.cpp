@@ -1,53 +1,51 @@
-﻿#pragma once
-#include "OpenSkillModeling.h"
-#include "OpenSkillOptions.h"
-#include "OpenSkillTypes.h"
-#include "Containers/Array.h"
-
-TArray<TArray<FOpenSkillRating>> FOpenSkillModeling::BradleyTerryFull(const TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks, const FOpenSkillOptions& Options)
-{
-	const double Kappa = Options.Kappa;
-	const double TwoBetaSq = 2 * FMath::Square(Options.Beta);
-	const TArray<FOpenSkillTeamRating> TeamRatings = GetTeamRatings(Teams, Ranks);
-	const double C = GetC(TeamRatings, Options);
-	const TArray<double> SumQ = GetSumQ(TeamRatings, C);
-	const TArray<double> A = GetA(TeamRatings);
-
-	TArray<TArray<FOpenSkillRating>> Result;
-	Result.Reserve(Teams.Num());
-
-	for (int i = 0; i < TeamRatings.Num(); ++i)
-	{
-		const FOpenSkillTeamRating& TeamI = TeamRatings[i];
-		double IOmega = 0;
-		double IDelta = 0;
-
-		for (int q = 0; q < TeamRatings.Num(); ++q)
-		{
-			if (q == i)
-			{
-				continue;
-			}
-			const FOpenSkillTeamRating& TeamQ = TeamRatings[q];
-
-			const double Ciq = FMath::Sqrt(TeamI.SigmaSq + TeamQ.SigmaSq + TwoBetaSq);
-			const double Piq = 1 / (1 + FMath::Exp((TeamQ.Mu - TeamI.Mu) / Ciq));
-			const double QEta = TeamI.SigmaSq / Ciq;
-			const double IGamma = Options.Gamma(C, TeamRatings.Num(), TeamI.Mu, TeamI.SigmaSq, TeamI.Members, TeamI.Rank);
-
-			IOmega += QEta * (GetScore(TeamQ.Rank, TeamI.Rank) - Piq);
-			IDelta += ((IGamma * QEta) / Ciq) * Piq * (1 - Piq);
-		}
-
-		TArray<FOpenSkillRating> Rated;
-		Rated.Reserve(TeamI.Members.Num());
-		for (const FOpenSkillRating& Member : TeamI.Members)
-		{
-			const double SigmaSq = FMath::Square(Member.Sigma);
-			Rated.Emplace(Member.Mu + (SigmaSq / TeamI.SigmaSq) * IOmega,
-			              Member.Sigma * FMath::Sqrt(FMath::Max(1 - (SigmaSq / TeamI.SigmaSq) * IDelta, Kappa)));
-		}
-		Result.Emplace(MoveTemp(Rated));
-	}
-	return Result;
+﻿#pragma once
+#include "OpenSkillModeling.h"
+#include "OpenSkillCompiledOptions.h"
+#include "OpenSkillTypes.h"
+#include "Containers/Array.h"
+
+TArray<TArray<FOpenSkillRating>> FOpenSkillModeling::BradleyTerryFull(const TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks, const FOpenSkillCompiledOptions& Snapshot)
+{
+	const FOpenSkillOptions& Options = Snapshot.Options;
+	const double Kappa = Options.Kappa;
+	const double TwoBetaSq = Snapshot.TwoBetaSquared;
+	const TArray<FOpenSkillTeamRating> TeamRatings = GetTeamRatings(Teams, Ranks);
+	const double C = GetC(TeamRatings, Snapshot.BetaSquared);
+
+	// Gamma only depends on the team itself here, not on the opponent.
+	TArray<double> Gammas;
+	Gammas.Reserve(TeamRatings.Num());
+	for (const FOpenSkillTeamRating& TeamI : TeamRatings)
+	{
+		Gammas.Add(Options.Gamma(C, TeamRatings.Num(), TeamI.Mu, TeamI.SigmaSq, TeamI.Members, TeamI.Rank));
+	}
+
+	// Each pair shares Ciq and Piq, team Q sees Pqi = 1 - Piq and the complementary score, so its Omega term flips sign.
+	TArray<double> Omega;
+	TArray<double> Delta;
+	AccumulatePairwise(TeamRatings, TwoBetaSq, [&](const int i, const int q, const double Ciq, double& IOmega, double& IDelta, double& QOmega, double& QDelta)
+	{
+		const FOpenSkillTeamRating& TeamI = TeamRatings[i];
+		const FOpenSkillTeamRating& TeamQ = TeamRatings[q];
+
+		double PairOmega;
+		double PairDelta;
+		BradleyTerryPair(TeamI.Mu, TeamQ.Mu, Ciq, TeamI.Rank, TeamQ.Rank, PairOmega, PairDelta);
+
+		const double IEta = TeamI.SigmaSq / Ciq;
+		const double QEta = TeamQ.SigmaSq / Ciq;
+
+		IOmega += IEta * PairOmega;
+		IDelta += ((Gammas[i] * IEta) / Ciq) * PairDelta;
+		QOmega -= QEta * PairOmega;
+		QDelta += ((Gammas[q] * QEta) / Ciq) * PairDelta;
+	}, Omega, Delta);
+
+	TArray<TArray<FOpenSkillRating>> Result;
+	Result.Reserve(Teams.Num());
+	for (int i = 0; i < TeamRatings.Num(); ++i)
+	{
+		Result.Emplace(ApplyTeamUpdate(TeamRatings[i], Omega[i], Delta[i], Kappa));
+	}
+	return Result;
 }
\ No newline at end of file
@@ -0,0 +1,136 @@
+﻿#include "OpenSkillCompiledOptions.h"
+#include "OpenSkillStatistics.h"
+
+namespace OpenSkillCompiledOptions
+{
+	// One per thread that has ever pinned a snapshot, reused once the thread exits and never freed.
+	struct alignas(PLATFORM_CACHE_LINE_SIZE) FReaderSlot
+	{
+		// The epoch the thread's outermost pin was taken in, 0 while it holds none.
+		std::atomic<uint64> Epoch{0};
+		std::atomic<bool> bOwned{true};
+		FReaderSlot* Next = nullptr;
+		// Only touched by the owning thread.
+		int32 Depth = 0;
+	};
+
+	std::atomic<uint64> GlobalEpoch{1};
+	std::atomic<FReaderSlot*> ReaderSlots{nullptr};
+
+	FReaderSlot* ClaimSlot()
+	{
+		for (FReaderSlot* Slot = ReaderSlots.load(std::memory_order_acquire); Slot; Slot = Slot->Next)
+		{
+			bool bExpected = false;
+			if (!Slot->bOwned.load(std::memory_order_relaxed) && Slot->bOwned.compare_exchange_strong(bExpected, true, std::memory_order_acquire))
+			{
+				return Slot;
+			}
+		}
+
+		FReaderSlot* Slot = new FReaderSlot;
+		Slot->Next = ReaderSlots.load(std::memory_order_relaxed);
+		while (!ReaderSlots.compare_exchange_weak(Slot->Next, Slot, std::memory_order_release, std::memory_order_relaxed))
+		{
+		}
+		return Slot;
+	}
+
+	struct FThreadSlot
+	{
+		FReaderSlot* Slot = nullptr;
+
+		~FThreadSlot()
+		{
+			if (Slot)
+			{
+				Slot->bOwned.store(false, std::memory_order_release);
+			}
+		}
+
+		FReaderSlot& Get()
+		{
+			if (!Slot)
+			{
+				Slot = ClaimSlot();
+			}
+			return *Slot;
+		}
+	};
+
+	thread_local FThreadSlot ThreadSlot;
+}
+
+FOpenSkillCompiledOptions::FOpenSkillCompiledOptions(const FOpenSkillOptions& InOptions)
+	: Options(InOptions)
+	, BetaSquared(FMath::Square(InOptions.Beta))
+	, TwoBetaSquared(2 * FMath::Square(InOptions.Beta))
+	, TauSquared(FMath::Square(InOptions.Tau))
+{
+	DrawMarginScales.SetNumZeroed(NumPrecomputedDrawMargins);
+	for (int32 N = 2; N < NumPrecomputedDrawMargins; ++N)
+	{
+		DrawMarginScales[N] = ComputeDrawMarginScale(N);
+	}
+}
+
+double FOpenSkillCompiledOptions::ComputeDrawMarginScale(const int32 NumTeams) const
+{
+	return Options.Beta * FOpenSkillStatistics::PhiMajorInverse((1 + 1.0 / NumTeams) / 2);
+}
+
+FOpenSkillCompiledOptionsPin::FOpenSkillCompiledOptionsPin(const std::atomic<const FOpenSkillCompiledOptions*>& Published)
+{
+	using namespace OpenSkillCompiledOptions;
+
+	// The epoch is published before the pointer is read. A writer that unpublishes the pointer first and then finds this
+	// slot empty or newer knows the read returns the replacement.
+	FReaderSlot& Slot = ThreadSlot.Get();
+	if (Slot.Depth++ == 0)
+	{
+		Slot.Epoch.store(GlobalEpoch.load());
+	}
+	Snapshot = Published.load();
+}
+
+FOpenSkillCompiledOptionsPin::FOpenSkillCompiledOptionsPin(FOpenSkillCompiledOptionsPin&& Other)
+	: Snapshot(Other.Snapshot)
+{
+	Other.Snapshot = nullptr;
+}
+
+FOpenSkillCompiledOptionsPin::~FOpenSkillCompiledOptionsPin()
+{
+	using namespace OpenSkillCompiledOptions;
+
+	if (!Snapshot)
+	{
+		return;
+	}
+	FReaderSlot& Slot = ThreadSlot.Get();
+	check(Slot.Depth > 0)
+	if (--Slot.Depth == 0)
+	{
+		Slot.Epoch.store(0, std::memory_order_release);
+	}
+}
+
+uint64 FOpenSkillCompiledOptionsPin::Retire()
+{
+	return OpenSkillCompiledOptions::GlobalEpoch.fetch_add(1);
+}
+
+bool FOpenSkillCompiledOptionsPin::CanReclaim(const uint64 RetiredEpoch)
+{
+	using namespace OpenSkillCompiledOptions;
+
+	for (const FReaderSlot* Slot = ReaderSlots.load(std::memory_order_acquire); Slot; Slot = Slot->Next)
+	{
+		const uint64 Epoch = Slot->Epoch.load();
+		if (Epoch != 0 && Epoch <= RetiredEpoch)
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,352 @@
+﻿#include "OpenSkillIngestion.h"
+#include "OpenSkillSimulation.h"
+#include "OpenSkillUnreal.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogOpenSkillIngestion, Log, All);
+
+namespace OpenSkillIngestion
+{
+	// How many players ahead of the current one a bucket or rating is prefetched, enough to cover a miss to memory.
+	constexpr int32 PrefetchDistance = 16;
+	constexpr int32 MinBuckets = 64;
+
+	// Real player IDs are not small dense numbers, spread the simulation's indices over the whole 64 bit range.
+	FOpenSkillPlayerId MakePlayerId(const int32 Player)
+	{
+		uint64 Id = static_cast<uint64>(Player) + 1;
+		Id ^= Id >> 33;
+		Id *= 0xFF51AFD7ED558CCDull;
+		Id ^= Id >> 33;
+		return Id;
+	}
+
+	void Compare(const TArray<FString>& Args)
+	{
+		FOpenSkillSimulationConfig Config = FOpenSkillSimulationConfig::FiveVersusFive();
+		if (Args.Num() > 0 && !FOpenSkillSimulationConfig::FromName(Args[0], Config))
+		{
+			UE_LOG(LogOpenSkillIngestion, Error, TEXT("Unknown match format '%s', expected 1v1, 5v5, Squads or FFA."), *Args[0]);
+			return;
+		}
+		const int32 WindowSize = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 1024;
+		// Big enough for the table to be far out of cache.
+		Config.PopulationSize = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 2 * Config.NumTeams * Config.TeamSize) : 4000000;
+		Config.NumMatches = FMath::Max(Config.NumMatches, 200000);
+
+		const FOpenSkillSimulation Simulation(Config);
+		FOpenSkillUnrealModule Module;
+		const FOpenSkillRating DefaultRating = Module.GetDefaultRating();
+		FOpenSkillRatingTable PipelineTable(DefaultRating);
+		FOpenSkillRatingTable DirectTable(DefaultRating);
+		PipelineTable.Reserve(Config.PopulationSize);
+		DirectTable.Reserve(Config.PopulationSize);
+		for (int32 Player = 0; Player < Config.PopulationSize; ++Player)
+		{
+			PipelineTable.FindOrAdd(MakePlayerId(Player));
+			DirectTable.FindOrAdd(MakePlayerId(Player));
+		}
+
+		TArray<TArray<TTuple<TArray<FOpenSkillPlayerId>, int>>> Matches;
+		Matches.SetNum(Config.NumMatches);
+		for (int32 Match = 0; Match < Config.NumMatches; ++Match)
+		{
+			const TArrayView<const int32> Players = Simulation.GetMatchPlayers(Match);
+			for (int32 Team = 0; Team < Config.NumTeams; ++Team)
+			{
+				TArray<FOpenSkillPlayerId> Ids;
+				for (const int32 Player : Players.Slice(Team * Config.TeamSize, Config.TeamSize))
+				{
+					Ids.Add(MakePlayerId(Player));
+				}
+				Matches[Match].Emplace(MoveTemp(Ids), Team);
+			}
+		}
+
+		// One lookup per player to build RateByRank's arrays, then one scattered write per player.
+		double StartTime = FPlatformTime::Seconds();
+		for (const TArray<TTuple<TArray<FOpenSkillPlayerId>, int>>& Match : Matches)
+		{
+			TArray<TTuple<TArray<FOpenSkillRating>, int>> Teams;
+			for (const TTuple<TArray<FOpenSkillPlayerId>, int>& Team : Match)
+			{
+				TArray<FOpenSkillRating> Members;
+				for (const FOpenSkillPlayerId Player : Team.Key)
+				{
+					Members.Add(DirectTable.GetRating(DirectTable.Find(Player)));
+				}
+				Teams.Emplace(MoveTemp(Members), Team.Value);
+			}
+			const TArray<TArray<FOpenSkillRating>> Rated = Module.RateByRank(MoveTemp(Teams));
+			for (int32 Team = 0; Team < Match.Num(); ++Team)
+			{
+				for (int32 Member = 0; Member < Match[Team].Key.Num(); ++Member)
+				{
+					DirectTable.GetRating(DirectTable.Find(Match[Team].Key[Member])) = Rated[Team][Member];
+				}
+			}
+		}
+		const double DirectSeconds = FPlatformTime::Seconds() - StartTime;
+
+		FOpenSkillIngestion Ingestion(Module);
+		FOpenSkillMatchWindow Window;
+		StartTime = FPlatformTime::Seconds();
+		for (int32 First = 0; First < Matches.Num(); First += WindowSize)
+		{
+			Window.Reset();
+			for (int32 Match = First; Match < FMath::Min(First + WindowSize, Matches.Num()); ++Match)
+			{
+				Window.AddMatch(Matches[Match]);
+			}
+			Ingestion.RateWindow(Window, PipelineTable);
+		}
+		const double PipelineSeconds = FPlatformTime::Seconds() - StartTime;
+
+		double MaxDifference = 0;
+		for (int32 Player = 0; Player < Config.PopulationSize; ++Player)
+		{
+			const FOpenSkillRating& Lhs = PipelineTable.GetRating(PipelineTable.Find(MakePlayerId(Player)));
+			const FOpenSkillRating& Rhs = DirectTable.GetRating(DirectTable.Find(MakePlayerId(Player)));
+			MaxDifference = FMath::Max(MaxDifference, FMath::Max(FMath::Abs(Lhs.Mu - Rhs.Mu), FMath::Abs(Lhs.Sigma - Rhs.Sigma)));
+		}
+
+		const FOpenSkillIngestionStats& Stats = Ingestion.GetStats();
+		UE_LOG(LogOpenSkillIngestion, Display, TEXT("%d matches over %d players: per player lookups %.0f matches/s, windows of %d %.0f matches/s, %.1fx faster, max difference %g"),
+		       Config.NumMatches, Config.PopulationSize, DirectSeconds > 0 ? Config.NumMatches / DirectSeconds : 0.0, WindowSize,
+		       PipelineSeconds > 0 ? Config.NumMatches / PipelineSeconds : 0.0, PipelineSeconds > 0 ? DirectSeconds / PipelineSeconds : 0.0, MaxDifference);
+		UE_LOG(LogOpenSkillIngestion, Display, TEXT("Resolve %.3fs, gather %.3fs, rate %.3fs, scatter %.3fs, %.2f appearances per distinct player"),
+		       Stats.ResolveSeconds, Stats.GatherSeconds, Stats.RateSeconds, Stats.ScatterSeconds,
+		       Stats.UniquePlayers > 0 ? static_cast<double>(Stats.Appearances) / Stats.UniquePlayers : 0.0);
+	}
+
+	FAutoConsoleCommand CompareCommand(
+		TEXT("OpenSkill.Ingest"),
+		TEXT("Rate ID keyed matches through the windowed ingestion stage and with a table lookup per player. Usage: OpenSkill.Ingest [1v1|5v5|Squads|FFA] [WindowSize] [Population]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&Compare));
+}
+
+FOpenSkillRatingTable::FOpenSkillRatingTable(const FOpenSkillRating& InDefaultRating)
+	: DefaultRating(InDefaultRating)
+{
+	Rehash(OpenSkillIngestion::MinBuckets);
+}
+
+void FOpenSkillRatingTable::Reserve(const int32 NumPlayers)
+{
+	Ratings.Reserve(NumPlayers);
+	Players.Reserve(NumPlayers);
+	ReserveIndex(NumPlayers);
+}
+
+int32 FOpenSkillRatingTable::Find(const FOpenSkillPlayerId Player) const
+{
+	const uint32 Mask = Buckets.Num() - 1;
+	for (uint32 Index = GetBucketIndex(Player);; Index = (Index + 1) & Mask)
+	{
+		const FBucket& Bucket = Buckets[Index];
+		if (Bucket.Slot == INDEX_NONE || Bucket.Player == Player)
+		{
+			return Bucket.Slot;
+		}
+	}
+}
+
+int32 FOpenSkillRatingTable::FindOrAdd(const FOpenSkillPlayerId Player)
+{
+	ReserveIndex(Num() + 1);
+	return FindOrAddInIndex(Player);
+}
+
+void FOpenSkillRatingTable::FindOrAddBatch(TArrayView<const FOpenSkillPlayerId> InPlayers, TArrayView<int32> OutSlots)
+{
+	using namespace OpenSkillIngestion;
+	check(InPlayers.Num() == OutSlots.Num())
+
+	// Grow up front so no bucket moves while its prefetch is in flight.
+	ReserveIndex(Num() + InPlayers.Num());
+	const int32 NumPlayers = InPlayers.Num();
+	for (int32 i = 0; i < FMath::Min(PrefetchDistance, NumPlayers); ++i)
+	{
+		FPlatformMisc::Prefetch(&Buckets[GetBucketIndex(InPlayers[i])]);
+	}
+	for (int32 i = 0; i < NumPlayers; ++i)
+	{
+		if (i + PrefetchDistance < NumPlayers)
+		{
+			FPlatformMisc::Prefetch(&Buckets[GetBucketIndex(InPlayers[i + PrefetchDistance])]);
+		}
+		OutSlots[i] = FindOrAddInIndex(InPlayers[i]);
+	}
+}
+
+int32 FOpenSkillRatingTable::FindOrAddInIndex(const FOpenSkillPlayerId Player)
+{
+	const uint32 Mask = Buckets.Num() - 1;
+	for (uint32 Index = GetBucketIndex(Player);; Index = (Index + 1) & Mask)
+	{
+		FBucket& Bucket = Buckets[Index];
+		if (Bucket.Slot == INDEX_NONE)
+		{
+			Bucket.Player = Player;
+			Bucket.Slot = Ratings.Add(DefaultRating);
+			Players.Add(Player);
+			return Bucket.Slot;
+		}
+		if (Bucket.Player == Player)
+		{
+			return Bucket.Slot;
+		}
+	}
+}
+
+void FOpenSkillRatingTable::ReserveIndex(const int32 NumPlayers)
+{
+	if (static_cast<int64>(NumPlayers) * 2 > Buckets.Num())
+	{
+		Rehash(static_cast<int32>(FMath::RoundUpToPowerOfTwo(static_cast<uint32>(NumPlayers) * 2)));
+	}
+}
+
+void FOpenSkillRatingTable::Rehash(const int32 NumBuckets)
+{
+	check(FMath::IsPowerOfTwo(NumBuckets))
+	Buckets.Reset();
+	Buckets.Init(FBucket{0, INDEX_NONE}, NumBuckets);
+	BucketShift = 64 - FMath::FloorLog2(static_cast<uint32>(NumBuckets));
+
+	const uint32 Mask = NumBuckets - 1;
+	for (int32 Slot = 0; Slot < Players.Num(); ++Slot)
+	{
+		uint32 Index = GetBucketIndex(Players[Slot]);
+		while (Buckets[Index].Slot != INDEX_NONE)
+		{
+			Index = (Index + 1) & Mask;
+		}
+		Buckets[Index] = FBucket{Players[Slot], Slot};
+	}
+}
+
+void FOpenSkillMatchWindow::AddMatch(const TArray<TTuple<TArray<FOpenSkillPlayerId>, int>>& Teams)
+{
+#if DO_CHECK
+	// Every appearance is rated from the same prior, a player listed twice would only keep one of the updates.
+	TSet<FOpenSkillPlayerId> MatchPlayers;
+	for (const TTuple<TArray<FOpenSkillPlayerId>, int>& Team : Teams)
+	{
+		for (const FOpenSkillPlayerId Player : Team.Key)
+		{
+			checkf(!MatchPlayers.Contains(Player), TEXT("Player %llu appears more than once in the match"), Player)
+			MatchPlayers.Add(Player);
+		}
+	}
+#endif
+
+	for (const TTuple<TArray<FOpenSkillPlayerId>, int>& Team : Teams)
+	{
+		TeamPlayers.Append(Team.Key);
+		TeamOffsets.Add(TeamPlayers.Num());
+		TeamRanks.Add(Team.Value);
+	}
+	MatchOffsets.Add(GetNumTeams());
+}
+
+FOpenSkillIngestion::FOpenSkillIngestion(const FOpenSkillUnrealModule& InModule)
+	: Module(InModule)
+{
+}
+
+void FOpenSkillIngestion::RateWindow(const FOpenSkillMatchWindow& Window, FOpenSkillRatingTable& Table)
+{
+	using namespace OpenSkillIngestion;
+
+	const int32 NumAppearances = Window.TeamPlayers.Num();
+	if (NumAppearances == 0)
+	{
+		return;
+	}
+
+	// Resolve every appearance, then sort by slot so each distinct player is gathered once however often they played.
+	double StartTime = FPlatformTime::Seconds();
+	AppearanceSlots.SetNumUninitialized(NumAppearances);
+	Table.FindOrAddBatch(Window.TeamPlayers, AppearanceSlots);
+	SortKeys.SetNumUninitialized(NumAppearances);
+	for (int32 i = 0; i < NumAppearances; ++i)
+	{
+		SortKeys[i] = static_cast<uint64>(AppearanceSlots[i]) << 32 | static_cast<uint32>(i);
+	}
+	SortKeys.Sort();
+	UniqueSlots.Reset();
+	AppearanceToUnique.SetNumUninitialized(NumAppearances);
+	for (const uint64 Key : SortKeys)
+	{
+		const int32 Slot = static_cast<int32>(Key >> 32);
+		if (UniqueSlots.Num() == 0 || UniqueSlots.Last() != Slot)
+		{
+			UniqueSlots.Add(Slot);
+		}
+		AppearanceToUnique[static_cast<uint32>(Key)] = UniqueSlots.Num() - 1;
+	}
+	const int32 NumUnique = UniqueSlots.Num();
+	double EndTime = FPlatformTime::Seconds();
+	Stats.ResolveSeconds += EndTime - StartTime;
+
+	// Gather in slot order, the table is walked front to back a prefetch ahead.
+	StartTime = EndTime;
+	Buffer.SetNumUninitialized(NumUnique);
+	for (int32 i = 0; i < NumUnique; ++i)
+	{
+		if (i + PrefetchDistance < NumUnique)
+		{
+			FPlatformMisc::Prefetch(&Table.GetRating(UniqueSlots[i + PrefetchDistance]));
+		}
+		Buffer[i] = Table.GetRating(UniqueSlots[i]);
+	}
+	EndTime = FPlatformTime::Seconds();
+	Stats.GatherSeconds += EndTime - StartTime;
+
+	// Rate in window order against the buffer.
+	StartTime = EndTime;
+	for (int32 Match = 0; Match < Window.GetNumMatches(); ++Match)
+	{
+		const int32 FirstTeam = Window.MatchOffsets[Match];
+		const int32 LastTeam = Window.MatchOffsets[Match + 1];
+		const int32 FirstAppearance = Window.TeamOffsets[FirstTeam];
+		const int32 NumMatchAppearances = Window.TeamOffsets[LastTeam] - FirstAppearance;
+
+		MatchRatings.SetNumUninitialized(NumMatchAppearances);
+		for (int32 i = 0; i < NumMatchAppearances; ++i)
+		{
+			MatchRatings[i] = Buffer[AppearanceToUnique[FirstAppearance + i]];
+		}
+		MatchTeams.Reset();
+		for (int32 Team = FirstTeam; Team < LastTeam; ++Team)
+		{
+			MatchTeams.Emplace(MatchRatings.GetData() + Window.TeamOffsets[Team] - FirstAppearance, Window.TeamOffsets[Team + 1] - Window.TeamOffsets[Team]);
+		}
+		Module.RateInPlace(MatchTeams, TArrayView<const int>(Window.TeamRanks.GetData() + FirstTeam, LastTeam - FirstTeam));
+		for (int32 i = 0; i < NumMatchAppearances; ++i)
+		{
+			Buffer[AppearanceToUnique[FirstAppearance + i]] = MatchRatings[i];
+		}
+	}
+	EndTime = FPlatformTime::Seconds();
+	Stats.RateSeconds += EndTime - StartTime;
+
+	// Scatter, the same walk as the gather.
+	StartTime = EndTime;
+	for (int32 i = 0; i < NumUnique; ++i)
+	{
+		if (i + PrefetchDistance < NumUnique)
+		{
+			FPlatformMisc::Prefetch(&Table.GetRating(UniqueSlots[i + PrefetchDistance]));
+		}
+		Table.GetRating(UniqueSlots[i]) = Buffer[i];
+	}
+	EndTime = FPlatformTime::Seconds();
+	Stats.ScatterSeconds += EndTime - StartTime;
+
+	++Stats.Windows;
+	Stats.Matches += Window.GetNumMatches();
+	Stats.Appearances += NumAppearances;
+	Stats.UniquePlayers += NumUnique;
+}
@@ -0,0 +1,162 @@
+﻿#include "OpenSkillInvalidation.h"
+#include "OpenSkillMatchHistory.h"
+#include "OpenSkillUnreal.h"
+
+FOpenSkillInvalidation::FOpenSkillInvalidation(const FOpenSkillMatchHistory& InHistory, const FOpenSkillUnrealModule& InModule, const double InTolerance)
+	: History(InHistory)
+	, Module(InModule)
+	, Tolerance(InTolerance)
+{
+	const int32 NumSlots = History.GetNumSlots();
+	Voided.SetNumZeroed(History.Num());
+	SlotMatches.SetNumUninitialized(NumSlots);
+	PrevSlot.SetNumUninitialized(NumSlots);
+	NextSlot.SetNumUninitialized(NumSlots);
+	Pre.SetNumZeroed(NumSlots);
+	Post.SetNumZeroed(NumSlots);
+	LastSlot.Init(INDEX_NONE, History.GetNumPlayers());
+
+	for (int Match = 0; Match < History.Num(); ++Match)
+	{
+		const TArrayView<const int32> Players = History.GetMatchPlayers(Match);
+		const int32 FirstSlot = History.GetFirstSlot(Match);
+		for (int i = 0; i < Players.Num(); ++i)
+		{
+			const int32 Slot = FirstSlot + i;
+			int32& PlayerLastSlot = LastSlot[Players[i]];
+			SlotMatches[Slot] = Match;
+			PrevSlot[Slot] = PlayerLastSlot;
+			NextSlot[Slot] = INDEX_NONE;
+			if (PlayerLastSlot != INDEX_NONE)
+			{
+				NextSlot[PlayerLastSlot] = Slot;
+			}
+			PlayerLastSlot = Slot;
+		}
+	}
+
+	const FOpenSkillCompiledOptionsPin Snapshot = Module.GetCompiledOptions();
+	TArray<bool> Changed;
+	for (int Match = 0; Match < History.Num(); ++Match)
+	{
+		RateMatch(Match, Snapshot->Options, Changed);
+	}
+}
+
+int32 FOpenSkillInvalidation::VoidMatches(TArrayView<const int32> Matches, TArray<int32>& OutAffectedPlayers)
+{
+	return SetVoided(Matches, true, OutAffectedPlayers);
+}
+
+int32 FOpenSkillInvalidation::RestoreMatches(TArrayView<const int32> Matches, TArray<int32>& OutAffectedPlayers)
+{
+	return SetVoided(Matches, false, OutAffectedPlayers);
+}
+
+FOpenSkillRating FOpenSkillInvalidation::GetRating(const int32 Player) const
+{
+	if (Player >= LastSlot.Num() || LastSlot[Player] == INDEX_NONE)
+	{
+		return Module.GetDefaultRating();
+	}
+	return Post[LastSlot[Player]];
+}
+
+int32 FOpenSkillInvalidation::SetVoided(TArrayView<const int32> Matches, const bool bVoided, TArray<int32>& OutAffectedPlayers)
+{
+	OutAffectedPlayers.Reset();
+
+	// Matches still to be rated again, popped in history order so every match sees its players' repaired ratings.
+	TArray<int32> Pending;
+	TSet<int32> Queued;
+	const auto Earlier = [](const int32 Lhs, const int32 Rhs)
+	{
+		return Lhs < Rhs;
+	};
+	for (const int32 Match : Matches)
+	{
+		if (Voided[Match] != bVoided && !Queued.Contains(Match))
+		{
+			Voided[Match] = bVoided;
+			Queued.Add(Match);
+			Pending.HeapPush(Match, Earlier);
+		}
+	}
+
+	const FOpenSkillCompiledOptionsPin Snapshot = Module.GetCompiledOptions();
+	TSet<int32> Affected;
+	TArray<bool> Changed;
+	int32 NumVisited = 0;
+	while (Pending.Num() > 0)
+	{
+		int32 Match;
+		Pending.HeapPop(Match, Earlier);
+		RateMatch(Match, Snapshot->Options, Changed);
+		++NumVisited;
+
+		// Only players whose result moved carry the change on to their next match.
+		const TArrayView<const int32> Players = History.GetMatchPlayers(Match);
+		const int32 FirstSlot = History.GetFirstSlot(Match);
+		for (int i = 0; i < Players.Num(); ++i)
+		{
+			if (!Changed[i])
+			{
+				continue;
+			}
+			if (!Affected.Contains(Players[i]))
+			{
+				Affected.Add(Players[i]);
+				OutAffectedPlayers.Add(Players[i]);
+			}
+			const int32 Next = NextSlot[FirstSlot + i];
+			if (Next != INDEX_NONE && !Queued.Contains(SlotMatches[Next]))
+			{
+				Queued.Add(SlotMatches[Next]);
+				Pending.HeapPush(SlotMatches[Next], Earlier);
+			}
+		}
+	}
+	return NumVisited;
+}
+
+void FOpenSkillInvalidation::RateMatch(const int32 Match, const FOpenSkillOptions& Options, TArray<bool>& OutChanged)
+{
+	const int32 FirstSlot = History.GetFirstSlot(Match);
+	const int32 NumSlots = History.GetMatchPlayers(Match).Num();
+
+	TArray<FOpenSkillRating> Ratings;
+	Ratings.SetNumUninitialized(NumSlots);
+	for (int i = 0; i < NumSlots; ++i)
+	{
+		const int32 Prev = PrevSlot[FirstSlot + i];
+		Pre[FirstSlot + i] = Prev == INDEX_NONE ? FOpenSkillRating(Options.Mu, Options.Sigma) : Post[Prev];
+		Ratings[i] = Pre[FirstSlot + i];
+	}
+
+	// A voided match leaves its players as it found them.
+	if (!Voided[Match])
+	{
+		const int32 NumTeams = History.GetNumTeams(Match);
+		TArray<TArrayView<FOpenSkillRating>> Teams;
+		TArray<int> Ranks;
+		Teams.Reserve(NumTeams);
+		Ranks.Reserve(NumTeams);
+		int32 Offset = 0;
+		for (int Team = 0; Team < NumTeams; ++Team)
+		{
+			const int32 TeamSize = History.GetTeamPlayers(Match, Team).Num();
+			Teams.Emplace(Ratings.GetData() + Offset, TeamSize);
+			Ranks.Add(History.GetTeamRank(Match, Team));
+			Offset += TeamSize;
+		}
+		Module.RateInPlace(Teams, Ranks);
+	}
+
+	OutChanged.SetNumUninitialized(NumSlots);
+	for (int i = 0; i < NumSlots; ++i)
+	{
+		FOpenSkillRating& Result = Post[FirstSlot + i];
+		OutChanged[i] = FMath::Abs(Result.Mu - Ratings[i].Mu) > Tolerance || FMath::Abs(Result.Sigma - Ratings[i].Sigma) > Tolerance;
+		Result = Ratings[i];
+	}
+}
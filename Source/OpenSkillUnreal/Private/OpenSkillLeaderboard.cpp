@@ -0,0 +1,184 @@
+﻿#include "OpenSkillLeaderboard.h"
+#include "Async/ParallelFor.h"
+#include "Runtime/Launch/Resources/Version.h"
+
+namespace OpenSkillLeaderboard
+{
+	constexpr int RadixBits = 8;
+	constexpr int RadixBuckets = 1 << RadixBits;
+	constexpr int RadixPasses = 64 / RadixBits;
+	// Below this many keys per chunk the histogram/scatter passes are not worth spreading over threads.
+	constexpr int MinKeysPerChunk = 1 << 16;
+
+	// Map an ordinal to an unsigned key whose ascending order is the descending order of the ordinals.
+	FORCEINLINE uint64 MakeDescendingKey(const double Ordinal)
+	{
+		uint64 Bits;
+		FMemory::Memcpy(&Bits, &Ordinal, sizeof(Bits));
+		const uint64 Ascending = (Bits & (1ull << 63)) ? ~Bits : Bits | (1ull << 63);
+		return ~Ascending;
+	}
+}
+
+void FOpenSkillLeaderboard::ComputeOrdinals(TArrayView<const double> Mu, TArrayView<const double> Sigma, const double Z, TArrayView<double> OutOrdinals)
+{
+	check(Mu.Num() == Sigma.Num() && Mu.Num() == OutOrdinals.Num())
+	const int N = Mu.Num();
+	const double* MuData = Mu.GetData();
+	const double* SigmaData = Sigma.GetData();
+	double* OutData = OutOrdinals.GetData();
+
+	int i = 0;
+#if ENGINE_MAJOR_VERSION >= 5
+	const VectorRegister4Double ZVec = VectorSetFloat1(Z);
+	for (; i + 4 <= N; i += 4)
+	{
+		const VectorRegister4Double MuVec = VectorLoad(MuData + i);
+		const VectorRegister4Double SigmaVec = VectorLoad(SigmaData + i);
+		VectorStore(VectorSubtract(MuVec, VectorMultiply(ZVec, SigmaVec)), OutData + i);
+	}
+#else
+	// UE4 vector registers are single precision only, unroll and let the compiler pack the doubles.
+	for (; i + 4 <= N; i += 4)
+	{
+		OutData[i + 0] = MuData[i + 0] - Z * SigmaData[i + 0];
+		OutData[i + 1] = MuData[i + 1] - Z * SigmaData[i + 1];
+		OutData[i + 2] = MuData[i + 2] - Z * SigmaData[i + 2];
+		OutData[i + 3] = MuData[i + 3] - Z * SigmaData[i + 3];
+	}
+#endif
+	for (; i < N; ++i)
+	{
+		OutData[i] = MuData[i] - Z * SigmaData[i];
+	}
+}
+
+void FOpenSkillLeaderboard::SortByOrdinal(TArrayView<const double> Ordinals, TArray<int32>& OutPermutation)
+{
+	using namespace OpenSkillLeaderboard;
+
+	const int N = Ordinals.Num();
+	OutPermutation.SetNumUninitialized(N);
+	if (N == 0)
+	{
+		return;
+	}
+
+	const int NumChunks = FMath::Clamp(N / MinKeysPerChunk, 1, FPlatformMisc::NumberOfCoresIncludingHyperthreads());
+	const int ChunkSize = FMath::DivideAndRoundUp(N, NumChunks);
+
+	TArray<uint64> Keys;
+	TArray<uint64> KeysScratch;
+	TArray<int32> IndexScratch;
+	Keys.SetNumUninitialized(N);
+	KeysScratch.SetNumUninitialized(N);
+	IndexScratch.SetNumUninitialized(N);
+
+	ParallelFor(NumChunks, [&](const int Chunk)
+	{
+		const int Begin = Chunk * ChunkSize;
+		const int End = FMath::Min(Begin + ChunkSize, N);
+		for (int i = Begin; i < End; ++i)
+		{
+			Keys[i] = MakeDescendingKey(Ordinals[i]);
+			OutPermutation[i] = i;
+		}
+	});
+
+	// Chunk-major histograms, Histograms[Chunk * RadixBuckets + Digit].
+	TArray<int32> Histograms;
+	Histograms.SetNumUninitialized(NumChunks * RadixBuckets);
+
+	uint64* SrcKeys = Keys.GetData();
+	uint64* DstKeys = KeysScratch.GetData();
+	int32* SrcIndices = OutPermutation.GetData();
+	int32* DstIndices = IndexScratch.GetData();
+
+	for (int Pass = 0; Pass < RadixPasses; ++Pass)
+	{
+		const int Shift = Pass * RadixBits;
+
+		ParallelFor(NumChunks, [&](const int Chunk)
+		{
+			int32* Histogram = Histograms.GetData() + Chunk * RadixBuckets;
+			FMemory::Memzero(Histogram, RadixBuckets * sizeof(int32));
+			const int Begin = Chunk * ChunkSize;
+			const int End = FMath::Min(Begin + ChunkSize, N);
+			for (int i = Begin; i < End; ++i)
+			{
+				Histogram[(SrcKeys[i] >> Shift) & (RadixBuckets - 1)]++;
+			}
+		});
+
+		// Turn the counts into exclusive offsets, digit-major so each chunk scatters into its own stable sub-range.
+		bool bSingleDigit = false;
+		int32 Offset = 0;
+		for (int Digit = 0; Digit < RadixBuckets; ++Digit)
+		{
+			int32 DigitCount = 0;
+			for (int Chunk = 0; Chunk < NumChunks; ++Chunk)
+			{
+				int32& Slot = Histograms[Chunk * RadixBuckets + Digit];
+				const int32 Count = Slot;
+				Slot = Offset;
+				Offset += Count;
+				DigitCount += Count;
+			}
+			bSingleDigit |= DigitCount == N;
+		}
+		if (bSingleDigit)
+		{
+			// Every key shares this digit, the pass would not move anything.
+			continue;
+		}
+
+		ParallelFor(NumChunks, [&](const int Chunk)
+		{
+			int32* Offsets = Histograms.GetData() + Chunk * RadixBuckets;
+			const int Begin = Chunk * ChunkSize;
+			const int End = FMath::Min(Begin + ChunkSize, N);
+			for (int i = Begin; i < End; ++i)
+			{
+				const int32 Destination = Offsets[(SrcKeys[i] >> Shift) & (RadixBuckets - 1)]++;
+				DstKeys[Destination] = SrcKeys[i];
+				DstIndices[Destination] = SrcIndices[i];
+			}
+		});
+		Swap(SrcKeys, DstKeys);
+		Swap(SrcIndices, DstIndices);
+	}
+
+	if (SrcIndices != OutPermutation.GetData())
+	{
+		FMemory::Memcpy(OutPermutation.GetData(), SrcIndices, N * sizeof(int32));
+	}
+}
+
+void FOpenSkillLeaderboard::AssignTiers(TArrayView<const int32> Permutation, TArrayView<const double> TierPercentiles, TArrayView<uint8> OutTiers)
+{
+	check(Permutation.Num() == OutTiers.Num())
+	check(TierPercentiles.Num() > 0 && TierPercentiles.Num() <= MAX_uint8 + 1)
+	const int N = Permutation.Num();
+
+	// Walk from the top of the leaderboard down, the percentile only ever decreases so the tier does too.
+	int Tier = TierPercentiles.Num() - 1;
+	for (int Position = 0; Position < N; ++Position)
+	{
+		const double Percentile = static_cast<double>(N - 1 - Position) / N;
+		while (Tier > 0 && Percentile < TierPercentiles[Tier])
+		{
+			--Tier;
+		}
+		OutTiers[Permutation[Position]] = static_cast<uint8>(Tier);
+	}
+}
+
+void FOpenSkillLeaderboard::Build(TArrayView<const double> Mu, TArrayView<const double> Sigma, const double Z, TArrayView<const double> TierPercentiles,
+                                  TArray<double>& OutOrdinals, TArray<int32>& OutPermutation, TArray<uint8>& OutTiers)
+{
+	OutOrdinals.SetNumUninitialized(Mu.Num());
+	OutTiers.SetNumUninitialized(Mu.Num());
+	ComputeOrdinals(Mu, Sigma, Z, OutOrdinals);
+	SortByOrdinal(OutOrdinals, OutPermutation);
+	AssignTiers(OutPermutation, TierPercentiles, OutTiers);
+}
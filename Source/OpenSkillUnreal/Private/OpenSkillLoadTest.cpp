@@ -0,0 +1,381 @@
+﻿#include "OpenSkillLoadTest.h"
+#include "OpenSkillUnreal.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Math/RandomStream.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogOpenSkillLoadTest, Log, All);
+
+namespace OpenSkillLoadTest
+{
+	constexpr int32 NumOperations = static_cast<int32>(EOpenSkillLoadTestOperation::Count);
+
+	// Time given to every thread to start before the first scheduled request.
+	constexpr double StartDelaySeconds = 0.05;
+
+	void LoadTest(const TArray<FString>& Args)
+	{
+		FOpenSkillLoadTestConfig Config;
+		if (Args.Num() > 0 && !FOpenSkillSimulationConfig::FromName(Args[0], Config.Match))
+		{
+			UE_LOG(LogOpenSkillLoadTest, Error, TEXT("Unknown match format '%s', expected 1v1, 5v5, Squads or FFA."), *Args[0]);
+			return;
+		}
+		if (Args.Num() > 1)
+		{
+			Config.NumThreads = FMath::Max(FCString::Atoi(*Args[1]), 1);
+		}
+		if (Args.Num() > 2)
+		{
+			Config.RequestsPerSecond = FMath::Max(FCString::Atod(*Args[2]), 1.0);
+		}
+		if (Args.Num() > 3)
+		{
+			Config.DurationSeconds = FMath::Max(FCString::Atod(*Args[3]), 0.1);
+		}
+
+		const FOpenSkillLoadTestReport Report = FOpenSkillLoadTest::Run(FOpenSkillUnrealModule::Get(), Config);
+		FOpenSkillLoadTest::LogReport(Report);
+	}
+
+	FAutoConsoleCommand LoadTestCommand(
+		TEXT("OpenSkill.LoadTest"),
+		TEXT("Rate and predict from many threads at a fixed request rate and report latency percentiles. Usage: OpenSkill.LoadTest [1v1|5v5|Squads|FFA] [Threads] [RequestsPerSecond] [Seconds]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&LoadTest));
+}
+
+class FOpenSkillLoadTestWorker : public FRunnable
+{
+public:
+	FOpenSkillLoadTestWorker(const FOpenSkillUnrealModule& InModule, const FOpenSkillLoadTestConfig& InConfig, const int32 InIndex, const uint64 InStartCycles)
+		: Module(InModule)
+		, Config(InConfig)
+		, Index(InIndex)
+		, StartCycles(InStartCycles)
+		, Random(InConfig.Match.Seed + InIndex)
+	{
+		Ratings.Init(Module.GetDefaultRating(), Config.Match.PopulationSize);
+		Latencies.SetNum(OpenSkillLoadTest::NumOperations);
+		LastMatch.Init(INDEX_NONE, Config.Match.PopulationSize);
+		Thread = FRunnableThread::Create(this, *FString::Printf(TEXT("OpenSkillLoadTest%d"), Index));
+	}
+
+	virtual ~FOpenSkillLoadTestWorker() override
+	{
+		delete Thread;
+	}
+
+	void Wait()
+	{
+		Thread->WaitForCompletion();
+	}
+
+	virtual uint32 Run() override
+	{
+		const double SecondsPerCycle = FPlatformTime::GetSecondsPerCycle64();
+		// Every thread runs the same schedule, offset from the others so the requests are spread evenly over time.
+		const double IntervalCycles = Config.NumThreads / Config.RequestsPerSecond / SecondsPerCycle;
+		const double PhaseCycles = IntervalCycles * Index / Config.NumThreads;
+		const uint64 EndCycles = StartCycles + static_cast<uint64>(Config.DurationSeconds / SecondsPerCycle);
+
+		double TotalWeight = 0;
+		for (const double Weight : Config.Weights)
+		{
+			TotalWeight += FMath::Max(Weight, 0.0);
+		}
+		if (TotalWeight <= 0)
+		{
+			return 0;
+		}
+
+		const int32 NumScheduled = FMath::Max(static_cast<int32>(FMath::CeilToDouble((EndCycles - StartCycles - PhaseCycles) / IntervalCycles)), 0);
+		for (int32 Request = 0; Request < NumScheduled; ++Request)
+		{
+			const uint64 Scheduled = StartCycles + static_cast<uint64>(PhaseCycles + Request * IntervalCycles);
+			if (FPlatformTime::Cycles64() >= EndCycles)
+			{
+				// Too far behind to catch up before the end, the rest of the schedule is never sent.
+				Missed = NumScheduled - Request;
+				break;
+			}
+
+			// The request is built before its slot comes up so only the module call itself is on the clock.
+			const EOpenSkillLoadTestOperation Operation = PickOperation(TotalWeight);
+			MakeMatch(Request);
+
+			for (uint64 Now = FPlatformTime::Cycles64(); Now < Scheduled; Now = FPlatformTime::Cycles64())
+			{
+				const double Remaining = (Scheduled - Now) * SecondsPerCycle;
+				if (Remaining > 0.002)
+				{
+					FPlatformProcess::SleepNoStats(static_cast<float>(Remaining - 0.001));
+				}
+				else
+				{
+					FPlatformProcess::YieldThread();
+				}
+			}
+
+			Execute(Operation);
+			const uint64 Finished = FPlatformTime::Cycles64();
+			Latencies[static_cast<int32>(Operation)].Record(static_cast<uint64>((Finished - Scheduled) * SecondsPerCycle * 1e9));
+		}
+		return 0;
+	}
+
+	const TArray<FOpenSkillLatencyHistogram>& GetLatencies() const
+	{
+		return Latencies;
+	}
+
+	// Folded over every result so the calls can't be optimized away.
+	double Checksum = 0;
+	uint64 Missed = 0;
+
+private:
+	const FOpenSkillUnrealModule& Module;
+	const FOpenSkillLoadTestConfig& Config;
+	const int32 Index;
+	const uint64 StartCycles;
+	FRunnableThread* Thread = nullptr;
+
+	// Only ever touched by this thread.
+	FRandomStream Random;
+	TArray<FOpenSkillRating> Ratings;
+	TArray<int32> LastMatch;
+	TArray<int32> Players;
+	TArray<TArray<FOpenSkillRating>> Teams;
+	TArray<TTuple<TArray<FOpenSkillRating>, int>> RankedTeams;
+	TArray<FOpenSkillLatencyHistogram> Latencies;
+
+	EOpenSkillLoadTestOperation PickOperation(const double TotalWeight)
+	{
+		double Pick = Random.GetFraction() * TotalWeight;
+		for (int32 Operation = 0; Operation < OpenSkillLoadTest::NumOperations; ++Operation)
+		{
+			Pick -= FMath::Max(Config.Weights[Operation], 0.0);
+			if (Pick < 0)
+			{
+				return static_cast<EOpenSkillLoadTestOperation>(Operation);
+			}
+		}
+		return static_cast<EOpenSkillLoadTestOperation>(OpenSkillLoadTest::NumOperations - 1);
+	}
+
+	void MakeMatch(const int32 Request)
+	{
+		const FOpenSkillSimulationConfig& Match = Config.Match;
+		const int32 PlayersPerMatch = Match.NumTeams * Match.TeamSize;
+		Players.Reset();
+		while (Players.Num() < PlayersPerMatch)
+		{
+			const int32 Player = Random.RandHelper(Match.PopulationSize);
+			if (LastMatch[Player] != Request)
+			{
+				LastMatch[Player] = Request;
+				Players.Add(Player);
+			}
+		}
+
+		Teams.SetNum(Match.NumTeams);
+		RankedTeams.SetNum(Match.NumTeams);
+		for (int Team = 0; Team < Match.NumTeams; ++Team)
+		{
+			Teams[Team].Reset();
+			for (int Member = 0; Member < Match.TeamSize; ++Member)
+			{
+				Teams[Team].Add(Ratings[Players[Team * Match.TeamSize + Member]]);
+			}
+			// Drawn with replacement, so some matches come with tied teams.
+			RankedTeams[Team].Key = Teams[Team];
+			RankedTeams[Team].Value = Random.RandHelper(Match.NumTeams);
+		}
+	}
+
+	void Execute(const EOpenSkillLoadTestOperation Operation)
+	{
+		switch (Operation)
+		{
+		case EOpenSkillLoadTestOperation::RateByRank:
+			Store(Module.RateByRank(MoveTemp(RankedTeams)));
+			break;
+		case EOpenSkillLoadTestOperation::RateByScore:
+			Store(Module.RateByScore(MoveTemp(RankedTeams)));
+			break;
+		case EOpenSkillLoadTestOperation::PredictWin:
+			Checksum += Module.PredictWin(Teams)[0];
+			break;
+		case EOpenSkillLoadTestOperation::PredictDraw:
+			Checksum += Module.PredictDraw(Teams);
+			break;
+		case EOpenSkillLoadTestOperation::PredictRank:
+		default:
+			Checksum += Module.PredictRank(Teams)[0].Value;
+			break;
+		}
+	}
+
+	void Store(const TArray<TArray<FOpenSkillRating>>& Rated)
+	{
+		const int32 TeamSize = Config.Match.TeamSize;
+		for (int Team = 0; Team < Rated.Num(); ++Team)
+		{
+			for (int Member = 0; Member < TeamSize; ++Member)
+			{
+				Ratings[Players[Team * TeamSize + Member]] = Rated[Team][Member];
+			}
+		}
+		Checksum += Rated[0][0].Mu;
+	}
+};
+
+FOpenSkillLatencyHistogram::FOpenSkillLatencyHistogram()
+	: Count(0)
+	, Sum(0)
+	, Max(0)
+{
+	Counts.SetNumZeroed(NumBuckets);
+}
+
+int32 FOpenSkillLatencyHistogram::GetBucket(const uint64 Value)
+{
+	if (Value < SubBucketCount)
+	{
+		return static_cast<int32>(Value);
+	}
+	// Keep the top SubBucketBits + 1 bits, the leading one picks the power of two and the rest the linear step within it.
+	const int32 Shift = static_cast<int32>(FMath::FloorLog2_64(Value)) - SubBucketBits;
+	return SubBucketCount + Shift * SubBucketCount + static_cast<int32>((Value >> Shift) - SubBucketCount);
+}
+
+uint64 FOpenSkillLatencyHistogram::GetBucketUpperBound(const int32 Bucket)
+{
+	if (Bucket < SubBucketCount)
+	{
+		return Bucket;
+	}
+	const int32 Shift = (Bucket - SubBucketCount) / SubBucketCount;
+	const uint64 Step = (Bucket - SubBucketCount) % SubBucketCount;
+	return ((SubBucketCount + Step + 1) << Shift) - 1;
+}
+
+void FOpenSkillLatencyHistogram::Record(const uint64 Nanoseconds)
+{
+	++Counts[GetBucket(Nanoseconds)];
+	++Count;
+	Sum += Nanoseconds;
+	Max = FMath::Max(Max, Nanoseconds);
+}
+
+void FOpenSkillLatencyHistogram::Merge(const FOpenSkillLatencyHistogram& Other)
+{
+	for (int32 Bucket = 0; Bucket < NumBuckets; ++Bucket)
+	{
+		Counts[Bucket] += Other.Counts[Bucket];
+	}
+	Count += Other.Count;
+	Sum += Other.Sum;
+	Max = FMath::Max(Max, Other.Max);
+}
+
+uint64 FOpenSkillLatencyHistogram::GetPercentile(const double Percentile) const
+{
+	if (Count == 0)
+	{
+		return 0;
+	}
+	const uint64 Rank = FMath::Max<uint64>(static_cast<uint64>(FMath::CeilToDouble(FMath::Clamp(Percentile, 0.0, 100.0) / 100 * Count)), 1);
+	uint64 Seen = 0;
+	for (int32 Bucket = 0; Bucket < NumBuckets; ++Bucket)
+	{
+		Seen += Counts[Bucket];
+		if (Seen >= Rank)
+		{
+			return FMath::Min(GetBucketUpperBound(Bucket), Max);
+		}
+	}
+	return Max;
+}
+
+FOpenSkillLoadTestConfig::FOpenSkillLoadTestConfig()
+{
+	// Matchmakers score far more lobbies than there are results to rate.
+	Weights[static_cast<int32>(EOpenSkillLoadTestOperation::RateByRank)] = 1;
+	Weights[static_cast<int32>(EOpenSkillLoadTestOperation::RateByScore)] = 1;
+	Weights[static_cast<int32>(EOpenSkillLoadTestOperation::PredictWin)] = 2;
+	Weights[static_cast<int32>(EOpenSkillLoadTestOperation::PredictDraw)] = 4;
+	Weights[static_cast<int32>(EOpenSkillLoadTestOperation::PredictRank)] = 2;
+}
+
+FOpenSkillLoadTestReport FOpenSkillLoadTest::Run(const FOpenSkillUnrealModule& Module, const FOpenSkillLoadTestConfig& Config)
+{
+	checkf(Config.Match.PopulationSize >= Config.Match.NumTeams * Config.Match.TeamSize, TEXT("Population (%d) is smaller than a match"), Config.Match.PopulationSize)
+	check(Config.NumThreads > 0 && Config.RequestsPerSecond > 0)
+
+	const uint64 StartCycles = FPlatformTime::Cycles64() + static_cast<uint64>(OpenSkillLoadTest::StartDelaySeconds / FPlatformTime::GetSecondsPerCycle64());
+	TArray<TUniquePtr<FOpenSkillLoadTestWorker>> Workers;
+	Workers.Reserve(Config.NumThreads);
+	for (int32 Index = 0; Index < Config.NumThreads; ++Index)
+	{
+		Workers.Emplace(MakeUnique<FOpenSkillLoadTestWorker>(Module, Config, Index, StartCycles));
+	}
+
+	FOpenSkillLoadTestReport Report;
+	Report.Latencies.SetNum(OpenSkillLoadTest::NumOperations);
+	double Checksum = 0;
+	for (const TUniquePtr<FOpenSkillLoadTestWorker>& Worker : Workers)
+	{
+		Worker->Wait();
+		for (int32 Operation = 0; Operation < OpenSkillLoadTest::NumOperations; ++Operation)
+		{
+			Report.Latencies[Operation].Merge(Worker->GetLatencies()[Operation]);
+			Report.TotalLatency.Merge(Worker->GetLatencies()[Operation]);
+		}
+		Checksum += Worker->Checksum;
+		Report.MissedRequests += Worker->Missed;
+	}
+	Report.Seconds = (FPlatformTime::Cycles64() - StartCycles) * FPlatformTime::GetSecondsPerCycle64();
+	Report.Requests = Report.TotalLatency.GetCount();
+	Report.RequestsPerSecond = Report.Seconds > 0 ? Report.Requests / Report.Seconds : 0;
+	UE_LOG(LogOpenSkillLoadTest, Verbose, TEXT("Checksum %f"), Checksum);
+	return Report;
+}
+
+const TCHAR* FOpenSkillLoadTest::GetOperationName(const EOpenSkillLoadTestOperation Operation)
+{
+	switch (Operation)
+	{
+	case EOpenSkillLoadTestOperation::RateByRank:
+		return TEXT("RateByRank");
+	case EOpenSkillLoadTestOperation::RateByScore:
+		return TEXT("RateByScore");
+	case EOpenSkillLoadTestOperation::PredictWin:
+		return TEXT("PredictWin");
+	case EOpenSkillLoadTestOperation::PredictDraw:
+		return TEXT("PredictDraw");
+	default:
+		return TEXT("PredictRank");
+	}
+}
+
+void FOpenSkillLoadTest::LogReport(const FOpenSkillLoadTestReport& Report)
+{
+	UE_LOG(LogOpenSkillLoadTest, Display, TEXT("%llu requests in %.2fs, %.0f requests/s, %llu scheduled requests missed"),
+	       Report.Requests, Report.Seconds, Report.RequestsPerSecond, Report.MissedRequests);
+
+	const auto LogLatencies = [](const TCHAR* Name, const FOpenSkillLatencyHistogram& Histogram)
+	{
+		UE_LOG(LogOpenSkillLoadTest, Display, TEXT("%-12s %9llu requests  p50 %8.1fus  p99 %8.1fus  p99.9 %8.1fus  max %8.1fus"),
+		       Name, Histogram.GetCount(), Histogram.GetPercentile(50) / 1e3, Histogram.GetPercentile(99) / 1e3, Histogram.GetPercentile(99.9) / 1e3, Histogram.GetMax() / 1e3);
+	};
+	for (int32 Operation = 0; Operation < Report.Latencies.Num(); ++Operation)
+	{
+		if (Report.Latencies[Operation].GetCount() > 0)
+		{
+			LogLatencies(GetOperationName(static_cast<EOpenSkillLoadTestOperation>(Operation)), Report.Latencies[Operation]);
+		}
+	}
+	LogLatencies(TEXT("All"), Report.TotalLatency);
+}
@@ -0,0 +1,35 @@
+﻿#include "OpenSkillLobbyBatch.h"
+
+TArray<int32> FOpenSkillLobbyBatch::SelectBest(TArrayView<const double> Quality, const int32 Count)
+{
+	TArray<int32> Best;
+	if (Count <= 0)
+	{
+		return Best;
+	}
+
+	// Min-heap of the best lobbies so far, its top is the one to evict.
+	const auto Worse = [&Quality](const int32 Lhs, const int32 Rhs)
+	{
+		return Quality[Lhs] < Quality[Rhs] || (Quality[Lhs] == Quality[Rhs] && Lhs > Rhs);
+	};
+	Best.Reserve(FMath::Min(Count, Quality.Num()) + 1);
+	for (int32 Lobby = 0; Lobby < Quality.Num(); ++Lobby)
+	{
+		if (Best.Num() < Count)
+		{
+			Best.HeapPush(Lobby, Worse);
+		}
+		else if (Worse(Best.HeapTop(), Lobby))
+		{
+			Best.HeapPopDiscard(Worse);
+			Best.HeapPush(Lobby, Worse);
+		}
+	}
+
+	Best.Sort([&Worse](const int32 Lhs, const int32 Rhs)
+	{
+		return Worse(Rhs, Lhs);
+	});
+	return Best;
+}
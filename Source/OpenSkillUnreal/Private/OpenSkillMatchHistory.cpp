@@ -0,0 +1,45 @@
+﻿#include "OpenSkillMatchHistory.h"
+
+FOpenSkillMatchHistory::FOpenSkillMatchHistory()
+{
+	Empty();
+}
+
+int32 FOpenSkillMatchHistory::AddMatch(const TArray<TTuple<TArray<int32>, int>>& Teams)
+{
+	TArray<int32> Order;
+	Order.Reserve(Teams.Num());
+	for (int i = 0; i < Teams.Num(); ++i)
+	{
+		Order.Add(i);
+	}
+	Order.StableSort([&Teams](const int32 Lhs, const int32 Rhs)
+	{
+		return Teams[Lhs].Value < Teams[Rhs].Value;
+	});
+
+	for (const int32 Index : Order)
+	{
+		for (const int32 Player : Teams[Index].Key)
+		{
+			check(Player >= 0)
+			Players.Add(Player);
+			NumPlayers = FMath::Max(NumPlayers, Player + 1);
+		}
+		TeamOffsets.Add(Players.Num());
+		TeamRanks.Add(Teams[Index].Value);
+	}
+	MatchOffsets.Add(TeamRanks.Num());
+	return Num() - 1;
+}
+
+void FOpenSkillMatchHistory::Empty()
+{
+	Players.Empty();
+	TeamOffsets.Empty();
+	TeamOffsets.Add(0);
+	TeamRanks.Empty();
+	MatchOffsets.Empty();
+	MatchOffsets.Add(0);
+	NumPlayers = 0;
+}
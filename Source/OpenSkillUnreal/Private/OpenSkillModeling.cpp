@@ -1,126 +1,211 @@
-﻿#include "OpenSkillModeling.h"
-#include "OpenSkillOptions.h"
-
-double FOpenSkillModeling::GetScore(double Q, double I)
-{
-	if (Q < I)
-	{
-		return 0.0;
-	}
-	if (Q > I)
-	{
-		return 1.0;
-	}
-	return 0.5;
-}
-
-TArray<int> FOpenSkillModeling::GetRankings(const TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks)
-{
-	TArray<int> TeamScores;
-	TeamScores.Reserve(Teams.Num());
-	TArray<int> OutRank;
-	OutRank.SetNumZeroed(Teams.Num());
-
-	for (int i = 0; i < Teams.Num(); ++i)
-	{
-		if (Ranks.Num() > i)
-		{
-			TeamScores.Add(Ranks[i]);
-		}
-		else
-		{
-			TeamScores.Add(i);
-		}
-	}
-
-	int s = 0;
-	for (int j = 0; j < TeamScores.Num(); ++j)
-	{
-		if (j > 0 && TeamScores[j] - 1 < TeamScores[j])
-		{
-			s = j;
-		}
-		OutRank[j] = s;
-	}
-	return OutRank;
-}
-
-FOpenSkillTeamRating FOpenSkillModeling::GetTeamRating(const TArray<FOpenSkillRating>& Team, const int Rank)
-{
-	double Mu = 0;
-	double Sigma = 0;
-
-	for (const FOpenSkillRating& Member : Team)
-	{
-		Mu += Member.Mu;
-		Sigma += FMath::Square(Member.Sigma);
-	}
-	return FOpenSkillTeamRating(Mu, Sigma, Team, Rank);
-}
-
-TArray<FOpenSkillTeamRating> FOpenSkillModeling::GetTeamRatings(const TArray<TArray<FOpenSkillRating>>& Game, const TArray<int>& Ranks)
-{
-	TArray<int> Rankings = GetRankings(Game, Ranks);
-	TArray<FOpenSkillTeamRating> Result;
-
-	for (int i = 0; i < Game.Num(); ++i)
-	{
-		const TArray<FOpenSkillRating>& Team = Game[i];
-		Result.Emplace(GetTeamRating(Team, Rankings[i]));
-	}
-
-	return Result;
-}
-
-double FOpenSkillModeling::GetC(const TArray<FOpenSkillTeamRating>& TeamRatings, const FOpenSkillOptions& Options)
-{
-	const double BetaSquared = FMath::Square(Options.Beta);
-	double TeamSigmaSq = 0;
-	for (const FOpenSkillTeamRating& TeamRating : TeamRatings)
-	{
-		TeamSigmaSq += TeamRating.SigmaSq + BetaSquared;
-	}
-	return FMath::Sqrt(TeamSigmaSq);
-}
-
-TArray<double> FOpenSkillModeling::GetSumQ(const TArray<FOpenSkillTeamRating>& TeamRatings, const double C)
-{
-	TArray<double> Result;
-
-	for (int q = 0; q < TeamRatings.Num(); ++q)
-	{
-		double Sum = 0;
-		const FOpenSkillTeamRating& TeamQ = TeamRatings[q];
-		for (int i = 0; i < TeamRatings.Num(); ++i)
-		{
-			const FOpenSkillTeamRating& TeamI = TeamRatings[i];
-			if (TeamI.Rank >= TeamQ.Rank)
-			{
-				Sum += FMath::Exp(TeamI.Mu / C);
-			}
-		}
-		Result.Add(Sum);
-	}
-	return Result;
-}
-
-TArray<double> FOpenSkillModeling::GetA(const TArray<FOpenSkillTeamRating>& TeamRatings)
-{
-	TArray<double> Result;
-
-	for (int q = 0; q < TeamRatings.Num(); ++q)
-	{
-		int MatchingRanks = 0;
-		const FOpenSkillTeamRating& TeamQ = TeamRatings[q];
-		for (int i = 0; i < TeamRatings.Num(); ++i)
-		{
-			const FOpenSkillTeamRating& TeamI = TeamRatings[i];
-			if (TeamI.Rank == TeamQ.Rank)
-			{
-				MatchingRanks++;
-			}
-		}
-		Result.Add(MatchingRanks);
-	}
-	return Result;
-}
+﻿#include "OpenSkillModeling.h"
+#include "OpenSkillOptions.h"
+#include "OpenSkillStatistics.h"
+
+FOpenSkillModel FOpenSkillModeling::GetModel(const EOpenSkillModel Model)
+{
+	switch (Model)
+	{
+	case EOpenSkillModel::ThurstoneMostellerFull:
+		return &ThurstoneMostellerFull;
+	case EOpenSkillModel::ThurstoneMostellerPartial:
+		return &ThurstoneMostellerPartial;
+	case EOpenSkillModel::BradleyTerryFull:
+		return &BradleyTerryFull;
+	case EOpenSkillModel::BradleyTerryPartial:
+		return &BradleyTerryPartial;
+	default:
+		return &PlackettLuce;
+	}
+}
+
+const TCHAR* FOpenSkillModeling::GetModelName(const EOpenSkillModel Model)
+{
+	switch (Model)
+	{
+	case EOpenSkillModel::ThurstoneMostellerFull:
+		return TEXT("ThurstoneMostellerFull");
+	case EOpenSkillModel::ThurstoneMostellerPartial:
+		return TEXT("ThurstoneMostellerPartial");
+	case EOpenSkillModel::BradleyTerryFull:
+		return TEXT("BradleyTerryFull");
+	case EOpenSkillModel::BradleyTerryPartial:
+		return TEXT("BradleyTerryPartial");
+	default:
+		return TEXT("PlackettLuce");
+	}
+}
+
+double FOpenSkillModeling::GetScore(double Q, double I)
+{
+	if (Q < I)
+	{
+		return 0.0;
+	}
+	if (Q > I)
+	{
+		return 1.0;
+	}
+	return 0.5;
+}
+
+TArray<int> FOpenSkillModeling::GetRankings(const TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks)
+{
+	TArray<int> TeamScores;
+	TeamScores.Reserve(Teams.Num());
+	TArray<int> OutRank;
+	OutRank.SetNumZeroed(Teams.Num());
+
+	for (int i = 0; i < Teams.Num(); ++i)
+	{
+		if (Ranks.Num() > i)
+		{
+			TeamScores.Add(Ranks[i]);
+		}
+		else
+		{
+			TeamScores.Add(i);
+		}
+	}
+
+	int s = 0;
+	for (int j = 0; j < TeamScores.Num(); ++j)
+	{
+		if (j > 0 && TeamScores[j - 1] < TeamScores[j])
+		{
+			s = j;
+		}
+		OutRank[j] = s;
+	}
+	return OutRank;
+}
+
+FOpenSkillTeamRating FOpenSkillModeling::GetTeamRating(const TArray<FOpenSkillRating>& Team, const int Rank)
+{
+	double Mu = 0;
+	double Sigma = 0;
+
+	for (const FOpenSkillRating& Member : Team)
+	{
+		Mu += Member.Mu;
+		Sigma += FMath::Square(Member.Sigma);
+	}
+	return FOpenSkillTeamRating(Mu, Sigma, Team, Rank);
+}
+
+TArray<FOpenSkillTeamRating> FOpenSkillModeling::GetTeamRatings(const TArray<TArray<FOpenSkillRating>>& Game, const TArray<int>& Ranks)
+{
+	TArray<int> Rankings = GetRankings(Game, Ranks);
+	TArray<FOpenSkillTeamRating> Result;
+
+	for (int i = 0; i < Game.Num(); ++i)
+	{
+		const TArray<FOpenSkillRating>& Team = Game[i];
+		Result.Emplace(GetTeamRating(Team, Rankings[i]));
+	}
+
+	return Result;
+}
+
+double FOpenSkillModeling::GetWinProbability(TArrayView<const double> TeamMu, TArrayView<const double> TeamSigmaSq, const int Team, const double BetaSquared)
+{
+	const double N = TeamMu.Num();
+	const double Denom = (N * (N - 1)) / 2;
+	double Prob = 0;
+	for (int q = 0; q < TeamMu.Num(); ++q)
+	{
+		if (q == Team)
+		{
+			continue;
+		}
+		Prob += FOpenSkillStatistics::PhiMajor((TeamMu[Team] - TeamMu[q]) / FMath::Sqrt(N * BetaSquared + FMath::Square(TeamSigmaSq[Team]) + FMath::Square(TeamSigmaSq[q])));
+	}
+	return Prob / Denom;
+}
+
+double FOpenSkillModeling::GetC(const TArray<FOpenSkillTeamRating>& TeamRatings, const double BetaSquared)
+{
+	double TeamSigmaSq = 0;
+	for (const FOpenSkillTeamRating& TeamRating : TeamRatings)
+	{
+		TeamSigmaSq += TeamRating.SigmaSq + BetaSquared;
+	}
+	return FMath::Sqrt(TeamSigmaSq);
+}
+
+TArray<double> FOpenSkillModeling::GetSumQ(const TArray<FOpenSkillTeamRating>& TeamRatings, const double C)
+{
+	TArray<double> Result;
+
+	for (int q = 0; q < TeamRatings.Num(); ++q)
+	{
+		double Sum = 0;
+		const FOpenSkillTeamRating& TeamQ = TeamRatings[q];
+		for (int i = 0; i < TeamRatings.Num(); ++i)
+		{
+			const FOpenSkillTeamRating& TeamI = TeamRatings[i];
+			if (TeamI.Rank >= TeamQ.Rank)
+			{
+				Sum += FMath::Exp(TeamI.Mu / C);
+			}
+		}
+		Result.Add(Sum);
+	}
+	return Result;
+}
+
+TArray<double> FOpenSkillModeling::GetA(const TArray<FOpenSkillTeamRating>& TeamRatings)
+{
+	TArray<double> Result;
+
+	for (int q = 0; q < TeamRatings.Num(); ++q)
+	{
+		int MatchingRanks = 0;
+		const FOpenSkillTeamRating& TeamQ = TeamRatings[q];
+		for (int i = 0; i < TeamRatings.Num(); ++i)
+		{
+			const FOpenSkillTeamRating& TeamI = TeamRatings[i];
+			if (TeamI.Rank == TeamQ.Rank)
+			{
+				MatchingRanks++;
+			}
+		}
+		Result.Add(MatchingRanks);
+	}
+	return Result;
+}
+
+void FOpenSkillModeling::ThurstoneMostellerPair(const double DeltaMu, const double Epsilon, const double RankI, const double RankQ, double& OutV, double& OutW)
+{
+	if (RankQ == RankI)
+	{
+		OutV = FOpenSkillStatistics::VT(DeltaMu, Epsilon);
+		OutW = FOpenSkillStatistics::WT(DeltaMu, Epsilon);
+	}
+	else
+	{
+		const double Sign = RankQ > RankI ? 1 : -1;
+		OutV = Sign * FOpenSkillStatistics::V(Sign * DeltaMu, Epsilon);
+		OutW = FOpenSkillStatistics::W(Sign * DeltaMu, Epsilon);
+	}
+}
+
+void FOpenSkillModeling::BradleyTerryPair(const double MuI, const double MuQ, const double Ciq, const double RankI, const double RankQ, double& OutOmega, double& OutDelta)
+{
+	const double Piq = 1 / (1 + FMath::Exp((MuQ - MuI) / Ciq));
+	OutOmega = GetScore(RankQ, RankI) - Piq;
+	OutDelta = Piq * (1 - Piq);
+}
+
+TArray<FOpenSkillRating> FOpenSkillModeling::ApplyTeamUpdate(const FOpenSkillTeamRating& Team, const double Omega, const double Delta, const double Kappa)
+{
+	TArray<FOpenSkillRating> Rated;
+	Rated.Reserve(Team.Members.Num());
+	for (const FOpenSkillRating& Member : Team.Members)
+	{
+		const double SigmaSq = FMath::Square(Member.Sigma);
+		Rated.Emplace(Member.Mu + (SigmaSq / Team.SigmaSq) * Omega,
+		              Member.Sigma * FMath::Sqrt(FMath::Max(1 - (SigmaSq / Team.SigmaSq) * Delta, Kappa)));
+	}
+	return Rated;
+}
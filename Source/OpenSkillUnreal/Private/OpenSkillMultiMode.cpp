@@ -0,0 +1,509 @@
+﻿#include "OpenSkillMultiMode.h"
+#include "OpenSkillModeling.h"
+#include "OpenSkillSimulation.h"
+#include "OpenSkillStatistics.h"
+#include "OpenSkillUnreal.h"
+#include "HAL/IConsoleManager.h"
+#include "Runtime/Launch/Resources/Version.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogOpenSkillMultiMode, Log, All);
+
+namespace OpenSkillMultiMode
+{
+	/**
+	 * Team sums and the per-team update of one match, Lanes values per team. The models below are FOpenSkillModeling's
+	 * with every team level value turned into a row of lanes, one lane per mode.
+	 */
+	struct FMatch
+	{
+		int32 NumTeams;
+		int32 Lanes;
+		// Ranks as GetRankings hands them to the models, teams in rank order.
+		const int* Ranks;
+		const double* Mu;
+		const double* SigmaSq;
+		double* Omega;
+		double* Delta;
+	};
+
+	// Sum of every team's variance plus Beta^2, per lane.
+	void GetC(const FMatch& Match, const double BetaSquared, double* OutC)
+	{
+		const int32 L = Match.Lanes;
+		for (int32 Lane = 0; Lane < L; ++Lane)
+		{
+			OutC[Lane] = 0;
+		}
+		for (int32 Team = 0; Team < Match.NumTeams; ++Team)
+		{
+			for (int32 Lane = 0; Lane < L; ++Lane)
+			{
+				OutC[Lane] += Match.SigmaSq[Team * L + Lane] + BetaSquared;
+			}
+		}
+		for (int32 Lane = 0; Lane < L; ++Lane)
+		{
+			OutC[Lane] = FMath::Sqrt(OutC[Lane]);
+		}
+	}
+
+	// Scratch is 2 * NumTeams + 1 rows of lanes.
+	void PlackettLuce(const FMatch& Match, const FOpenSkillOptions& Options, double* Scratch)
+	{
+		const int32 N = Match.NumTeams;
+		const int32 L = Match.Lanes;
+		double* C = Scratch;
+		double* ExpMu = C + L;
+		double* SumQ = ExpMu + N * L;
+		GetC(Match, FMath::Square(Options.Beta), C);
+
+		for (int32 Team = 0; Team < N; ++Team)
+		{
+			for (int32 Lane = 0; Lane < L; ++Lane)
+			{
+				ExpMu[Team * L + Lane] = FMath::Exp(Match.Mu[Team * L + Lane] / C[Lane]);
+			}
+		}
+		for (int32 q = 0; q < N; ++q)
+		{
+			for (int32 Lane = 0; Lane < L; ++Lane)
+			{
+				SumQ[q * L + Lane] = 0;
+			}
+			for (int32 i = 0; i < N; ++i)
+			{
+				if (Match.Ranks[i] >= Match.Ranks[q])
+				{
+					for (int32 Lane = 0; Lane < L; ++Lane)
+					{
+						SumQ[q * L + Lane] += ExpMu[i * L + Lane];
+					}
+				}
+			}
+		}
+
+		// The number of teams sharing each team's rank, tied teams are next to each other.
+		TArray<int32> A;
+		A.SetNumUninitialized(N);
+		for (int32 First = 0; First < N;)
+		{
+			int32 Last = First + 1;
+			while (Last < N && Match.Ranks[Last] == Match.Ranks[First])
+			{
+				++Last;
+			}
+			for (int32 q = First; q < Last; ++q)
+			{
+				A[q] = Last - First;
+			}
+			First = Last;
+		}
+
+		for (int32 i = 0; i < N; ++i)
+		{
+			double* Omega = Match.Omega + i * L;
+			double* Delta = Match.Delta + i * L;
+			for (int32 q = 0; q < N && Match.Ranks[q] <= Match.Ranks[i]; ++q)
+			{
+				for (int32 Lane = 0; Lane < L; ++Lane)
+				{
+					const double Quotient = ExpMu[i * L + Lane] / SumQ[q * L + Lane];
+					Omega[Lane] += (i == q ? 1 - Quotient : -Quotient) / A[q];
+					Delta[Lane] += (Quotient * (1 - Quotient)) / A[q];
+				}
+			}
+			for (int32 Lane = 0; Lane < L; ++Lane)
+			{
+				const double SigmaSq = Match.SigmaSq[i * L + Lane];
+				const double Gamma = FMath::Sqrt(SigmaSq) / C[Lane];
+				Omega[Lane] *= SigmaSq / C[Lane];
+				Delta[Lane] = Gamma * Delta[Lane] * (SigmaSq / FMath::Square(C[Lane]));
+			}
+		}
+	}
+
+	void ThurstoneMostellerFull(const FMatch& Match, const FOpenSkillOptions& Options)
+	{
+		const int32 N = Match.NumTeams;
+		const int32 L = Match.Lanes;
+		const double TwoBetaSq = 2 * FMath::Square(Options.Beta);
+		for (int32 i = 0; i < N; ++i)
+		{
+			for (int32 q = i + 1; q < N; ++q)
+			{
+				for (int32 Lane = 0; Lane < L; ++Lane)
+				{
+					const double SigmaSqI = Match.SigmaSq[i * L + Lane];
+					const double SigmaSqQ = Match.SigmaSq[q * L + Lane];
+					const double Ciq = FMath::Sqrt(SigmaSqI + SigmaSqQ + TwoBetaSq);
+					double V;
+					double W;
+					FOpenSkillModeling::ThurstoneMostellerPair((Match.Mu[i * L + Lane] - Match.Mu[q * L + Lane]) / Ciq, Options.Kappa / Ciq, Match.Ranks[i], Match.Ranks[q], V, W);
+
+					const double ISigSqToCiq = SigmaSqI / Ciq;
+					const double QSigSqToCiq = SigmaSqQ / Ciq;
+					Match.Omega[i * L + Lane] += ISigSqToCiq * V;
+					Match.Delta[i * L + Lane] += ((FMath::Sqrt(SigmaSqI) / Ciq * ISigSqToCiq) / Ciq) * W;
+					Match.Omega[q * L + Lane] -= QSigSqToCiq * V;
+					Match.Delta[q * L + Lane] += ((FMath::Sqrt(SigmaSqQ) / Ciq * QSigSqToCiq) / Ciq) * W;
+				}
+			}
+		}
+	}
+
+	void ThurstoneMostellerPartial(const FMatch& Match, const FOpenSkillOptions& Options)
+	{
+		const int32 N = Match.NumTeams;
+		const int32 L = Match.Lanes;
+		const double TwoBetaSq = 2 * FMath::Square(Options.Beta);
+		for (int32 i = 0; i < N; ++i)
+		{
+			// The ladder neighbours of GetLadderPairs, the team above then the team below.
+			for (int32 q = i - 1; q <= i + 1; q += 2)
+			{
+				if (q < 0 || q >= N)
+				{
+					continue;
+				}
+				for (int32 Lane = 0; Lane < L; ++Lane)
+				{
+					const double SigmaSqI = Match.SigmaSq[i * L + Lane];
+					const double Ciq = 2 * FMath::Sqrt(SigmaSqI + Match.SigmaSq[q * L + Lane] + TwoBetaSq);
+					const double DeltaMu = (Match.Mu[i * L + Lane] - Match.Mu[q * L + Lane]) / Ciq;
+					const double QEta = SigmaSqI / Ciq;
+					const double IGamma = FMath::Sqrt(SigmaSqI) / Ciq;
+
+					if (Match.Ranks[q] == Match.Ranks[i])
+					{
+						Match.Omega[i * L + Lane] += QEta * FOpenSkillStatistics::VT(DeltaMu, Options.Kappa / Ciq);
+						Match.Delta[i * L + Lane] += ((IGamma * QEta) / Ciq) * FOpenSkillStatistics::WT(DeltaMu, Options.Kappa / Ciq);
+					}
+					else
+					{
+						const double Sign = Match.Ranks[q] > Match.Ranks[i] ? 1 : -1;
+						Match.Omega[i * L + Lane] += Sign * QEta * FOpenSkillStatistics::V(Sign * DeltaMu, Options.Kappa / Ciq);
+						Match.Delta[i * L + Lane] += ((IGamma * QEta) / Ciq) * FOpenSkillStatistics::W(Sign * DeltaMu, Options.Kappa / Ciq);
+					}
+				}
+			}
+		}
+	}
+
+	// Scratch is one row of lanes.
+	void BradleyTerryFull(const FMatch& Match, const FOpenSkillOptions& Options, double* Scratch)
+	{
+		const int32 N = Match.NumTeams;
+		const int32 L = Match.Lanes;
+		const double TwoBetaSq = 2 * FMath::Square(Options.Beta);
+		double* C = Scratch;
+		GetC(Match, FMath::Square(Options.Beta), C);
+
+		for (int32 i = 0; i < N; ++i)
+		{
+			for (int32 q = i + 1; q < N; ++q)
+			{
+				const double Score = FOpenSkillModeling::GetScore(Match.Ranks[q], Match.Ranks[i]);
+				for (int32 Lane = 0; Lane < L; ++Lane)
+				{
+					const double SigmaSqI = Match.SigmaSq[i * L + Lane];
+					const double SigmaSqQ = Match.SigmaSq[q * L + Lane];
+					const double Ciq = FMath::Sqrt(SigmaSqI + SigmaSqQ + TwoBetaSq);
+					const double Piq = 1 / (1 + FMath::Exp((Match.Mu[q * L + Lane] - Match.Mu[i * L + Lane]) / Ciq));
+					const double PairOmega = Score - Piq;
+					const double PairDelta = Piq * (1 - Piq);
+
+					const double IEta = SigmaSqI / Ciq;
+					const double QEta = SigmaSqQ / Ciq;
+					Match.Omega[i * L + Lane] += IEta * PairOmega;
+					Match.Delta[i * L + Lane] += ((FMath::Sqrt(SigmaSqI) / C[Lane] * IEta) / Ciq) * PairDelta;
+					Match.Omega[q * L + Lane] -= QEta * PairOmega;
+					Match.Delta[q * L + Lane] += ((FMath::Sqrt(SigmaSqQ) / C[Lane] * QEta) / Ciq) * PairDelta;
+				}
+			}
+		}
+	}
+
+	void BradleyTerryPartial(const FMatch& Match, const FOpenSkillOptions& Options)
+	{
+		const int32 N = Match.NumTeams;
+		const int32 L = Match.Lanes;
+		const double TwoBetaSq = 2 * FMath::Square(Options.Beta);
+		for (int32 i = 0; i < N; ++i)
+		{
+			for (int32 q = i - 1; q <= i + 1; q += 2)
+			{
+				if (q < 0 || q >= N)
+				{
+					continue;
+				}
+				const double Score = FOpenSkillModeling::GetScore(Match.Ranks[q], Match.Ranks[i]);
+				for (int32 Lane = 0; Lane < L; ++Lane)
+				{
+					const double SigmaSqI = Match.SigmaSq[i * L + Lane];
+					const double Ciq = FMath::Sqrt(SigmaSqI + Match.SigmaSq[q * L + Lane] + TwoBetaSq);
+					const double Piq = 1 / (1 + FMath::Exp((Match.Mu[q * L + Lane] - Match.Mu[i * L + Lane]) / Ciq));
+					const double QEta = SigmaSqI / Ciq;
+					const double IGamma = FMath::Sqrt(SigmaSqI) / Ciq;
+
+					Match.Omega[i * L + Lane] += QEta * (Score - Piq);
+					Match.Delta[i * L + Lane] += ((IGamma * QEta) / Ciq) * Piq * (1 - Piq);
+				}
+			}
+		}
+	}
+
+	/**
+	 * Spread the team update over one member, four modes at a time. Prior holds the member's Sigma once Tau has been
+	 * added, Weight scales the update of every mode.
+	 */
+	void ApplyUpdate(double* Mu, double* Sigma, const double* Prior, const double* TeamSigmaSq, const double* Omega, const double* Delta, const double* Weight,
+	                 const int32 Lanes, const double Kappa, const bool bClampSigma)
+	{
+#if ENGINE_MAJOR_VERSION >= 5
+		const VectorRegister4Double One = VectorSetFloat1(1.0);
+		const VectorRegister4Double KappaVec = VectorSetFloat1(Kappa);
+		for (int32 Lane = 0; Lane < Lanes; Lane += 4)
+		{
+			const VectorRegister4Double PriorVec = VectorLoad(Prior + Lane);
+			const VectorRegister4Double WeightedShare = VectorMultiply(VectorLoad(Weight + Lane), VectorDivide(VectorMultiply(PriorVec, PriorVec), VectorLoad(TeamSigmaSq + Lane)));
+			VectorStore(VectorMultiplyAdd(WeightedShare, VectorLoad(Omega + Lane), VectorLoad(Mu + Lane)), Mu + Lane);
+			const VectorRegister4Double Scale = VectorSqrt(VectorMax(VectorSubtract(One, VectorMultiply(WeightedShare, VectorLoad(Delta + Lane))), KappaVec));
+			const VectorRegister4Double NewSigma = VectorMultiply(PriorVec, Scale);
+			VectorStore(bClampSigma ? VectorMin(NewSigma, PriorVec) : NewSigma, Sigma + Lane);
+		}
+#else
+		// UE4 vector registers are single precision only, the lanes are contiguous so the compiler packs the doubles.
+		for (int32 Lane = 0; Lane < Lanes; ++Lane)
+		{
+			const double WeightedShare = Weight[Lane] * (Prior[Lane] * Prior[Lane] / TeamSigmaSq[Lane]);
+			Mu[Lane] += WeightedShare * Omega[Lane];
+			const double NewSigma = Prior[Lane] * FMath::Sqrt(FMath::Max(1 - WeightedShare * Delta[Lane], Kappa));
+			Sigma[Lane] = bClampSigma ? FMath::Min(NewSigma, Prior[Lane]) : NewSigma;
+		}
+#endif
+	}
+
+	void Compare(const TArray<FString>& Args)
+	{
+		const int32 NumModes = Args.Num() > 0 ? FMath::Clamp(FCString::Atoi(*Args[0]), 1, 64) : 4;
+		FOpenSkillSimulationConfig Config = FOpenSkillSimulationConfig::FiveVersusFive();
+		if (Args.Num() > 1 && !FOpenSkillSimulationConfig::FromName(Args[1], Config))
+		{
+			UE_LOG(LogOpenSkillMultiMode, Error, TEXT("Unknown match format '%s', expected 1v1, 5v5, Squads or FFA."), *Args[1]);
+			return;
+		}
+		// Every match also moves every other mode a quarter of the way.
+		constexpr double RelatedWeight = 0.25;
+
+		const FOpenSkillSimulation Simulation(Config);
+		FOpenSkillUnrealModule Module;
+		const FOpenSkillCompiledOptionsPin Snapshot = Module.GetCompiledOptions();
+		const FOpenSkillOptions& Options = Snapshot->Options;
+		FOpenSkillMultiModeTable Table(NumModes, FOpenSkillRating(Options.Mu, Options.Sigma));
+		Table.AddPlayers(Config.PopulationSize);
+		for (int32 Primary = 0; Primary < NumModes; ++Primary)
+		{
+			for (int32 Mode = 0; Mode < NumModes; ++Mode)
+			{
+				Table.SetWeight(Primary, Mode, Primary == Mode ? 1 : RelatedWeight);
+			}
+		}
+
+		TArray<TArrayView<const int32>> Teams;
+		TArray<int> Ranks;
+		for (int32 Team = 0; Team < Config.NumTeams; ++Team)
+		{
+			Ranks.Add(Team);
+		}
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 Match = 0; Match < Config.NumMatches; ++Match)
+		{
+			const TArrayView<const int32> Players = Simulation.GetMatchPlayers(Match);
+			Teams.Reset();
+			for (int32 Team = 0; Team < Config.NumTeams; ++Team)
+			{
+				Teams.Add(Players.Slice(Team * Config.TeamSize, Config.TeamSize));
+			}
+			FOpenSkillMultiMode::Rate(EOpenSkillModel::PlackettLuce, Table, Teams, Ranks, Match % NumModes, Options);
+		}
+		const double MultiModeSeconds = FPlatformTime::Seconds() - StartTime;
+
+		// The same work as one RateByRank per mode, each with its own nested arrays.
+		TArray<TArray<FOpenSkillRating>> Ratings;
+		Ratings.Init(TArray<FOpenSkillRating>(), NumModes);
+		for (TArray<FOpenSkillRating>& ModeRatings : Ratings)
+		{
+			ModeRatings.Init(FOpenSkillRating(Options.Mu, Options.Sigma), Config.PopulationSize);
+		}
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Match = 0; Match < Config.NumMatches; ++Match)
+		{
+			const TArrayView<const int32> Players = Simulation.GetMatchPlayers(Match);
+			for (int32 Mode = 0; Mode < NumModes; ++Mode)
+			{
+				TArray<TTuple<TArray<FOpenSkillRating>, int>> ModeTeams;
+				for (int32 Team = 0; Team < Config.NumTeams; ++Team)
+				{
+					TArray<FOpenSkillRating> Members;
+					for (const int32 Player : Players.Slice(Team * Config.TeamSize, Config.TeamSize))
+					{
+						Members.Add(Ratings[Mode][Player]);
+					}
+					ModeTeams.Emplace(MoveTemp(Members), Team);
+				}
+				const TArray<TArray<FOpenSkillRating>> Rated = Module.RateByRank(MoveTemp(ModeTeams));
+				for (int32 Team = 0; Team < Config.NumTeams; ++Team)
+				{
+					for (int32 Member = 0; Member < Config.TeamSize; ++Member)
+					{
+						Ratings[Mode][Players[Team * Config.TeamSize + Member]] = Rated[Team][Member];
+					}
+				}
+			}
+		}
+		const double SeparateSeconds = FPlatformTime::Seconds() - StartTime;
+
+		UE_LOG(LogOpenSkillMultiMode, Display, TEXT("%d modes, %d matches: one pass %.0f matches/s, %d RateByRank calls %.0f matches/s, %.1fx faster"),
+		       NumModes, Config.NumMatches, MultiModeSeconds > 0 ? Config.NumMatches / MultiModeSeconds : 0.0, NumModes,
+		       SeparateSeconds > 0 ? Config.NumMatches / SeparateSeconds : 0.0, MultiModeSeconds > 0 ? SeparateSeconds / MultiModeSeconds : 0.0);
+	}
+
+	FAutoConsoleCommand CompareCommand(
+		TEXT("OpenSkill.MultiMode"),
+		TEXT("Rate a synthetic population in several modes at once and against one RateByRank call per mode. Usage: OpenSkill.MultiMode [Modes] [1v1|5v5|Squads|FFA]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&Compare));
+}
+
+FOpenSkillMultiModeTable::FOpenSkillMultiModeTable(const int32 InNumModes, const FOpenSkillRating& InDefaultRating)
+	: NumModes(InNumModes)
+	, Stride(Align(InNumModes, LaneWidth))
+	, DefaultRating(InDefaultRating)
+{
+	check(NumModes > 0)
+	Weights.SetNumZeroed(NumModes * Stride);
+	for (int32 Mode = 0; Mode < NumModes; ++Mode)
+	{
+		Weights[Mode * Stride + Mode] = 1;
+	}
+}
+
+int32 FOpenSkillMultiModeTable::AddPlayers(const int32 Count)
+{
+	const int32 First = Num();
+	Mus.Reserve(Mus.Num() + Count * Stride);
+	Sigmas.Reserve(Sigmas.Num() + Count * Stride);
+	for (int32 i = 0; i < Count * Stride; ++i)
+	{
+		Mus.Add(DefaultRating.Mu);
+		Sigmas.Add(DefaultRating.Sigma);
+	}
+	return First;
+}
+
+void FOpenSkillMultiMode::Rate(const EOpenSkillModel Model, FOpenSkillMultiModeTable& Table, TArrayView<const TArrayView<const int32>> Teams, TArrayView<const int> Ranks,
+                               const int32 PrimaryMode, const FOpenSkillOptions& Options)
+{
+	using namespace OpenSkillMultiMode;
+	check(Teams.Num() == Ranks.Num())
+
+	const int32 N = Teams.Num();
+	const int32 L = Table.GetStride();
+	if (N == 0)
+	{
+		return;
+	}
+
+	// Teams in rank order, ties keep their submission order, and the ranks the models see for them.
+	TArray<int32> Order;
+	Order.Reserve(N);
+	int32 NumPlayers = 0;
+	for (int32 Team = 0; Team < N; ++Team)
+	{
+		Order.Add(Team);
+		NumPlayers += Teams[Team].Num();
+	}
+#if DO_CHECK
+	// Every member's update is written back to their row, a player listed twice would only keep one of them.
+	TSet<int32> MatchRows;
+	for (const TArrayView<const int32> Team : Teams)
+	{
+		for (const int32 Row : Team)
+		{
+			checkf(!MatchRows.Contains(Row), TEXT("Row %d appears more than once in the match"), Row)
+			MatchRows.Add(Row);
+		}
+	}
+#endif
+	Order.StableSort([&Ranks](const int32 Lhs, const int32 Rhs)
+	{
+		return Ranks[Lhs] < Ranks[Rhs];
+	});
+	TArray<int> ModelRanks;
+	ModelRanks.SetNumUninitialized(N);
+	for (int32 i = 0; i < N; ++i)
+	{
+		ModelRanks[i] = i > 0 && Ranks[Order[i - 1]] == Ranks[Order[i]] ? ModelRanks[i - 1] : i;
+	}
+
+	// Team sums, team updates, model scratch and every member's prior Sigma, all rows of L lanes.
+	TArray<double> Scratch;
+	Scratch.SetNumZeroed((6 * N + 1 + NumPlayers) * L);
+	double* TeamMu = Scratch.GetData();
+	double* TeamSigmaSq = TeamMu + N * L;
+	double* Omega = TeamSigmaSq + N * L;
+	double* Delta = Omega + N * L;
+	double* ModelScratch = Delta + N * L;
+	double* Prior = ModelScratch + (2 * N + 1) * L;
+
+	const double* Weight = Table.GetWeightData(PrimaryMode);
+	const double TauSquared = Options.Tau > 0 ? FMath::Square(Options.Tau) : 0;
+	int32 Member = 0;
+	for (int32 i = 0; i < N; ++i)
+	{
+		for (const int32 Player : Teams[Order[i]])
+		{
+			const double* Mu = Table.GetMuData(Player);
+			const double* Sigma = Table.GetSigmaData(Player);
+			double* MemberPrior = Prior + Member * L;
+			for (int32 Lane = 0; Lane < L; ++Lane)
+			{
+				MemberPrior[Lane] = Options.Tau > 0 ? FMath::Sqrt(FMath::Square(Sigma[Lane]) + Weight[Lane] * TauSquared) : Sigma[Lane];
+				TeamMu[i * L + Lane] += Mu[Lane];
+				TeamSigmaSq[i * L + Lane] += FMath::Square(MemberPrior[Lane]);
+			}
+			++Member;
+		}
+	}
+
+	const FMatch Match{N, L, ModelRanks.GetData(), TeamMu, TeamSigmaSq, Omega, Delta};
+	switch (Model)
+	{
+	case EOpenSkillModel::ThurstoneMostellerFull:
+		ThurstoneMostellerFull(Match, Options);
+		break;
+	case EOpenSkillModel::ThurstoneMostellerPartial:
+		ThurstoneMostellerPartial(Match, Options);
+		break;
+	case EOpenSkillModel::BradleyTerryFull:
+		BradleyTerryFull(Match, Options, ModelScratch);
+		break;
+	case EOpenSkillModel::BradleyTerryPartial:
+		BradleyTerryPartial(Match, Options);
+		break;
+	default:
+		PlackettLuce(Match, Options, ModelScratch);
+		break;
+	}
+
+	const bool bClampSigma = Options.Tau > 0 && Options.PreventSigmaIncrease;
+	Member = 0;
+	for (int32 i = 0; i < N; ++i)
+	{
+		for (const int32 Player : Teams[Order[i]])
+		{
+			ApplyUpdate(Table.GetMuData(Player), Table.GetSigmaData(Player), Prior + Member * L, TeamSigmaSq + i * L, Omega + i * L, Delta + i * L,
+			            Weight, L, Options.Kappa, bClampSigma);
+			++Member;
+		}
+	}
+}
@@ -0,0 +1,238 @@
+﻿#include "OpenSkillPlacement.h"
+#include "OpenSkillUnreal.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogOpenSkillPlacement, Log, All);
+
+namespace OpenSkillPlacement
+{
+	constexpr int32 SamplesPerChunk = 4096;
+	// Samples whose normals are generated together, small enough for the batch to stay in L1.
+	constexpr int32 SamplesPerBatch = 64;
+	// Chunks in the first round, the rounds double from there up to MaxChunksPerRound.
+	constexpr int32 MinChunksPerRound = 4;
+	constexpr int32 MaxChunksPerRound = 64;
+	constexpr double Z95 = 1.959963984540054;
+
+	// Philox4x32-10 from Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3".
+	void Philox(uint32 (&Counter)[4], uint32 Key0, uint32 Key1)
+	{
+		for (int Round = 0; Round < 10; ++Round)
+		{
+			const uint64 Product0 = static_cast<uint64>(0xD2511F53u) * Counter[0];
+			const uint64 Product1 = static_cast<uint64>(0xCD9E8D57u) * Counter[2];
+			const uint32 Next0 = static_cast<uint32>(Product1 >> 32) ^ Counter[1] ^ Key0;
+			const uint32 Next2 = static_cast<uint32>(Product0 >> 32) ^ Counter[3] ^ Key1;
+			Counter[1] = static_cast<uint32>(Product1);
+			Counter[3] = static_cast<uint32>(Product0);
+			Counter[0] = Next0;
+			Counter[2] = Next2;
+			Key0 += 0x9E3779B9u;
+			Key1 += 0xBB67AE85u;
+		}
+	}
+
+	/**
+	 * Place the teams in Count samples starting at sample First and add them to Counts, NumTeams * NumTeams place tallies.
+	 */
+	void SampleChunk(TArrayView<const double> Mu, TArrayView<const double> Deviation, const uint64 Seed, const int64 First, const int32 Count, TArrayView<int64> Counts)
+	{
+		const int32 NumTeams = Mu.Num();
+		// Every Philox call gives four uniforms, so each sample takes its normals in groups of four.
+		const int32 Stride = Align(NumTeams, 4);
+		TArray<uint32> Bits;
+		TArray<double> Normals;
+		Bits.SetNumUninitialized(SamplesPerBatch * Stride);
+		Normals.SetNumUninitialized(SamplesPerBatch * Stride);
+		TArray<double> Performance;
+		TArray<int32> Order;
+		Performance.SetNumUninitialized(NumTeams);
+		Order.SetNumUninitialized(NumTeams);
+
+		const uint32 Key0 = static_cast<uint32>(Seed);
+		const uint32 Key1 = static_cast<uint32>(Seed >> 32);
+		for (int32 BatchStart = 0; BatchStart < Count; BatchStart += SamplesPerBatch)
+		{
+			const int32 BatchSize = FMath::Min(SamplesPerBatch, Count - BatchStart);
+			for (int32 s = 0; s < BatchSize; ++s)
+			{
+				const uint64 Sample = First + BatchStart + s;
+				for (int32 Group = 0; Group < Stride / 4; ++Group)
+				{
+					uint32 Block[4] = {static_cast<uint32>(Sample), static_cast<uint32>(Sample >> 32), static_cast<uint32>(Group), 0};
+					Philox(Block, Key0, Key1);
+					FMemory::Memcpy(&Bits[s * Stride + Group * 4], Block, sizeof(Block));
+				}
+			}
+
+			// Box-Muller over the whole batch in one flat loop, both outputs of every pair are used.
+			const int32 NumValues = BatchSize * Stride;
+			for (int32 i = 0; i < NumValues; i += 2)
+			{
+				const double U1 = (Bits[i] + 0.5) * (1.0 / 4294967296.0);
+				const double U2 = (Bits[i + 1] + 0.5) * (1.0 / 4294967296.0);
+				const double Radius = FMath::Sqrt(-2 * FMath::Loge(U1));
+				const double Angle = 2 * PI * U2;
+				Normals[i] = Radius * FMath::Cos(Angle);
+				Normals[i + 1] = Radius * FMath::Sin(Angle);
+			}
+
+			for (int32 s = 0; s < BatchSize; ++s)
+			{
+				const double* SampleNormals = &Normals[s * Stride];
+				for (int32 Team = 0; Team < NumTeams; ++Team)
+				{
+					Performance[Team] = Mu[Team] + Deviation[Team] * SampleNormals[Team];
+					Order[Team] = Team;
+				}
+				Order.Sort([&Performance](const int32 Lhs, const int32 Rhs)
+				{
+					return Performance[Lhs] > Performance[Rhs];
+				});
+				for (int32 Place = 0; Place < NumTeams; ++Place)
+				{
+					++Counts[Order[Place] * NumTeams + Place];
+				}
+			}
+		}
+	}
+
+	void PredictPlacements(const TArray<FString>& Args)
+	{
+		const int32 NumTeams = Args.Num() > 0 ? FMath::Clamp(FCString::Atoi(*Args[0]), 2, 64) : 8;
+		FOpenSkillPlacementConfig Config;
+		if (Args.Num() > 1)
+		{
+			Config.MaxSamples = FMath::Max<int64>(FCString::Atoi64(*Args[1]), 1);
+		}
+
+		// A lobby of single players spread around the default rating.
+		FRandomStream Random(NumTeams);
+		FOpenSkillUnrealModule Module;
+		const FOpenSkillCompiledOptionsPin Snapshot = Module.GetCompiledOptions();
+		const FOpenSkillOptions& Options = Snapshot->Options;
+		TArray<TArray<FOpenSkillRating>> Teams;
+		for (int32 Team = 0; Team < NumTeams; ++Team)
+		{
+			Teams.Add({FOpenSkillRating(Options.Mu + Random.FRandRange(-2, 2) * Options.Sigma, Options.Sigma * Random.FRandRange(0.2f, 1))});
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		const FOpenSkillPlacementMatrix Matrix = Module.PredictPlacements(Teams, Config);
+		const double Seconds = FPlatformTime::Seconds() - StartTime;
+		UE_LOG(LogOpenSkillPlacement, Display, TEXT("%lld samples in %.3fs, %.0f samples/s, max error %.4f"),
+		       Matrix.NumSamples, Seconds, Seconds > 0 ? Matrix.NumSamples / Seconds : 0.0, Matrix.GetMaxError());
+		for (int32 Team = 0; Team < NumTeams; ++Team)
+		{
+			FString Row;
+			for (int32 Place = 0; Place < FMath::Min(NumTeams, 8); ++Place)
+			{
+				Row += FString::Printf(TEXT(" %6.3f"), Matrix.GetProbability(Team, Place));
+			}
+			UE_LOG(LogOpenSkillPlacement, Display, TEXT("Mu %6.2f Sigma %5.2f:%s"), Teams[Team][0].Mu, Teams[Team][0].Sigma, *Row);
+		}
+	}
+
+	FAutoConsoleCommand PredictPlacementsCommand(
+		TEXT("OpenSkill.PredictPlacements"),
+		TEXT("Sample the placement distribution of a random free for all lobby. Usage: OpenSkill.PredictPlacements [Teams] [Samples]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&PredictPlacements));
+}
+
+double FOpenSkillPlacementMatrix::GetMaxError() const
+{
+	double MaxError = 0;
+	for (int32 i = 0; i < Probabilities.Num(); ++i)
+	{
+		MaxError = FMath::Max(MaxError, FMath::Max(Probabilities[i] - LowerBounds[i], UpperBounds[i] - Probabilities[i]));
+	}
+	return MaxError;
+}
+
+FOpenSkillPlacementMatrix FOpenSkillPlacement::Sample(TArrayView<const double> Mu, TArrayView<const double> Variance, const FOpenSkillPlacementConfig& Config)
+{
+	using namespace OpenSkillPlacement;
+	check(Mu.Num() == Variance.Num())
+
+	const int32 NumTeams = Mu.Num();
+	FOpenSkillPlacementMatrix Matrix;
+	Matrix.NumTeams = NumTeams;
+	if (NumTeams == 0)
+	{
+		return Matrix;
+	}
+
+	TArray<double> Deviation;
+	Deviation.SetNumUninitialized(NumTeams);
+	for (int32 Team = 0; Team < NumTeams; ++Team)
+	{
+		Deviation[Team] = FMath::Sqrt(FMath::Max(Variance[Team], 0.0));
+	}
+
+	const int32 NumCells = NumTeams * NumTeams;
+	TArray<int64> Counts;
+	Counts.SetNumZeroed(NumCells);
+	TArray<int64> ChunkCounts;
+	const int64 MaxSamples = FMath::Max<int64>(Config.MaxSamples, 1);
+
+	int32 ChunksPerRound = MinChunksPerRound;
+	while (Matrix.NumSamples < MaxSamples)
+	{
+		// Every chunk tallies into its own counts, they are only summed once the round is over.
+		const int64 RoundSamples = FMath::Min<int64>(static_cast<int64>(ChunksPerRound) * SamplesPerChunk, MaxSamples - Matrix.NumSamples);
+		const int32 NumChunks = static_cast<int32>((RoundSamples + SamplesPerChunk - 1) / SamplesPerChunk);
+		ChunkCounts.Reset();
+		ChunkCounts.SetNumZeroed(NumChunks * NumCells);
+		const int64 RoundStart = Matrix.NumSamples;
+		ParallelFor(NumChunks, [&](const int32 Chunk)
+		{
+			const int64 First = RoundStart + static_cast<int64>(Chunk) * SamplesPerChunk;
+			const int32 Count = static_cast<int32>(FMath::Min<int64>(SamplesPerChunk, RoundStart + RoundSamples - First));
+			SampleChunk(Mu, Deviation, Config.Seed, First, Count, TArrayView<int64>(ChunkCounts.GetData() + Chunk * NumCells, NumCells));
+		});
+		for (int32 Chunk = 0; Chunk < NumChunks; ++Chunk)
+		{
+			for (int32 Cell = 0; Cell < NumCells; ++Cell)
+			{
+				Counts[Cell] += ChunkCounts[Chunk * NumCells + Cell];
+			}
+		}
+		Matrix.NumSamples += RoundSamples;
+		ChunksPerRound = FMath::Min(ChunksPerRound * 2, MaxChunksPerRound);
+
+		if (Config.TargetError > 0)
+		{
+			// The widest Wilson interval belongs to the cell closest to one half.
+			double MaxSpread = 0;
+			for (const int64 CellCount : Counts)
+			{
+				const double P = static_cast<double>(CellCount) / Matrix.NumSamples;
+				MaxSpread = FMath::Max(MaxSpread, P * (1 - P));
+			}
+			const double N = static_cast<double>(Matrix.NumSamples);
+			const double HalfWidth = Z95 * FMath::Sqrt(MaxSpread / N + Z95 * Z95 / (4 * N * N)) / (1 + Z95 * Z95 / N);
+			if (HalfWidth <= Config.TargetError)
+			{
+				break;
+			}
+		}
+	}
+
+	const double N = static_cast<double>(Matrix.NumSamples);
+	const double ZSquared = Z95 * Z95;
+	Matrix.Probabilities.SetNumUninitialized(NumCells);
+	Matrix.LowerBounds.SetNumUninitialized(NumCells);
+	Matrix.UpperBounds.SetNumUninitialized(NumCells);
+	for (int32 Cell = 0; Cell < NumCells; ++Cell)
+	{
+		const double P = Counts[Cell] / N;
+		const double Center = (P + ZSquared / (2 * N)) / (1 + ZSquared / N);
+		const double HalfWidth = Z95 * FMath::Sqrt(P * (1 - P) / N + ZSquared / (4 * N * N)) / (1 + ZSquared / N);
+		Matrix.Probabilities[Cell] = P;
+		Matrix.LowerBounds[Cell] = FMath::Max(Center - HalfWidth, 0.0);
+		Matrix.UpperBounds[Cell] = FMath::Min(Center + HalfWidth, 1.0);
+	}
+	return Matrix;
+}
@@ -0,0 +1,77 @@
+﻿#include "OpenSkillPredictionCache.h"
+#include "OpenSkillOptions.h"
+#include "Hash/CityHash.h"
+#include "Misc/ScopeLock.h"
+
+FOpenSkillPredictionKey::FOpenSkillPredictionKey(const EOpenSkillPrediction InKind, const TArray<TArray<FOpenSkillRating>>& Teams, const FOpenSkillOptions& Options)
+	: Kind(InKind)
+{
+	int32 PlayerCount = 0;
+	TeamSizes.Reserve(Teams.Num());
+	for (const TArray<FOpenSkillRating>& Team : Teams)
+	{
+		TeamSizes.Add(Team.Num());
+		PlayerCount += Team.Num();
+	}
+
+	// Beta is the only option the predictions depend on.
+	Values.Reserve(1 + PlayerCount * 2);
+	Values.Add(Options.Beta);
+	for (const TArray<FOpenSkillRating>& Team : Teams)
+	{
+		for (const FOpenSkillRating& Member : Team)
+		{
+			Values.Add(Member.Mu);
+			Values.Add(Member.Sigma);
+		}
+	}
+
+	const uint64 SizesHash = CityHash64WithSeed(reinterpret_cast<const char*>(TeamSizes.GetData()), TeamSizes.Num() * sizeof(int32), static_cast<uint64>(Kind));
+	Hash = CityHash64WithSeed(reinterpret_cast<const char*>(Values.GetData()), Values.Num() * sizeof(double), SizesHash);
+}
+
+FOpenSkillPredictionCache::FOpenSkillPredictionCache(const int32 InMaxEntries)
+	: MaxEntries(InMaxEntries)
+	, Entries(InMaxEntries)
+	, Hits(0)
+	, Misses(0)
+{
+	check(InMaxEntries > 0)
+}
+
+bool FOpenSkillPredictionCache::Find(const FOpenSkillPredictionKey& Key, FOpenSkillCachedPrediction& OutPrediction)
+{
+	FScopeLock ScopeLock(&Lock);
+	if (const FOpenSkillCachedPrediction* Prediction = Entries.FindAndTouch(Key))
+	{
+		OutPrediction = *Prediction;
+		Hits.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+	Misses.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+void FOpenSkillPredictionCache::Add(const FOpenSkillPredictionKey& Key, const FOpenSkillCachedPrediction& Prediction)
+{
+	FScopeLock ScopeLock(&Lock);
+	Entries.Add(Key, Prediction);
+}
+
+void FOpenSkillPredictionCache::Empty()
+{
+	FScopeLock ScopeLock(&Lock);
+	Entries.Empty(MaxEntries);
+}
+
+int32 FOpenSkillPredictionCache::Num() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return Entries.Num();
+}
+
+void FOpenSkillPredictionCache::ResetStats()
+{
+	Hits.store(0, std::memory_order_relaxed);
+	Misses.store(0, std::memory_order_relaxed);
+}
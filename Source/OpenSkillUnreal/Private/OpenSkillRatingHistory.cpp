@@ -0,0 +1,519 @@
+﻿#include "OpenSkillRatingHistory.h"
+#include "OpenSkillMatchHistory.h"
+#include "OpenSkillSimulation.h"
+#include "OpenSkillUnreal.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogOpenSkillRatingHistory, Log, All);
+
+namespace OpenSkillRatingHistory
+{
+	// A Rice quotient this long is an escape, the value follows in full instead.
+	constexpr uint32 QuotientLimit = 4;
+	// The running mean halves its history this often, so the codes follow a player's ratings settling down.
+	constexpr uint32 RiceHalfLife = 32;
+	// A value counts for at most this many times the current scale in the running mean, so the codes still widen when
+	// the values really grow but one outlier, like the break between two sessions, does not coarsen the codes after it.
+	constexpr uint32 EscapeWeight = 2;
+	// How many values the starting parameter of a block counts for.
+	constexpr uint32 RiceInitialCount = 4;
+	constexpr uint8 MaxRiceK = 56;
+	// The state of a field nothing has been coded in yet, its first value is written in full and seeds the running mean.
+	constexpr uint8 UnseededK = 0xFF;
+
+	uint64 ZigZag(const int64 Value)
+	{
+		return (static_cast<uint64>(Value) << 1) ^ static_cast<uint64>(Value >> 63);
+	}
+
+	int64 UnZigZag(const uint64 Value)
+	{
+		return static_cast<int64>(Value >> 1) ^ -static_cast<int64>(Value & 1);
+	}
+
+	// Bits are packed least significant first.
+	void WriteBits(TArray<uint8>& Out, int32& NumFreeBits, uint64 Value, int32 Count)
+	{
+		while (Count > 0)
+		{
+			if (NumFreeBits == 0)
+			{
+				Out.Add(0);
+				NumFreeBits = 8;
+			}
+			const int32 Written = FMath::Min(NumFreeBits, Count);
+			Out.Last() |= static_cast<uint8>((Value & ((1ull << Written) - 1)) << (8 - NumFreeBits));
+			Value >>= Written;
+			Count -= Written;
+			NumFreeBits -= Written;
+		}
+	}
+
+	// Only ever reads what the writer produced, the end is only checked to avoid loading past it.
+	struct FBitReader
+	{
+		const uint8* Data;
+		int64 NumBytes;
+		uint64 Position;
+
+		// At least the next 57 bits, fewer only near the end of the data.
+		uint64 Peek() const
+		{
+			const int64 Byte = static_cast<int64>(Position >> 3);
+			uint64 Window = 0;
+			if (Byte + 8 <= NumBytes)
+			{
+				FMemory::Memcpy(&Window, Data + Byte, 8);
+			}
+			else
+			{
+				for (int64 i = Byte; i < NumBytes; ++i)
+				{
+					Window |= static_cast<uint64>(Data[i]) << ((i - Byte) * 8);
+				}
+			}
+			return Window >> (Position & 7);
+		}
+
+		uint64 ReadBits(const int32 Count)
+		{
+			if (Count > 56)
+			{
+				const uint64 Low = ReadBits(32);
+				return Low | ReadBits(Count - 32) << 32;
+			}
+			const uint64 Value = Peek() & ((1ull << Count) - 1);
+			Position += Count;
+			return Value;
+		}
+	};
+
+	// Any value but 0, as its bit length and the bits below the leading one.
+	void WriteRaw(TArray<uint8>& Out, int32& NumFreeBits, const uint64 Value)
+	{
+		const int32 Length = static_cast<int32>(FMath::FloorLog2_64(Value));
+		WriteBits(Out, NumFreeBits, Length, 6);
+		WriteBits(Out, NumFreeBits, Value, Length);
+	}
+
+	uint64 ReadRaw(FBitReader& Reader)
+	{
+		const int32 Length = static_cast<int32>(Reader.ReadBits(6));
+		return 1ull << Length | Reader.ReadBits(Length);
+	}
+
+	template <typename StateType>
+	uint8 GetRiceK(const StateType& State)
+	{
+		if (State.Count == 0)
+		{
+			return UnseededK;
+		}
+		// The smallest K with Count << K >= Sum.
+		const uint64 Mean = (State.Sum + State.Count - 1) / State.Count;
+		return Mean <= 1 ? 0 : static_cast<uint8>(FMath::Min<uint64>(FMath::FloorLog2_64(Mean - 1) + 1, MaxRiceK));
+	}
+
+	template <typename StateType>
+	void ResetRice(StateType& State, const uint8 K)
+	{
+		State.Count = K == UnseededK ? 0 : RiceInitialCount;
+		State.Sum = K == UnseededK ? 0 : static_cast<uint64>(RiceInitialCount) << K;
+	}
+
+	template <typename StateType>
+	void UpdateRice(StateType& State, const uint64 Value, const uint8 K)
+	{
+		State.Sum += FMath::Min(Value, static_cast<uint64>(EscapeWeight) << K);
+		if (++State.Count == RiceHalfLife)
+		{
+			State.Sum >>= 1;
+			State.Count >>= 1;
+		}
+	}
+
+	// @return False if the quotient was too long for unary and was escaped.
+	template <typename StateType>
+	bool WriteRice(TArray<uint8>& Out, int32& NumFreeBits, StateType& State, const uint64 Value)
+	{
+		if (State.Count == 0)
+		{
+			WriteRaw(Out, NumFreeBits, Value + 1);
+			State.Sum = Value;
+			State.Count = 1;
+			return true;
+		}
+		const uint8 K = GetRiceK(State);
+		const uint64 Quotient = Value >> K;
+		UpdateRice(State, Value, K);
+		if (Quotient >= QuotientLimit)
+		{
+			WriteBits(Out, NumFreeBits, (1ull << QuotientLimit) - 1, QuotientLimit);
+			WriteRaw(Out, NumFreeBits, Quotient - QuotientLimit + 1);
+			WriteBits(Out, NumFreeBits, Value, K);
+			return false;
+		}
+		WriteBits(Out, NumFreeBits, (1ull << Quotient) - 1, static_cast<int32>(Quotient) + 1);
+		WriteBits(Out, NumFreeBits, Value, K);
+		return true;
+	}
+
+	template <typename StateType>
+	uint64 ReadRice(FBitReader& Reader, StateType& State, bool& bOutEscaped)
+	{
+		if (State.Count == 0)
+		{
+			bOutEscaped = false;
+			State.Sum = ReadRaw(Reader) - 1;
+			State.Count = 1;
+			return State.Sum;
+		}
+		const uint8 K = GetRiceK(State);
+		uint64 Value;
+		const uint64 Window = Reader.Peek();
+		const uint32 Quotient = static_cast<uint32>(FMath::CountTrailingZeros64(~Window));
+		bOutEscaped = Quotient >= QuotientLimit;
+		if (!bOutEscaped && Quotient + 1 + K <= 57)
+		{
+			// The common case, quotient and remainder both come out of one load.
+			Value = static_cast<uint64>(Quotient) << K | (Window >> (Quotient + 1) & ((1ull << K) - 1));
+			Reader.Position += Quotient + 1 + K;
+		}
+		else
+		{
+			Reader.Position += bOutEscaped ? QuotientLimit : Quotient + 1;
+			const uint64 FullQuotient = bOutEscaped ? QuotientLimit + ReadRaw(Reader) - 1 : Quotient;
+			Value = FullQuotient << K | Reader.ReadBits(K);
+		}
+		UpdateRice(State, Value, K);
+		return Value;
+	}
+
+	int32 Quantize(const double Value, const double Resolution)
+	{
+		return static_cast<int32>(FMath::FloorToDouble(Value / Resolution + 0.5));
+	}
+
+	void Record(const TArray<FString>& Args)
+	{
+		FOpenSkillSimulationConfig Config = FOpenSkillSimulationConfig::Duel();
+		if (Args.Num() > 0 && !FOpenSkillSimulationConfig::FromName(Args[0], Config))
+		{
+			UE_LOG(LogOpenSkillRatingHistory, Error, TEXT("Unknown match format '%s', expected 1v1, 5v5, Squads or FFA."), *Args[0]);
+			return;
+		}
+		if (Args.Num() > 1)
+		{
+			Config.Seed = FCString::Atoi(*Args[1]);
+		}
+		if (Args.Num() > 2)
+		{
+			Config.NumMatches = FMath::Max(FCString::Atoi(*Args[2]), 1);
+		}
+
+		const FOpenSkillSimulation Simulation(Config);
+		const FOpenSkillMatchHistory History = Simulation.GetHistory();
+		FOpenSkillUnrealModule Module;
+		const FOpenSkillCompiledOptionsPin Snapshot = Module.GetCompiledOptions();
+		const FOpenSkillOptions& Options = Snapshot->Options;
+
+		TArray<FOpenSkillRating> Ratings;
+		Ratings.Init(FOpenSkillRating(Options.Mu, Options.Sigma), History.GetNumPlayers());
+		TArray<FOpenSkillRatingHistory> Histories;
+		Histories.SetNum(History.GetNumPlayers());
+
+		// The simulation has no clock, timestamps are minutes with matches finishing at a steady rate.
+		constexpr int MatchesPerMinute = 100;
+		double EncodeSeconds = 0;
+		TArray<TTuple<TArray<FOpenSkillRating>, int>> Teams;
+		for (int Match = 0; Match < History.Num(); ++Match)
+		{
+			Teams.SetNum(History.GetNumTeams(Match));
+			for (int Team = 0; Team < Teams.Num(); ++Team)
+			{
+				Teams[Team].Key.Reset();
+				for (const int32 Player : History.GetTeamPlayers(Match, Team))
+				{
+					Teams[Team].Key.Add(Ratings[Player]);
+				}
+				Teams[Team].Value = History.GetTeamRank(Match, Team);
+			}
+			const TArray<TArray<FOpenSkillRating>> Rated = Module.RateByRank(Teams);
+
+			const double StartTime = FPlatformTime::Seconds();
+			for (int Team = 0; Team < Rated.Num(); ++Team)
+			{
+				const TArrayView<const int32> Players = History.GetTeamPlayers(Match, Team);
+				for (int Member = 0; Member < Players.Num(); ++Member)
+				{
+					Ratings[Players[Member]] = Rated[Team][Member];
+					Histories[Players[Member]].Append(Match / MatchesPerMinute, Rated[Team][Member]);
+				}
+			}
+			EncodeSeconds += FPlatformTime::Seconds() - StartTime;
+		}
+
+		SIZE_T Bytes = 0;
+		int64 NumPoints = 0;
+		TArray<FOpenSkillRatingHistoryPoint> Points;
+		const double StartTime = FPlatformTime::Seconds();
+		for (FOpenSkillRatingHistory& PlayerHistory : Histories)
+		{
+			PlayerHistory.Shrink();
+			PlayerHistory.GetRange(0, History.Num() / MatchesPerMinute + 1, Points);
+			Bytes += PlayerHistory.GetAllocatedSize();
+			NumPoints += Points.Num();
+		}
+		const double DecodeSeconds = FPlatformTime::Seconds() - StartTime;
+
+		const double RawBytes = static_cast<double>(NumPoints) * (2 * sizeof(double) + sizeof(int64));
+		UE_LOG(LogOpenSkillRatingHistory, Display, TEXT("%lld points in %llu bytes, %.2f bytes per point, %.1fx smaller than raw, %.0f appends/s, %.0f points decoded/s"),
+		       NumPoints, static_cast<uint64>(Bytes), NumPoints > 0 ? Bytes / static_cast<double>(NumPoints) : 0.0, Bytes > 0 ? RawBytes / Bytes : 0.0,
+		       EncodeSeconds > 0 ? NumPoints / EncodeSeconds : 0.0, DecodeSeconds > 0 ? NumPoints / DecodeSeconds : 0.0);
+	}
+
+	FAutoConsoleCommand RecordCommand(
+		TEXT("OpenSkill.History"),
+		TEXT("Record every rating of a synthetic population compressed and report the storage used. Usage: OpenSkill.History [1v1|5v5|Squads|FFA] [Seed] [Matches]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&Record));
+}
+
+FOpenSkillRatingHistory::FOpenSkillRatingHistory(const double InMuResolution, const double InSigmaResolution)
+	: MuResolution(InMuResolution)
+	, SigmaResolution(InSigmaResolution)
+	, NumPoints(0)
+	, ReferenceTimeDelta(0)
+	, NumFreeBits(0)
+{
+	check(MuResolution > 0 && SigmaResolution > 0)
+}
+
+void FOpenSkillRatingHistory::Append(const int64 Time, const FOpenSkillRating& Rating)
+{
+	using namespace OpenSkillRatingHistory;
+
+	const int32 Mu = Quantize(Rating.Mu, MuResolution);
+	const int32 Sigma = Quantize(Rating.Sigma, SigmaResolution);
+
+	if (NumPoints++ % PointsPerBlock == 0)
+	{
+		// The first point of a block is written in full, so the block decodes without anything before it.
+		checkf(Blocks.Num() == 0 || Time >= Blocks.Last().LastTime, TEXT("Rating history points must be appended in time order"))
+		FBlock& Block = Blocks.AddDefaulted_GetRef();
+		Block.DataOffset = Data.Num();
+		Block.FirstTime = Block.LastTime = Time;
+		Block.LastMu = Block.MinMu = Block.MaxMu = Mu;
+		Block.LastSigma = Sigma;
+		Block.TimeK = GetRiceK(TimeState);
+		Block.MuK = GetRiceK(MuState);
+		Block.SigmaK = GetRiceK(SigmaState);
+		ResetRice(TimeState, Block.TimeK);
+		ResetRice(MuState, Block.MuK);
+		ResetRice(SigmaState, Block.SigmaK);
+		NumFreeBits = 0;
+		WriteRaw(Data, NumFreeBits, ZigZag(Mu) + 1);
+		WriteRaw(Data, NumFreeBits, ZigZag(Sigma) + 1);
+		WriteRaw(Data, NumFreeBits, ZigZag(ReferenceTimeDelta) + 1);
+		return;
+	}
+
+	FBlock& Block = Blocks.Last();
+	checkf(Time >= Block.LastTime, TEXT("Rating history points must be appended in time order"))
+	const int64 TimeDelta = Time - Block.LastTime;
+	if (WriteRice(Data, NumFreeBits, TimeState, ZigZag(TimeDelta - ReferenceTimeDelta)))
+	{
+		ReferenceTimeDelta = TimeDelta;
+	}
+	WriteRice(Data, NumFreeBits, MuState, ZigZag(static_cast<int64>(Mu) - Block.LastMu));
+	WriteRice(Data, NumFreeBits, SigmaState, ZigZag(static_cast<int64>(Sigma) - Block.LastSigma));
+
+	Block.LastTime = Time;
+	Block.LastMu = Mu;
+	Block.LastSigma = Sigma;
+	Block.MinMu = FMath::Min(Block.MinMu, Mu);
+	Block.MaxMu = FMath::Max(Block.MaxMu, Mu);
+}
+
+template <typename VisitorType>
+void FOpenSkillRatingHistory::DecodeBlock(const int32 BlockIndex, const VisitorType& Visitor) const
+{
+	using namespace OpenSkillRatingHistory;
+
+	const FBlock& Block = Blocks[BlockIndex];
+	FBitReader Reader{Data.GetData(), Data.Num(), static_cast<uint64>(Block.DataOffset) * 8};
+	int64 Time = Block.FirstTime;
+	int64 Mu = UnZigZag(ReadRaw(Reader) - 1);
+	int64 Sigma = UnZigZag(ReadRaw(Reader) - 1);
+	int64 Reference = UnZigZag(ReadRaw(Reader) - 1);
+	Visitor(Time, static_cast<int32>(Mu), static_cast<int32>(Sigma));
+
+	FRiceState TimeCode;
+	FRiceState MuCode;
+	FRiceState SigmaCode;
+	ResetRice(TimeCode, Block.TimeK);
+	ResetRice(MuCode, Block.MuK);
+	ResetRice(SigmaCode, Block.SigmaK);
+	bool bEscaped = false;
+	const int32 BlockNumPoints = GetBlockNumPoints(BlockIndex);
+	for (int32 i = 1; i < BlockNumPoints; ++i)
+	{
+		const int64 TimeDelta = Reference + UnZigZag(ReadRice(Reader, TimeCode, bEscaped));
+		if (!bEscaped)
+		{
+			Reference = TimeDelta;
+		}
+		Time += TimeDelta;
+		Mu += UnZigZag(ReadRice(Reader, MuCode, bEscaped));
+		Sigma += UnZigZag(ReadRice(Reader, SigmaCode, bEscaped));
+		Visitor(Time, static_cast<int32>(Mu), static_cast<int32>(Sigma));
+	}
+}
+
+int32 FOpenSkillRatingHistory::FindFirstBlock(const int64 Time) const
+{
+	int32 Low = 0;
+	int32 High = Blocks.Num();
+	while (Low < High)
+	{
+		const int32 Middle = Low + (High - Low) / 2;
+		if (Blocks[Middle].LastTime < Time)
+		{
+			Low = Middle + 1;
+		}
+		else
+		{
+			High = Middle;
+		}
+	}
+	return Low;
+}
+
+void FOpenSkillRatingHistory::GetRange(const int64 Start, const int64 End, TArray<FOpenSkillRatingHistoryPoint>& OutPoints) const
+{
+	OutPoints.Reset();
+	for (int32 BlockIndex = FindFirstBlock(Start); BlockIndex < Blocks.Num() && Blocks[BlockIndex].FirstTime < End; ++BlockIndex)
+	{
+		DecodeBlock(BlockIndex, [&](const int64 Time, const int32 Mu, const int32 Sigma)
+		{
+			if (Time >= Start && Time < End)
+			{
+				OutPoints.Add({Time, Dequantize(Mu, Sigma)});
+			}
+		});
+	}
+}
+
+void FOpenSkillRatingHistory::GetDownsampled(const int64 Start, const int64 End, const int32 NumBuckets, TArray<FOpenSkillRatingHistoryBucket>& OutBuckets) const
+{
+	OutBuckets.Reset();
+	if (NumBuckets <= 0 || End <= Start)
+	{
+		return;
+	}
+
+	const int64 BucketWidth = FMath::DivideAndRoundUp<int64>(End - Start, NumBuckets);
+	OutBuckets.SetNum(NumBuckets);
+	for (int32 i = 0; i < NumBuckets; ++i)
+	{
+		OutBuckets[i].StartTime = Start + i * BucketWidth;
+	}
+
+	const auto AddToBucket = [&](const int64 Time, const double MinMu, const double MaxMu, const FOpenSkillRating& Last, const int32 Count)
+	{
+		FOpenSkillRatingHistoryBucket& Bucket = OutBuckets[static_cast<int32>((Time - Start) / BucketWidth)];
+		Bucket.MinMu = Bucket.NumPoints > 0 ? FMath::Min(Bucket.MinMu, MinMu) : MinMu;
+		Bucket.MaxMu = Bucket.NumPoints > 0 ? FMath::Max(Bucket.MaxMu, MaxMu) : MaxMu;
+		Bucket.Rating = Last;
+		Bucket.NumPoints += Count;
+	};
+
+	for (int32 BlockIndex = FindFirstBlock(Start); BlockIndex < Blocks.Num() && Blocks[BlockIndex].FirstTime < End; ++BlockIndex)
+	{
+		const FBlock& Block = Blocks[BlockIndex];
+		if (Block.FirstTime >= Start && Block.LastTime < End && (Block.FirstTime - Start) / BucketWidth == (Block.LastTime - Start) / BucketWidth)
+		{
+			AddToBucket(Block.LastTime, Block.MinMu * MuResolution, Block.MaxMu * MuResolution, Dequantize(Block.LastMu, Block.LastSigma), GetBlockNumPoints(BlockIndex));
+			continue;
+		}
+
+		DecodeBlock(BlockIndex, [&](const int64 Time, const int32 Mu, const int32 Sigma)
+		{
+			if (Time >= Start && Time < End)
+			{
+				AddToBucket(Time, Mu * MuResolution, Mu * MuResolution, Dequantize(Mu, Sigma), 1);
+			}
+		});
+	}
+
+	// A player's rating holds between matches, so empty buckets repeat whatever came before them.
+	TOptional<FOpenSkillRating> Carry = GetRatingAt(Start - 1);
+	for (FOpenSkillRatingHistoryBucket& Bucket : OutBuckets)
+	{
+		if (Bucket.NumPoints > 0)
+		{
+			Carry = Bucket.Rating;
+		}
+		else if (Carry.IsSet())
+		{
+			Bucket.MinMu = Bucket.MaxMu = Carry.GetValue().Mu;
+			Bucket.Rating = Carry.GetValue();
+		}
+	}
+}
+
+TOptional<FOpenSkillRating> FOpenSkillRatingHistory::GetRatingAt(const int64 Time) const
+{
+	// The last block starting at or before Time holds the answer.
+	int32 Low = 0;
+	int32 High = Blocks.Num();
+	while (Low < High)
+	{
+		const int32 Middle = Low + (High - Low) / 2;
+		if (Blocks[Middle].FirstTime <= Time)
+		{
+			Low = Middle + 1;
+		}
+		else
+		{
+			High = Middle;
+		}
+	}
+	if (Low == 0)
+	{
+		return TOptional<FOpenSkillRating>();
+	}
+
+	const FBlock& Block = Blocks[Low - 1];
+	if (Block.LastTime <= Time)
+	{
+		return Dequantize(Block.LastMu, Block.LastSigma);
+	}
+
+	FOpenSkillRating Rating;
+	DecodeBlock(Low - 1, [&](const int64 PointTime, const int32 Mu, const int32 Sigma)
+	{
+		if (PointTime <= Time)
+		{
+			Rating = Dequantize(Mu, Sigma);
+		}
+	});
+	return Rating;
+}
+
+void FOpenSkillRatingHistory::Empty()
+{
+	Data.Empty();
+	Blocks.Empty();
+	NumPoints = 0;
+	TimeState = FRiceState();
+	MuState = FRiceState();
+	SigmaState = FRiceState();
+	ReferenceTimeDelta = 0;
+	NumFreeBits = 0;
+}
+
+void FOpenSkillRatingHistory::Shrink()
+{
+	Data.Shrink();
+	Blocks.Shrink();
+}
@@ -0,0 +1,636 @@
+﻿#include "OpenSkillReplication.h"
+#include "OpenSkillSimulation.h"
+#include "OpenSkillUnreal.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/ScopeLock.h"
+#include <atomic>
+
+DEFINE_LOG_CATEGORY_STATIC(LogOpenSkillReplication, Log, All);
+
+namespace OpenSkillReplication
+{
+	enum class EFrameType : uint8
+	{
+		Delta = 1,
+		Snapshot = 2
+	};
+
+	// Deltas kept while waiting for a snapshot, past this the replica just asks for another one.
+	constexpr int32 MaxPendingDeltas = 4096;
+
+	void WriteVarint(TArray<uint8>& Out, uint64 Value)
+	{
+		while (Value >= 0x80)
+		{
+			Out.Add(static_cast<uint8>(Value | 0x80));
+			Value >>= 7;
+		}
+		Out.Add(static_cast<uint8>(Value));
+	}
+
+	bool ReadVarint(const uint8*& Cursor, const uint8* End, uint64& OutValue)
+	{
+		OutValue = 0;
+		for (int Shift = 0; Shift < 64; Shift += 7)
+		{
+			if (Cursor == End)
+			{
+				return false;
+			}
+			const uint8 Byte = *Cursor++;
+			OutValue |= static_cast<uint64>(Byte & 0x7F) << Shift;
+			if ((Byte & 0x80) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void WriteDouble(TArray<uint8>& Out, const double Value)
+	{
+		const int32 Offset = Out.AddUninitialized(sizeof(double));
+		FMemory::Memcpy(Out.GetData() + Offset, &Value, sizeof(double));
+	}
+
+	bool ReadDouble(const uint8*& Cursor, const uint8* End, double& OutValue)
+	{
+		if (End - Cursor < static_cast<int64>(sizeof(double)))
+		{
+			return false;
+		}
+		FMemory::Memcpy(&OutValue, Cursor, sizeof(double));
+		Cursor += sizeof(double);
+		return true;
+	}
+
+	struct FWireEntry
+	{
+		FOpenSkillPlayerId Player;
+		uint64 Version;
+		FOpenSkillRating Rating;
+	};
+
+	TArray<uint8> EncodeFrame(const EFrameType Type, const uint64 Sequence, TArray<FWireEntry>& Entries)
+	{
+		Entries.Sort([](const FWireEntry& Lhs, const FWireEntry& Rhs)
+		{
+			return Lhs.Player < Rhs.Player;
+		});
+
+		TArray<uint8> Payload;
+		Payload.Reserve(20 + Entries.Num() * 24);
+		WriteVarint(Payload, Sequence);
+		WriteVarint(Payload, Entries.Num());
+		FOpenSkillPlayerId PreviousPlayer = 0;
+		for (const FWireEntry& Entry : Entries)
+		{
+			WriteVarint(Payload, Entry.Player - PreviousPlayer);
+			WriteVarint(Payload, Entry.Version);
+			WriteDouble(Payload, Entry.Rating.Mu);
+			WriteDouble(Payload, Entry.Rating.Sigma);
+			PreviousPlayer = Entry.Player;
+		}
+
+		TArray<uint8> Frame;
+		Frame.Reserve(Payload.Num() + 11);
+		Frame.Add(static_cast<uint8>(Type));
+		WriteVarint(Frame, Payload.Num());
+		Frame.Append(Payload);
+		return Frame;
+	}
+
+	bool DecodePayload(const TArray<uint8>& Payload, uint64& OutSequence, TArray<FWireEntry>& OutEntries)
+	{
+		const uint8* Cursor = Payload.GetData();
+		const uint8* End = Cursor + Payload.Num();
+		uint64 Count;
+		if (!ReadVarint(Cursor, End, OutSequence) || !ReadVarint(Cursor, End, Count) || Count > static_cast<uint64>(Payload.Num()))
+		{
+			return false;
+		}
+
+		OutEntries.Reset(static_cast<int32>(Count));
+		FOpenSkillPlayerId Player = 0;
+		for (uint64 i = 0; i < Count; ++i)
+		{
+			uint64 PlayerDelta;
+			FWireEntry& Entry = OutEntries.AddDefaulted_GetRef();
+			if (!ReadVarint(Cursor, End, PlayerDelta) || !ReadVarint(Cursor, End, Entry.Version)
+				|| !ReadDouble(Cursor, End, Entry.Rating.Mu) || !ReadDouble(Cursor, End, Entry.Rating.Sigma))
+			{
+				return false;
+			}
+			Player += PlayerDelta;
+			Entry.Player = Player;
+		}
+		return Cursor == End;
+	}
+
+	void Replicate(const TArray<FString>& Args)
+	{
+		FOpenSkillSimulationConfig Config = FOpenSkillSimulationConfig::FiveVersusFive();
+		if (Args.Num() > 0)
+		{
+			Config.NumMatches = FMath::Max(FCString::Atoi(*Args[0]), 1);
+		}
+
+		FOpenSkillReplicationPipe Pipe;
+		if (!Pipe.IsValid())
+		{
+			UE_LOG(LogOpenSkillReplication, Error, TEXT("Could not create a pipe."));
+			return;
+		}
+		FOpenSkillReplicationPublisher Publisher([&Pipe](TArrayView<const uint8> Frame)
+		{
+			return Pipe.Write(Frame);
+		});
+		FOpenSkillReplica Replica([&Publisher](uint64)
+		{
+			Publisher.PublishSnapshot();
+		});
+
+		// Rate the simulated matches on the primary, the replica drains the pipe after every match.
+		const FOpenSkillSimulation Simulation(Config);
+		const FOpenSkillUnrealModule& Module = FOpenSkillUnrealModule::Get();
+		TArray<FOpenSkillRating> Ratings;
+		Ratings.Init(Module.GetDefaultRating(), Config.PopulationSize);
+		TArray<TArray<FOpenSkillPlayerId>> Players;
+		TArray<TArray<FOpenSkillRating>> Teams;
+		Players.SetNum(Config.NumTeams);
+		Teams.SetNum(Config.NumTeams);
+		for (int Match = 0; Match < Config.NumMatches; ++Match)
+		{
+			const TArrayView<const int32> MatchPlayers = Simulation.GetMatchPlayers(Match);
+			for (int Team = 0; Team < Config.NumTeams; ++Team)
+			{
+				Players[Team].Reset();
+				Teams[Team].Reset();
+				for (int Member = 0; Member < Config.TeamSize; ++Member)
+				{
+					const int32 Player = MatchPlayers[Team * Config.TeamSize + Member];
+					Players[Team].Add(Player);
+					Teams[Team].Add(Ratings[Player]);
+				}
+			}
+			const TArray<TArray<FOpenSkillRating>> Rated = Module.RateByOrdinal(Teams);
+			for (int Team = 0; Team < Config.NumTeams; ++Team)
+			{
+				for (int Member = 0; Member < Config.TeamSize; ++Member)
+				{
+					Ratings[Players[Team][Member]] = Rated[Team][Member];
+				}
+			}
+			Publisher.PublishMatch(Players, Rated);
+			Pipe.Pump(Replica);
+		}
+
+		// The transport thread may be blocked on a full pipe, keep draining it until every frame has been written.
+		while (!Publisher.Flush(1))
+		{
+			Pipe.Pump(Replica);
+		}
+		Pipe.Pump(Replica);
+
+		int32 Mismatches = 0;
+		for (int Player = 0; Player < Config.PopulationSize; ++Player)
+		{
+			const TOptional<FOpenSkillRating> Replicated = Replica.FindRating(Player);
+			Mismatches += Replicated.IsSet() && (Replicated->Mu != Ratings[Player].Mu || Replicated->Sigma != Ratings[Player].Sigma) ? 1 : 0;
+		}
+		UE_LOG(LogOpenSkillReplication, Display, TEXT("%d matches, %llu bytes of deltas (%.1f per match), one snapshot is %d bytes, replica at sequence %llu with %d mismatches, %d failed writes"),
+		       Config.NumMatches, Publisher.GetBytesPublished(), static_cast<double>(Publisher.GetBytesPublished()) / Config.NumMatches,
+		       Publisher.MakeSnapshot().Num(), Replica.GetSequence(), Mismatches, Publisher.GetNumBrokenStreams());
+	}
+
+	FAutoConsoleCommand ReplicateCommand(
+		TEXT("OpenSkill.Replicate"),
+		TEXT("Replicate a simulated 5v5 season to a replica over a local pipe. Usage: OpenSkill.Replicate [Matches]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&Replicate));
+}
+
+class FOpenSkillReplicationTransport : public FRunnable
+{
+public:
+	explicit FOpenSkillReplicationTransport(FOpenSkillReplicationPublisher& InPublisher)
+		: Publisher(InPublisher)
+		, WorkEvent(FPlatformProcess::GetSynchEventFromPool(false))
+	{
+		Thread = FRunnableThread::Create(this, TEXT("OpenSkillReplicationTransport"));
+	}
+
+	virtual ~FOpenSkillReplicationTransport() override
+	{
+		bStopping = true;
+		WorkEvent->Trigger();
+		Thread->WaitForCompletion();
+		delete Thread;
+		FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+	}
+
+	void Wake()
+	{
+		WorkEvent->Trigger();
+	}
+
+	virtual uint32 Run() override
+	{
+		for (;;)
+		{
+			// Read the flag before draining so frames queued ahead of the stop are still sent.
+			const bool bStop = bStopping;
+			Publisher.SendQueued();
+			if (bStop)
+			{
+				return 0;
+			}
+			WorkEvent->Wait();
+		}
+	}
+
+private:
+	FOpenSkillReplicationPublisher& Publisher;
+	FRunnableThread* Thread = nullptr;
+	FEvent* WorkEvent;
+	std::atomic<bool> bStopping{false};
+};
+
+FOpenSkillReplicationPublisher::FOpenSkillReplicationPublisher(FOnFrame InOnFrame)
+	: OnFrame(MoveTemp(InOnFrame))
+	, IdleEvent(FPlatformProcess::GetSynchEventFromPool(true))
+{
+	IdleEvent->Trigger();
+	Transport = MakeUnique<FOpenSkillReplicationTransport>(*this);
+}
+
+FOpenSkillReplicationPublisher::~FOpenSkillReplicationPublisher()
+{
+	Transport.Reset();
+	FPlatformProcess::ReturnSynchEventToPool(IdleEvent);
+}
+
+void FOpenSkillReplicationPublisher::Publish(TArrayView<const FOpenSkillPlayerId> Players, TArrayView<const FOpenSkillRating> Ratings)
+{
+	using namespace OpenSkillReplication;
+	check(Players.Num() == Ratings.Num())
+
+	TArray<FWireEntry> Changes;
+	Changes.Reserve(Players.Num());
+
+	FScopeLock ScopeLock(&Lock);
+	for (int i = 0; i < Players.Num(); ++i)
+	{
+		FEntry& Entry = Entries.FindOrAdd(Players[i]);
+		Entry.Rating = Ratings[i];
+		++Entry.Version;
+		Changes.Add({Players[i], Entry.Version, Entry.Rating});
+	}
+
+	++Sequence;
+	// The receiver may hold part of an earlier frame, so send the whole table, this commit included, instead of the delta.
+	QueueFrame(bStreamBroken ? EncodeSnapshot() : EncodeFrame(EFrameType::Delta, Sequence, Changes));
+}
+
+void FOpenSkillReplicationPublisher::PublishMatch(const TArray<TArray<FOpenSkillPlayerId>>& Players, const TArray<TArray<FOpenSkillRating>>& Ratings)
+{
+	check(Players.Num() == Ratings.Num())
+	TArray<FOpenSkillPlayerId> FlatPlayers;
+	TArray<FOpenSkillRating> FlatRatings;
+	for (int Team = 0; Team < Players.Num(); ++Team)
+	{
+		FlatPlayers.Append(Players[Team]);
+		FlatRatings.Append(Ratings[Team]);
+	}
+	Publish(FlatPlayers, FlatRatings);
+}
+
+void FOpenSkillReplicationPublisher::PublishSnapshot()
+{
+	FScopeLock ScopeLock(&Lock);
+	QueueFrame(EncodeSnapshot());
+}
+
+TArray<uint8> FOpenSkillReplicationPublisher::MakeSnapshot() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return EncodeSnapshot();
+}
+
+bool FOpenSkillReplicationPublisher::Flush(const uint32 WaitMs)
+{
+	return IdleEvent->Wait(WaitMs);
+}
+
+uint64 FOpenSkillReplicationPublisher::GetSequence() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return Sequence;
+}
+
+uint64 FOpenSkillReplicationPublisher::GetBytesPublished() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return BytesPublished;
+}
+
+int32 FOpenSkillReplicationPublisher::GetNumBrokenStreams() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return NumBrokenStreams;
+}
+
+void FOpenSkillReplicationPublisher::QueueFrame(TArray<uint8>&& Frame)
+{
+	// Called with Lock held.
+	bStreamBroken = false;
+	BytesPublished += Frame.Num();
+	if (NumQueued++ == 0)
+	{
+		IdleEvent->Reset();
+	}
+	Outbound.Enqueue(MoveTemp(Frame));
+	Transport->Wake();
+}
+
+void FOpenSkillReplicationPublisher::SendQueued()
+{
+	TArray<uint8> Frame;
+	while (Outbound.Dequeue(Frame))
+	{
+		const bool bSent = !OnFrame || OnFrame(Frame);
+
+		FScopeLock ScopeLock(&Lock);
+		if (!bSent)
+		{
+			// Nothing queued behind a partly sent frame can be applied, drop it all until the next frame replaces it with a snapshot.
+			++NumBrokenStreams;
+			bStreamBroken = true;
+			while (Outbound.Dequeue(Frame))
+			{
+				--NumQueued;
+			}
+		}
+		if (--NumQueued == 0)
+		{
+			IdleEvent->Trigger();
+		}
+	}
+}
+
+TArray<uint8> FOpenSkillReplicationPublisher::EncodeSnapshot() const
+{
+	using namespace OpenSkillReplication;
+	TArray<FWireEntry> All;
+	All.Reserve(Entries.Num());
+	for (const auto& Pair : Entries)
+	{
+		All.Add({Pair.Key, Pair.Value.Version, Pair.Value.Rating});
+	}
+	return EncodeFrame(EFrameType::Snapshot, Sequence, All);
+}
+
+FOpenSkillReplica::FOpenSkillReplica(FOnSnapshotNeeded InOnSnapshotNeeded)
+	: OnSnapshotNeeded(MoveTemp(InOnSnapshotNeeded))
+{
+}
+
+bool FOpenSkillReplica::Receive(TArrayView<const uint8> Bytes)
+{
+	using namespace OpenSkillReplication;
+	Buffer.Append(Bytes.GetData(), Bytes.Num());
+
+	int32 Consumed = 0;
+	bool bValid = true;
+	while (bValid)
+	{
+		const uint8* Cursor = Buffer.GetData() + Consumed;
+		const uint8* End = Buffer.GetData() + Buffer.Num();
+		if (Cursor == End)
+		{
+			break;
+		}
+		const EFrameType Type = static_cast<EFrameType>(*Cursor++);
+		uint64 PayloadSize;
+		if (!ReadVarint(Cursor, End, PayloadSize))
+		{
+			// A varint longer than ten bytes can never complete.
+			bValid = End - Cursor < 10;
+			break;
+		}
+		if (static_cast<uint64>(End - Cursor) < PayloadSize)
+		{
+			break;
+		}
+
+		TArray<uint8> Payload(Cursor, static_cast<int32>(PayloadSize));
+		Consumed = static_cast<int32>(Cursor - Buffer.GetData()) + static_cast<int32>(PayloadSize);
+		switch (Type)
+		{
+		case EFrameType::Delta:
+			bValid = HandleDelta(MoveTemp(Payload));
+			break;
+		case EFrameType::Snapshot:
+			bValid = HandleSnapshot(Payload);
+			break;
+		default:
+			bValid = false;
+			break;
+		}
+	}
+
+	if (!bValid)
+	{
+		Buffer.Reset();
+		{
+			FWriteScopeLock WriteLock(Lock);
+			bSynchronized = false;
+			++NumResyncs;
+		}
+		RequestSnapshot();
+		return false;
+	}
+	Buffer.RemoveAt(0, Consumed);
+	return true;
+}
+
+void FOpenSkillReplica::Reconnect()
+{
+	Buffer.Reset();
+}
+
+bool FOpenSkillReplica::HandleDelta(TArray<uint8>&& Payload)
+{
+	using namespace OpenSkillReplication;
+	uint64 FrameSequence;
+	TArray<FWireEntry> Changes;
+	if (!DecodePayload(Payload, FrameSequence, Changes))
+	{
+		return false;
+	}
+
+	bool bGap = false;
+	{
+		FWriteScopeLock WriteLock(Lock);
+		if (!bSynchronized || FrameSequence > Sequence + 1)
+		{
+			if (bSynchronized)
+			{
+				bSynchronized = false;
+				++NumResyncs;
+				bGap = true;
+			}
+			if (Pending.Num() < MaxPendingDeltas)
+			{
+				Pending.Add(MoveTemp(Payload));
+			}
+		}
+		else if (FrameSequence == Sequence + 1)
+		{
+			for (const FWireEntry& Change : Changes)
+			{
+				FEntry& Entry = Entries.FindOrAdd(Change.Player);
+				if (Change.Version > Entry.Version)
+				{
+					Entry.Rating = Change.Rating;
+					Entry.Version = Change.Version;
+				}
+			}
+			Sequence = FrameSequence;
+		}
+		// Anything older was already applied.
+	}
+
+	if (bGap)
+	{
+		RequestSnapshot();
+	}
+	return true;
+}
+
+bool FOpenSkillReplica::HandleSnapshot(const TArray<uint8>& Payload)
+{
+	using namespace OpenSkillReplication;
+	uint64 FrameSequence;
+	TArray<FWireEntry> All;
+	if (!DecodePayload(Payload, FrameSequence, All))
+	{
+		return false;
+	}
+
+	TArray<TArray<uint8>> Deltas;
+	{
+		FWriteScopeLock WriteLock(Lock);
+		if (bSynchronized && FrameSequence <= Sequence)
+		{
+			return true;
+		}
+		Entries.Empty(All.Num());
+		for (const FWireEntry& Entry : All)
+		{
+			FEntry& NewEntry = Entries.Add(Entry.Player);
+			NewEntry.Rating = Entry.Rating;
+			NewEntry.Version = Entry.Version;
+		}
+		Sequence = FrameSequence;
+		bSynchronized = true;
+		Deltas = MoveTemp(Pending);
+		Pending.Reset();
+	}
+
+	// Catch up with what arrived while waiting, older deltas are skipped and a new gap asks for another snapshot.
+	for (TArray<uint8>& Delta : Deltas)
+	{
+		if (!HandleDelta(MoveTemp(Delta)))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FOpenSkillReplica::RequestSnapshot()
+{
+	if (OnSnapshotNeeded)
+	{
+		OnSnapshotNeeded(GetSequence());
+	}
+}
+
+TOptional<FOpenSkillRating> FOpenSkillReplica::FindRating(const FOpenSkillPlayerId Player) const
+{
+	FReadScopeLock ReadLock(Lock);
+	const FEntry* Entry = Entries.Find(Player);
+	return Entry ? TOptional<FOpenSkillRating>(Entry->Rating) : TOptional<FOpenSkillRating>();
+}
+
+int32 FOpenSkillReplica::Num() const
+{
+	FReadScopeLock ReadLock(Lock);
+	return Entries.Num();
+}
+
+uint64 FOpenSkillReplica::GetSequence() const
+{
+	FReadScopeLock ReadLock(Lock);
+	return Sequence;
+}
+
+bool FOpenSkillReplica::IsSynchronized() const
+{
+	FReadScopeLock ReadLock(Lock);
+	return bSynchronized;
+}
+
+int32 FOpenSkillReplica::GetNumResyncs() const
+{
+	FReadScopeLock ReadLock(Lock);
+	return NumResyncs;
+}
+
+FOpenSkillReplicationPipe::FOpenSkillReplicationPipe()
+{
+	if (!FPlatformProcess::CreatePipe(ReadPipe, WritePipe))
+	{
+		ReadPipe = nullptr;
+		WritePipe = nullptr;
+	}
+}
+
+FOpenSkillReplicationPipe::~FOpenSkillReplicationPipe()
+{
+	if (IsValid())
+	{
+		FPlatformProcess::ClosePipe(ReadPipe, WritePipe);
+	}
+}
+
+bool FOpenSkillReplicationPipe::Write(TArrayView<const uint8> Frame)
+{
+	int32 Written = 0;
+	while (Written < Frame.Num())
+	{
+		int32 Chunk = 0;
+		FPlatformProcess::WritePipe(WritePipe, Frame.GetData() + Written, Frame.Num() - Written, &Chunk);
+		if (Chunk <= 0)
+		{
+			return false;
+		}
+		Written += Chunk;
+	}
+	return true;
+}
+
+int32 FOpenSkillReplicationPipe::Pump(FOpenSkillReplica& Replica)
+{
+	int32 Forwarded = 0;
+	TArray<uint8> Bytes;
+	while (FPlatformProcess::ReadPipeToArray(ReadPipe, Bytes) && Bytes.Num() > 0)
+	{
+		Replica.Receive(Bytes);
+		Forwarded += Bytes.Num();
+	}
+	return Forwarded;
+}
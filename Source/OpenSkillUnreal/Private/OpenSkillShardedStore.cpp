@@ -0,0 +1,347 @@
+﻿#include "OpenSkillShardedStore.h"
+#include "OpenSkillUnreal.h"
+#include "Containers/Queue.h"
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/ScopeLock.h"
+
+struct FOpenSkillStoreMatch
+{
+	TArray<TArray<FOpenSkillPlayerId>> Players;
+	// Filled in by the gather phase, one slot per player.
+	TArray<TTuple<TArray<FOpenSkillRating>, int>> Teams;
+	TArray<TArray<FOpenSkillRating>> Rated;
+	// The (team, member) slots owned by each involved shard.
+	TArray<TTuple<int32, TArray<FIntPoint>>> ShardSlots;
+	std::atomic<int32> PendingGathers{0};
+	std::atomic<int32> PendingApplies{0};
+	FOpenSkillShardedStore::FOnMatchApplied OnApplied;
+};
+
+typedef TSharedPtr<FOpenSkillStoreMatch, ESPMode::ThreadSafe> FOpenSkillStoreMatchPtr;
+
+struct FOpenSkillStoreCommand
+{
+	enum class EType : uint8
+	{
+		Gather,
+		Apply,
+		Set,
+		Stop
+	};
+
+	EType Type = EType::Stop;
+	FOpenSkillStoreMatchPtr Match;
+	int32 ShardSlotsIndex = INDEX_NONE;
+	FOpenSkillPlayerId Player = 0;
+	FOpenSkillRating Rating = FOpenSkillRating(0, 0);
+};
+
+class FOpenSkillStoreShard : public FRunnable
+{
+public:
+	FOpenSkillStoreShard(FOpenSkillShardedStore& InStore, const int32 InIndex)
+		: Store(InStore)
+		, WorkEvent(FPlatformProcess::GetSynchEventFromPool(false))
+	{
+		Thread = FRunnableThread::Create(this, *FString::Printf(TEXT("OpenSkillStoreShard%d"), InIndex));
+	}
+
+	virtual ~FOpenSkillStoreShard() override
+	{
+		FOpenSkillStoreCommand Stop;
+		Stop.Type = FOpenSkillStoreCommand::EType::Stop;
+		Enqueue(MoveTemp(Stop));
+		Thread->WaitForCompletion();
+		delete Thread;
+		FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+	}
+
+	void Enqueue(FOpenSkillStoreCommand&& Command)
+	{
+		Commands.Enqueue(MoveTemp(Command));
+		WorkEvent->Trigger();
+	}
+
+	virtual uint32 Run() override
+	{
+		for (;;)
+		{
+			FOpenSkillStoreCommand Command;
+			while (Commands.Dequeue(Command))
+			{
+				switch (Command.Type)
+				{
+				case FOpenSkillStoreCommand::EType::Gather:
+					Gather(Command.Match, Command.ShardSlotsIndex);
+					break;
+				case FOpenSkillStoreCommand::EType::Apply:
+					Apply(Command.Match, Command.ShardSlotsIndex);
+					break;
+				case FOpenSkillStoreCommand::EType::Set:
+					Entries.FindOrAdd(Command.Player, FEntry(Command.Rating)).Rating = Command.Rating;
+					if (Store.OnRatingsCommitted)
+					{
+						Store.OnRatingsCommitted(TArrayView<const FOpenSkillPlayerId>(&Command.Player, 1), TArrayView<const FOpenSkillRating>(&Command.Rating, 1));
+					}
+					Store.CompleteWork();
+					break;
+				case FOpenSkillStoreCommand::EType::Stop:
+					return 0;
+				}
+			}
+			WorkEvent->Wait();
+		}
+	}
+
+	const FOpenSkillRating* Find(const FOpenSkillPlayerId Player) const
+	{
+		const FEntry* Entry = Entries.Find(Player);
+		return Entry ? &Entry->Rating : nullptr;
+	}
+
+private:
+	struct FEntry
+	{
+		explicit FEntry(const FOpenSkillRating& InRating)
+			: Rating(InRating)
+		{
+		}
+
+		FOpenSkillRating Rating;
+		// Set between a match gathering this player and applying its new rating.
+		bool bInFlight = false;
+	};
+
+	struct FWaiter
+	{
+		FOpenSkillStoreMatchPtr Match;
+		FIntPoint Slot;
+	};
+
+	FOpenSkillShardedStore& Store;
+	FRunnableThread* Thread = nullptr;
+	FEvent* WorkEvent;
+	TQueue<FOpenSkillStoreCommand, EQueueMode::Mpsc> Commands;
+
+	// Only ever touched by this shard's thread.
+	TMap<FOpenSkillPlayerId, FEntry> Entries;
+	// Gathers held back behind an in-flight match, oldest first.
+	TMap<FOpenSkillPlayerId, TArray<FWaiter>> Waiting;
+
+	void Gather(const FOpenSkillStoreMatchPtr& Match, const int32 ShardSlotsIndex)
+	{
+		const FOpenSkillCompiledOptionsPin Snapshot = Store.Module.GetCompiledOptions();
+		const FOpenSkillOptions& Options = Snapshot->Options;
+		for (const FIntPoint& Slot : Match->ShardSlots[ShardSlotsIndex].Value)
+		{
+			const FOpenSkillPlayerId Player = Match->Players[Slot.X][Slot.Y];
+			FEntry& Entry = Entries.FindOrAdd(Player, FEntry(FOpenSkillRating(Options.Mu, Options.Sigma)));
+			if (Entry.bInFlight)
+			{
+				Waiting.FindOrAdd(Player).Add({Match, Slot});
+			}
+			else
+			{
+				Read(Entry, Match, Slot);
+			}
+		}
+	}
+
+	void Read(FEntry& Entry, const FOpenSkillStoreMatchPtr& Match, const FIntPoint& Slot)
+	{
+		Entry.bInFlight = true;
+		Match->Teams[Slot.X].Key[Slot.Y] = Entry.Rating;
+		if (--Match->PendingGathers == 0)
+		{
+			// Last gather in, this thread rates the match and hands the results back to the owning shards.
+			Match->Rated = Store.Module.RateByRank(MoveTemp(Match->Teams));
+			for (int i = 0; i < Match->ShardSlots.Num(); ++i)
+			{
+				FOpenSkillStoreCommand Command;
+				Command.Type = FOpenSkillStoreCommand::EType::Apply;
+				Command.Match = Match;
+				Command.ShardSlotsIndex = i;
+				Store.Shards[Match->ShardSlots[i].Key]->Enqueue(MoveTemp(Command));
+			}
+		}
+	}
+
+	void Apply(const FOpenSkillStoreMatchPtr& Match, const int32 ShardSlotsIndex)
+	{
+		TArray<FOpenSkillPlayerId> Committed;
+		TArray<FOpenSkillRating> CommittedRatings;
+		for (const FIntPoint& Slot : Match->ShardSlots[ShardSlotsIndex].Value)
+		{
+			const FOpenSkillPlayerId Player = Match->Players[Slot.X][Slot.Y];
+			FEntry& Entry = Entries.FindChecked(Player);
+			Entry.Rating = Match->Rated[Slot.X][Slot.Y];
+			Entry.bInFlight = false;
+			if (Store.OnRatingsCommitted)
+			{
+				Committed.Add(Player);
+				CommittedRatings.Add(Entry.Rating);
+			}
+
+			if (TArray<FWaiter>* Waiters = Waiting.Find(Player))
+			{
+				const FWaiter Next = (*Waiters)[0];
+				Waiters->RemoveAt(0);
+				if (Waiters->Num() == 0)
+				{
+					Waiting.Remove(Player);
+				}
+				Read(Entry, Next.Match, Next.Slot);
+			}
+		}
+
+		// Reported before this thread can apply any later match of these players.
+		if (Committed.Num() > 0)
+		{
+			Store.OnRatingsCommitted(Committed, CommittedRatings);
+		}
+
+		if (--Match->PendingApplies == 0)
+		{
+			if (Match->OnApplied)
+			{
+				Match->OnApplied(Match->Players, Match->Rated);
+			}
+			Store.CompleteWork();
+		}
+	}
+};
+
+FOpenSkillShardedStore::FOpenSkillShardedStore(const FOpenSkillUnrealModule& InModule, const int32 NumShards)
+	: Module(InModule)
+	, InFlight(0)
+	, IdleEvent(FPlatformProcess::GetSynchEventFromPool(true))
+{
+	IdleEvent->Trigger();
+	check(NumShards > 0)
+	Shards.Reserve(NumShards);
+	for (int i = 0; i < NumShards; ++i)
+	{
+		Shards.Emplace(MakeUnique<FOpenSkillStoreShard>(*this, i));
+	}
+}
+
+FOpenSkillShardedStore::~FOpenSkillShardedStore()
+{
+	Flush();
+	Shards.Empty();
+	FPlatformProcess::ReturnSynchEventToPool(IdleEvent);
+}
+
+int32 FOpenSkillShardedStore::GetShardIndex(const FOpenSkillPlayerId Player) const
+{
+	// Fibonacci hashing, so sequential IDs still spread evenly.
+	return static_cast<int32>(((Player * 0x9E3779B97F4A7C15ull) >> 32) % static_cast<uint64>(Shards.Num()));
+}
+
+void FOpenSkillShardedStore::SetRating(const FOpenSkillPlayerId Player, const FOpenSkillRating& Rating)
+{
+	FOpenSkillStoreCommand Command;
+	Command.Type = FOpenSkillStoreCommand::EType::Set;
+	Command.Player = Player;
+	Command.Rating = Rating;
+
+	AddWork();
+	FScopeLock Lock(&SubmitLock);
+	Shards[GetShardIndex(Player)]->Enqueue(MoveTemp(Command));
+}
+
+void FOpenSkillShardedStore::SubmitMatch(const TArray<TTuple<TArray<FOpenSkillPlayerId>, int>>& Teams, FOnMatchApplied OnApplied)
+{
+	const FOpenSkillStoreMatchPtr Match = MakeShared<FOpenSkillStoreMatch, ESPMode::ThreadSafe>();
+	Match->OnApplied = MoveTemp(OnApplied);
+	Match->Players.Reserve(Teams.Num());
+	Match->Teams.Reserve(Teams.Num());
+
+	TArray<TArray<FIntPoint>> SlotsPerShard;
+	SlotsPerShard.SetNum(Shards.Num());
+	int32 NumPlayers = 0;
+#if DO_CHECK
+	// A player gathered twice would wait on its own in-flight entry, and the match would never be applied.
+	TSet<FOpenSkillPlayerId> MatchPlayers;
+#endif
+	for (int Team = 0; Team < Teams.Num(); ++Team)
+	{
+		const TArray<FOpenSkillPlayerId>& Players = Teams[Team].Key;
+		Match->Players.Add(Players);
+		TArray<FOpenSkillRating> Placeholders;
+		Placeholders.Init(FOpenSkillRating(0, 0), Players.Num());
+		Match->Teams.Emplace(MoveTemp(Placeholders), Teams[Team].Value);
+
+		for (int Member = 0; Member < Players.Num(); ++Member)
+		{
+#if DO_CHECK
+			checkf(!MatchPlayers.Contains(Players[Member]), TEXT("Player %llu appears more than once in the match"), Players[Member])
+			MatchPlayers.Add(Players[Member]);
+#endif
+			SlotsPerShard[GetShardIndex(Players[Member])].Emplace(Team, Member);
+		}
+		NumPlayers += Players.Num();
+	}
+	if (NumPlayers == 0)
+	{
+		if (Match->OnApplied)
+		{
+			Match->Rated.SetNum(Teams.Num());
+			Match->OnApplied(Match->Players, Match->Rated);
+		}
+		return;
+	}
+
+	for (int Shard = 0; Shard < SlotsPerShard.Num(); ++Shard)
+	{
+		if (SlotsPerShard[Shard].Num() > 0)
+		{
+			Match->ShardSlots.Emplace(Shard, MoveTemp(SlotsPerShard[Shard]));
+		}
+	}
+	Match->PendingGathers = NumPlayers;
+	Match->PendingApplies = Match->ShardSlots.Num();
+
+	AddWork();
+	FScopeLock Lock(&SubmitLock);
+	for (int i = 0; i < Match->ShardSlots.Num(); ++i)
+	{
+		FOpenSkillStoreCommand Command;
+		Command.Type = FOpenSkillStoreCommand::EType::Gather;
+		Command.Match = Match;
+		Command.ShardSlotsIndex = i;
+		Shards[Match->ShardSlots[i].Key]->Enqueue(MoveTemp(Command));
+	}
+}
+
+void FOpenSkillShardedStore::Flush()
+{
+	IdleEvent->Wait();
+}
+
+TOptional<FOpenSkillRating> FOpenSkillShardedStore::FindRating(const FOpenSkillPlayerId Player) const
+{
+	const FOpenSkillRating* Rating = Shards[GetShardIndex(Player)]->Find(Player);
+	return Rating ? TOptional<FOpenSkillRating>(*Rating) : TOptional<FOpenSkillRating>();
+}
+
+void FOpenSkillShardedStore::AddWork()
+{
+	FScopeLock Lock(&IdleLock);
+	if (InFlight++ == 0)
+	{
+		IdleEvent->Reset();
+	}
+}
+
+void FOpenSkillShardedStore::CompleteWork()
+{
+	FScopeLock Lock(&IdleLock);
+	if (--InFlight == 0)
+	{
+		IdleEvent->Trigger();
+	}
+}
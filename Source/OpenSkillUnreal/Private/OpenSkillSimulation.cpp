@@ -0,0 +1,302 @@
+﻿#include "OpenSkillSimulation.h"
+#include "OpenSkillUnreal.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogOpenSkillSimulation, Log, All);
+
+namespace OpenSkillSimulation
+{
+	double Gaussian(FRandomStream& Random, const double Mean, const double Deviation)
+	{
+		// Box-Muller, FRandomStream only hands out uniform values.
+		const double U1 = FMath::Max<double>(Random.GetFraction(), DBL_MIN);
+		const double U2 = Random.GetFraction();
+		return Mean + Deviation * FMath::Sqrt(-2 * FMath::Loge(U1)) * FMath::Cos(2 * PI * U2);
+	}
+
+	TArray<double> GetRanks(TArrayView<const double> Values)
+	{
+		TArray<int32> Order;
+		Order.SetNumUninitialized(Values.Num());
+		for (int i = 0; i < Values.Num(); ++i)
+		{
+			Order[i] = i;
+		}
+		Order.Sort([&Values](const int32 Lhs, const int32 Rhs)
+		{
+			return Values[Lhs] < Values[Rhs];
+		});
+
+		TArray<double> Ranks;
+		Ranks.SetNumUninitialized(Values.Num());
+		for (int i = 0; i < Order.Num();)
+		{
+			int j = i;
+			while (j + 1 < Order.Num() && Values[Order[j + 1]] == Values[Order[i]])
+			{
+				++j;
+			}
+			const double AverageRank = (i + j) / 2.0;
+			for (int k = i; k <= j; ++k)
+			{
+				Ranks[Order[k]] = AverageRank;
+			}
+			i = j + 1;
+		}
+		return Ranks;
+	}
+
+	void Simulate(const TArray<FString>& Args)
+	{
+		FOpenSkillSimulationConfig Config = FOpenSkillSimulationConfig::Duel();
+		if (Args.Num() > 0 && !FOpenSkillSimulationConfig::FromName(Args[0], Config))
+		{
+			UE_LOG(LogOpenSkillSimulation, Error, TEXT("Unknown match format '%s', expected 1v1, 5v5, Squads or FFA."), *Args[0]);
+			return;
+		}
+		if (Args.Num() > 1)
+		{
+			Config.Seed = FCString::Atoi(*Args[1]);
+		}
+		if (Args.Num() > 2)
+		{
+			Config.NumMatches = FMath::Max(FCString::Atoi(*Args[2]), 1);
+		}
+
+		const FOpenSkillSimulation Simulation(Config);
+		for (int Model = 0; Model < static_cast<int>(EOpenSkillModel::Count); ++Model)
+		{
+			FOpenSkillOptions Options;
+			Options.Model = FOpenSkillModeling::GetModel(static_cast<EOpenSkillModel>(Model));
+			FOpenSkillUnrealModule Module;
+			Module.SetOptions(Options);
+
+			const FOpenSkillSimulationReport Report = Simulation.Run(Module);
+			UE_LOG(LogOpenSkillSimulation, Display, TEXT("%-26s %9.0f matches/s  log loss %.4f  rank correlation %.4f"),
+			       FOpenSkillModeling::GetModelName(static_cast<EOpenSkillModel>(Model)), Report.MatchesPerSecond, Report.LogLoss, Report.RankCorrelation);
+		}
+	}
+
+	FAutoConsoleCommand SimulateCommand(
+		TEXT("OpenSkill.Simulate"),
+		TEXT("Rate a synthetic population with every model. Usage: OpenSkill.Simulate [1v1|5v5|Squads|FFA] [Seed] [Matches]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&Simulate));
+}
+
+FOpenSkillSimulationConfig FOpenSkillSimulationConfig::Duel()
+{
+	return FOpenSkillSimulationConfig();
+}
+
+FOpenSkillSimulationConfig FOpenSkillSimulationConfig::FiveVersusFive()
+{
+	FOpenSkillSimulationConfig Config;
+	Config.TeamSize = 5;
+	return Config;
+}
+
+FOpenSkillSimulationConfig FOpenSkillSimulationConfig::Squads()
+{
+	FOpenSkillSimulationConfig Config;
+	Config.NumTeams = 25;
+	Config.TeamSize = 4;
+	Config.NumMatches = 5000;
+	return Config;
+}
+
+FOpenSkillSimulationConfig FOpenSkillSimulationConfig::FreeForAll()
+{
+	FOpenSkillSimulationConfig Config;
+	Config.NumTeams = 100;
+	Config.TeamSize = 1;
+	Config.NumMatches = 5000;
+	return Config;
+}
+
+bool FOpenSkillSimulationConfig::FromName(const FString& Name, FOpenSkillSimulationConfig& OutConfig)
+{
+	if (Name.Equals(TEXT("1v1"), ESearchCase::IgnoreCase))
+	{
+		OutConfig = Duel();
+	}
+	else if (Name.Equals(TEXT("5v5"), ESearchCase::IgnoreCase))
+	{
+		OutConfig = FiveVersusFive();
+	}
+	else if (Name.Equals(TEXT("Squads"), ESearchCase::IgnoreCase))
+	{
+		OutConfig = Squads();
+	}
+	else if (Name.Equals(TEXT("FFA"), ESearchCase::IgnoreCase))
+	{
+		OutConfig = FreeForAll();
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+FOpenSkillSimulation::FOpenSkillSimulation(const FOpenSkillSimulationConfig& InConfig)
+	: Config(InConfig)
+{
+	const int PlayersPerMatch = Config.NumTeams * Config.TeamSize;
+	checkf(Config.PopulationSize >= PlayersPerMatch, TEXT("Population (%d) is smaller than a match (%d)"), Config.PopulationSize, PlayersPerMatch)
+
+	FRandomStream Random(Config.Seed);
+
+	TrueSkills.SetNumUninitialized(Config.PopulationSize);
+	for (double& Skill : TrueSkills)
+	{
+		Skill = OpenSkillSimulation::Gaussian(Random, Config.SkillMean, Config.SkillDeviation);
+	}
+
+	// LastMatch[Player] == Match marks a player already picked for the match being generated.
+	TArray<int32> LastMatch;
+	LastMatch.Init(INDEX_NONE, Config.PopulationSize);
+	TArray<int32> Players;
+	TArray<TTuple<double, int32>> TeamPerformances;
+	MatchPlayers.Reserve(Config.NumMatches * PlayersPerMatch);
+
+	for (int Match = 0; Match < Config.NumMatches; ++Match)
+	{
+		Players.Reset();
+		while (Players.Num() < PlayersPerMatch)
+		{
+			const int32 Player = Random.RandHelper(Config.PopulationSize);
+			if (LastMatch[Player] != Match)
+			{
+				LastMatch[Player] = Match;
+				Players.Add(Player);
+			}
+		}
+
+		TeamPerformances.Reset();
+		for (int Team = 0; Team < Config.NumTeams; ++Team)
+		{
+			double Performance = 0;
+			for (int Member = 0; Member < Config.TeamSize; ++Member)
+			{
+				Performance += OpenSkillSimulation::Gaussian(Random, TrueSkills[Players[Team * Config.TeamSize + Member]], Config.PerformanceDeviation);
+			}
+			TeamPerformances.Emplace(Performance, Team);
+		}
+		TeamPerformances.Sort([](const TTuple<double, int32>& Lhs, const TTuple<double, int32>& Rhs)
+		{
+			return Lhs.Key > Rhs.Key;
+		});
+
+		for (const TTuple<double, int32>& Team : TeamPerformances)
+		{
+			MatchPlayers.Append(Players.GetData() + Team.Value * Config.TeamSize, Config.TeamSize);
+		}
+	}
+}
+
+TArrayView<const int32> FOpenSkillSimulation::GetMatchPlayers(const int32 Match) const
+{
+	const int PlayersPerMatch = Config.NumTeams * Config.TeamSize;
+	return TArrayView<const int32>(MatchPlayers.GetData() + Match * PlayersPerMatch, PlayersPerMatch);
+}
+
+FOpenSkillSimulationReport FOpenSkillSimulation::Run(const FOpenSkillUnrealModule& Module) const
+{
+	TArray<FOpenSkillRating> Ratings;
+	Ratings.Init(Module.GetDefaultRating(), Config.PopulationSize);
+
+	TArray<TArray<FOpenSkillRating>> Teams;
+	Teams.SetNum(Config.NumTeams);
+
+	FOpenSkillSimulationReport Report;
+	double LogLossSum = 0;
+
+	for (int Match = 0; Match < Config.NumMatches; ++Match)
+	{
+		const TArrayView<const int32> Players = GetMatchPlayers(Match);
+		for (int Team = 0; Team < Config.NumTeams; ++Team)
+		{
+			Teams[Team].Reset();
+			for (int Member = 0; Member < Config.TeamSize; ++Member)
+			{
+				Teams[Team].Add(Ratings[Players[Team * Config.TeamSize + Member]]);
+			}
+		}
+
+		// Teams are already in finishing order, so the winner is always the first team.
+		const TArray<double> WinProbabilities = Module.PredictWin(Teams);
+		LogLossSum -= FMath::Loge(FMath::Clamp(WinProbabilities[0], 1e-12, 1.0));
+
+		const double StartTime = FPlatformTime::Seconds();
+		const TArray<TArray<FOpenSkillRating>> Rated = Module.RateByOrdinal(Teams);
+		Report.Seconds += FPlatformTime::Seconds() - StartTime;
+
+		for (int Team = 0; Team < Config.NumTeams; ++Team)
+		{
+			for (int Member = 0; Member < Config.TeamSize; ++Member)
+			{
+				Ratings[Players[Team * Config.TeamSize + Member]] = Rated[Team][Member];
+			}
+		}
+	}
+
+	TArray<double> Ordinals;
+	Ordinals.Reserve(Ratings.Num());
+	for (const FOpenSkillRating& Rating : Ratings)
+	{
+		Ordinals.Add(Module.GetOrdinal(Rating));
+	}
+
+	Report.Matches = Config.NumMatches;
+	Report.MatchesPerSecond = Report.Seconds > 0 ? Report.Matches / Report.Seconds : 0;
+	Report.LogLoss = Config.NumMatches > 0 ? LogLossSum / Config.NumMatches : 0;
+	Report.RankCorrelation = RankCorrelation(Ordinals, TrueSkills);
+	return Report;
+}
+
+FOpenSkillMatchHistory FOpenSkillSimulation::GetHistory() const
+{
+	FOpenSkillMatchHistory History;
+	TArray<TTuple<TArray<int32>, int>> Teams;
+	Teams.SetNum(Config.NumTeams);
+	for (int Match = 0; Match < Config.NumMatches; ++Match)
+	{
+		const TArrayView<const int32> Players = GetMatchPlayers(Match);
+		for (int Team = 0; Team < Config.NumTeams; ++Team)
+		{
+			Teams[Team].Key.Reset();
+			Teams[Team].Key.Append(Players.GetData() + Team * Config.TeamSize, Config.TeamSize);
+			Teams[Team].Value = Team + 1;
+		}
+		History.AddMatch(Teams);
+	}
+	return History;
+}
+
+double FOpenSkillSimulation::RankCorrelation(TArrayView<const double> A, TArrayView<const double> B)
+{
+	check(A.Num() == B.Num())
+	const int N = A.Num();
+	if (N < 2)
+	{
+		return 0;
+	}
+
+	const TArray<double> RanksA = OpenSkillSimulation::GetRanks(A);
+	const TArray<double> RanksB = OpenSkillSimulation::GetRanks(B);
+	const double MeanRank = (N - 1) / 2.0;
+
+	double Covariance = 0;
+	double VarianceA = 0;
+	double VarianceB = 0;
+	for (int i = 0; i < N; ++i)
+	{
+		const double DeltaA = RanksA[i] - MeanRank;
+		const double DeltaB = RanksB[i] - MeanRank;
+		Covariance += DeltaA * DeltaB;
+		VarianceA += FMath::Square(DeltaA);
+		VarianceB += FMath::Square(DeltaB);
+	}
+	return VarianceA > 0 && VarianceB > 0 ? Covariance / FMath::Sqrt(VarianceA * VarianceB) : 0;
+}
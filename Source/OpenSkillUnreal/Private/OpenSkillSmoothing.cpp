@@ -0,0 +1,273 @@
+﻿#include "OpenSkillSmoothing.h"
+#include "OpenSkillMatchHistory.h"
+#include "OpenSkillSimulation.h"
+#include "OpenSkillUnreal.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogOpenSkillSmoothing, Log, All);
+
+namespace OpenSkillSmoothing
+{
+	// Matches per ParallelFor task within a level.
+	constexpr int32 MatchesPerTask = 64;
+
+	void Smooth(const TArray<FString>& Args)
+	{
+		FOpenSkillSimulationConfig Config = FOpenSkillSimulationConfig::Duel();
+		if (Args.Num() > 0 && !FOpenSkillSimulationConfig::FromName(Args[0], Config))
+		{
+			UE_LOG(LogOpenSkillSmoothing, Error, TEXT("Unknown match format '%s', expected 1v1, 5v5, Squads or FFA."), *Args[0]);
+			return;
+		}
+		if (Args.Num() > 1)
+		{
+			Config.Seed = FCString::Atoi(*Args[1]);
+		}
+		if (Args.Num() > 2)
+		{
+			Config.NumMatches = FMath::Max(FCString::Atoi(*Args[2]), 1);
+		}
+
+		const FOpenSkillSimulation Simulation(Config);
+		const FOpenSkillMatchHistory History = Simulation.GetHistory();
+		FOpenSkillUnrealModule Module;
+		FOpenSkillSmoothing Smoothing(History, Module.GetCompiledOptions()->Options);
+
+		const double OnlineCorrelation = Simulation.Run(Module).RankCorrelation;
+
+		const double StartTime = FPlatformTime::Seconds();
+		const int32 Iterations = Smoothing.Run();
+		TArray<double> Ordinals;
+		Ordinals.SetNumZeroed(Config.PopulationSize);
+		for (int Player = 0; Player < History.GetNumPlayers(); ++Player)
+		{
+			Ordinals[Player] = Module.GetOrdinal(Smoothing.GetRating(Player));
+		}
+		UE_LOG(LogOpenSkillSmoothing, Display, TEXT("%d matches in %d levels, %d sweeps in %.2fs, rank correlation %.4f online, %.4f smoothed"),
+		       History.Num(), Smoothing.GetNumLevels(), Iterations, FPlatformTime::Seconds() - StartTime,
+		       OnlineCorrelation, FOpenSkillSimulation::RankCorrelation(Ordinals, Simulation.GetTrueSkills()));
+	}
+
+	FAutoConsoleCommand SmoothCommand(
+		TEXT("OpenSkill.Smooth"),
+		TEXT("Smooth a synthetic population's history and compare it with online rating. Usage: OpenSkill.Smooth [1v1|5v5|Squads|FFA] [Seed] [Matches]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&Smooth));
+}
+
+FOpenSkillSmoothing::FOpenSkillSmoothing(const FOpenSkillMatchHistory& InHistory, const FOpenSkillOptions& InOptions)
+	: History(InHistory)
+	, Snapshot(InOptions)
+{
+	const int32 NumSlots = History.GetNumSlots();
+	const int32 NumPlayers = History.GetNumPlayers();
+	PrevSlot.SetNumUninitialized(NumSlots);
+	NextSlot.SetNumUninitialized(NumSlots);
+	Forward.SetNum(NumSlots);
+	Backward.SetNum(NumSlots);
+	Likelihood.SetNum(NumSlots);
+
+	// Link every slot to the same player's previous and next one, and level the matches on the way.
+	TArray<int32> LastSlot;
+	TArray<int32> LastLevel;
+	LastSlot.Init(INDEX_NONE, NumPlayers);
+	LastLevel.Init(INDEX_NONE, NumPlayers);
+	TArray<int32> MatchLevels;
+	MatchLevels.SetNumUninitialized(History.Num());
+	PlayerSlotOffsets.SetNumZeroed(NumPlayers + 1);
+	int32 NumLevels = 0;
+	for (int Match = 0; Match < History.Num(); ++Match)
+	{
+		const TArrayView<const int32> Players = History.GetMatchPlayers(Match);
+		const int32 FirstSlot = History.GetFirstSlot(Match);
+		int32 Level = 0;
+		for (const int32 Player : Players)
+		{
+			Level = FMath::Max(Level, LastLevel[Player] + 1);
+		}
+		for (int i = 0; i < Players.Num(); ++i)
+		{
+			const int32 Player = Players[i];
+			const int32 Slot = FirstSlot + i;
+			PrevSlot[Slot] = LastSlot[Player];
+			NextSlot[Slot] = INDEX_NONE;
+			if (LastSlot[Player] != INDEX_NONE)
+			{
+				NextSlot[LastSlot[Player]] = Slot;
+			}
+			LastSlot[Player] = Slot;
+			LastLevel[Player] = Level;
+			++PlayerSlotOffsets[Player + 1];
+		}
+		MatchLevels[Match] = Level;
+		NumLevels = FMath::Max(NumLevels, Level + 1);
+	}
+
+	// Counting sorts into the per-player slot lists and per-level match lists, both keep time order.
+	for (int Player = 0; Player < NumPlayers; ++Player)
+	{
+		PlayerSlotOffsets[Player + 1] += PlayerSlotOffsets[Player];
+	}
+	TArray<int32> PlayerCursor(PlayerSlotOffsets.GetData(), NumPlayers);
+	PlayerSlots.SetNumUninitialized(NumSlots);
+	for (int Match = 0; Match < History.Num(); ++Match)
+	{
+		const TArrayView<const int32> Players = History.GetMatchPlayers(Match);
+		const int32 FirstSlot = History.GetFirstSlot(Match);
+		for (int i = 0; i < Players.Num(); ++i)
+		{
+			PlayerSlots[PlayerCursor[Players[i]]++] = FirstSlot + i;
+		}
+	}
+
+	LevelOffsets.SetNumZeroed(NumLevels + 1);
+	for (const int32 Level : MatchLevels)
+	{
+		++LevelOffsets[Level + 1];
+	}
+	for (int Level = 0; Level < NumLevels; ++Level)
+	{
+		LevelOffsets[Level + 1] += LevelOffsets[Level];
+	}
+	TArray<int32> LevelCursor(LevelOffsets.GetData(), NumLevels);
+	LevelMatches.SetNumUninitialized(History.Num());
+	for (int Match = 0; Match < History.Num(); ++Match)
+	{
+		LevelMatches[LevelCursor[MatchLevels[Match]]++] = Match;
+	}
+}
+
+int32 FOpenSkillSmoothing::Run(const int32 MaxIterations, const double Tolerance)
+{
+	for (int Iteration = 0; Iteration < MaxIterations; ++Iteration)
+	{
+		double MaxChange = 0;
+		for (int Level = 0; Level < GetNumLevels(); ++Level)
+		{
+			MaxChange = FMath::Max(MaxChange, SweepLevel(Level, true));
+		}
+		for (int Level = GetNumLevels() - 1; Level >= 0; --Level)
+		{
+			MaxChange = FMath::Max(MaxChange, SweepLevel(Level, false));
+		}
+		if (MaxChange <= Tolerance)
+		{
+			return Iteration + 1;
+		}
+	}
+	return MaxIterations;
+}
+
+FOpenSkillRating FOpenSkillSmoothing::GetSlotRating(const int32 Slot) const
+{
+	return (Forward[Slot] * Likelihood[Slot] * Backward[Slot]).ToRating();
+}
+
+FOpenSkillRating FOpenSkillSmoothing::GetRating(const int32 Player) const
+{
+	if (Player >= History.GetNumPlayers() || PlayerSlotOffsets[Player] == PlayerSlotOffsets[Player + 1])
+	{
+		return FOpenSkillRating(Snapshot.Options.Mu, Snapshot.Options.Sigma);
+	}
+	return GetSlotRating(PlayerSlots[PlayerSlotOffsets[Player + 1] - 1]);
+}
+
+FOpenSkillGaussianMessage FOpenSkillSmoothing::GetPrior() const
+{
+	return FOpenSkillGaussianMessage::FromRating(FOpenSkillRating(Snapshot.Options.Mu, Snapshot.Options.Sigma));
+}
+
+FOpenSkillGaussianMessage FOpenSkillSmoothing::Drift(const FOpenSkillGaussianMessage& Message) const
+{
+	if (Snapshot.Options.Tau <= 0 || Message.Pi <= 0)
+	{
+		return Message;
+	}
+	const double Variance = 1 / Message.Pi + Snapshot.TauSquared;
+	return {1 / Variance, (Message.Tau / Message.Pi) / Variance};
+}
+
+double FOpenSkillSmoothing::SweepLevel(const int32 Level, const bool bForward)
+{
+	const int32 First = LevelOffsets[Level];
+	const int32 NumMatches = LevelOffsets[Level + 1] - First;
+	const int32 NumTasks = FMath::DivideAndRoundUp(NumMatches, OpenSkillSmoothing::MatchesPerTask);
+	TArray<double> TaskChanges;
+	TaskChanges.SetNumZeroed(NumTasks);
+
+	ParallelFor(NumTasks, [this, First, NumMatches, bForward, &TaskChanges](const int32 Task)
+	{
+		TArray<TArray<FOpenSkillRating>> Teams;
+		TArray<int> Ranks;
+		TArray<FOpenSkillGaussianMessage> Cavities;
+		const int32 End = FMath::Min((Task + 1) * OpenSkillSmoothing::MatchesPerTask, NumMatches);
+		for (int i = Task * OpenSkillSmoothing::MatchesPerTask; i < End; ++i)
+		{
+			TaskChanges[Task] = FMath::Max(TaskChanges[Task], UpdateMatch(LevelMatches[First + i], bForward, Teams, Ranks, Cavities));
+		}
+	});
+
+	double MaxChange = 0;
+	for (const double Change : TaskChanges)
+	{
+		MaxChange = FMath::Max(MaxChange, Change);
+	}
+	return MaxChange;
+}
+
+double FOpenSkillSmoothing::UpdateMatch(const int32 Match, const bool bForward, TArray<TArray<FOpenSkillRating>>& Teams, TArray<int>& Ranks, TArray<FOpenSkillGaussianMessage>& Cavities)
+{
+	const int32 NumTeams = History.GetNumTeams(Match);
+	const int32 FirstSlot = History.GetFirstSlot(Match);
+	Teams.SetNum(NumTeams);
+	Ranks.Reset();
+	Cavities.Reset();
+
+	// Refresh the messages flowing into this match from the direction of the sweep, the other side keeps last sweep's.
+	int32 Slot = FirstSlot;
+	for (int Team = 0; Team < NumTeams; ++Team)
+	{
+		Teams[Team].Reset();
+		Ranks.Add(History.GetTeamRank(Match, Team));
+		for (int Member = 0; Member < History.GetTeamPlayers(Match, Team).Num(); ++Member, ++Slot)
+		{
+			if (bForward)
+			{
+				const int32 Prev = PrevSlot[Slot];
+				Forward[Slot] = Drift(Prev == INDEX_NONE ? GetPrior() : Forward[Prev] * Likelihood[Prev]);
+			}
+			else
+			{
+				const int32 Next = NextSlot[Slot];
+				Backward[Slot] = Next == INDEX_NONE ? FOpenSkillGaussianMessage() : Drift(Likelihood[Next] * Backward[Next]);
+			}
+			const FOpenSkillGaussianMessage& Cavity = Cavities.Add_GetRef(Forward[Slot] * Backward[Slot]);
+			Teams[Team].Add(Cavity.ToRating());
+		}
+	}
+
+	if (NumTeams < 2)
+	{
+		return 0;
+	}
+
+	// The model turns the cavity into a posterior, what it added is this match's likelihood.
+	const TArray<TArray<FOpenSkillRating>> NewRatings = Snapshot.Options.Model(Teams, Ranks, Snapshot);
+	double MaxChange = 0;
+	Slot = FirstSlot;
+	for (int Team = 0; Team < NumTeams; ++Team)
+	{
+		for (const FOpenSkillRating& Rating : NewRatings[Team])
+		{
+			const FOpenSkillGaussianMessage& Cavity = Cavities[Slot - FirstSlot];
+			const double OldMu = (Cavity * Likelihood[Slot]).ToRating().Mu;
+			FOpenSkillGaussianMessage NewLikelihood = FOpenSkillGaussianMessage::FromRating(Rating) / Cavity;
+			// The models never widen sigma, clamp rounding so the message stays proper.
+			NewLikelihood.Pi = FMath::Max(NewLikelihood.Pi, 0.0);
+			Likelihood[Slot] = NewLikelihood;
+			MaxChange = FMath::Max(MaxChange, FMath::Abs(Rating.Mu - OldMu));
+			++Slot;
+		}
+	}
+	return MaxChange;
+}
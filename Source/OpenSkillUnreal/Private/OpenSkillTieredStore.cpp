@@ -0,0 +1,658 @@
+﻿#include "OpenSkillTieredStore.h"
+#include "OpenSkillSimulation.h"
+#include "OpenSkillUnreal.h"
+#include "Async/MappedFileHandle.h"
+#include "Containers/Queue.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/Event.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+#include "Misc/ScopeRWLock.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogOpenSkillTieredStore, Log, All);
+
+namespace OpenSkillTieredStore
+{
+	// One row of the player table.
+	struct FRow
+	{
+		double Mu;
+		double Sigma;
+	};
+
+	static_assert(sizeof(FRow) == 16, "The player table is 16 bytes per player");
+
+	// Rows appended at once when a write-back grows the file.
+	constexpr int64 RowsPerExtend = 64 * 1024;
+}
+
+struct FOpenSkillTieredStoreCommand
+{
+	enum class EType : uint8
+	{
+		Prefetch,
+		Fetch,
+		WriteBack,
+		Flush,
+		Stop
+	};
+
+	EType Type = EType::Stop;
+	TArray<FOpenSkillPlayerId> Players;
+	FOpenSkillTieredStore::FOnFetched OnFetched;
+	FEvent* DoneEvent = nullptr;
+};
+
+class FOpenSkillTieredStoreWorker : public FRunnable
+{
+public:
+	explicit FOpenSkillTieredStoreWorker(FOpenSkillTieredStore& InStore)
+		: Store(InStore)
+		, WorkEvent(FPlatformProcess::GetSynchEventFromPool(false))
+	{
+		Thread = FRunnableThread::Create(this, TEXT("OpenSkillTieredStore"));
+	}
+
+	virtual ~FOpenSkillTieredStoreWorker() override
+	{
+		FOpenSkillTieredStoreCommand Stop;
+		Stop.Type = FOpenSkillTieredStoreCommand::EType::Stop;
+		Enqueue(MoveTemp(Stop));
+		Thread->WaitForCompletion();
+		delete Thread;
+		FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+	}
+
+	void Enqueue(FOpenSkillTieredStoreCommand&& Command)
+	{
+		Commands.Enqueue(MoveTemp(Command));
+		WorkEvent->Trigger();
+	}
+
+	virtual uint32 Run() override
+	{
+		TArray<FOpenSkillRating> Ratings;
+		for (;;)
+		{
+			FOpenSkillTieredStoreCommand Command;
+			while (Commands.Dequeue(Command))
+			{
+				switch (Command.Type)
+				{
+				case FOpenSkillTieredStoreCommand::EType::Prefetch:
+					Ratings.SetNumUninitialized(Command.Players.Num());
+					Store.Resolve(Command.Players, Ratings, true);
+					break;
+				case FOpenSkillTieredStoreCommand::EType::Fetch:
+					Ratings.SetNumUninitialized(Command.Players.Num());
+					Store.Resolve(Command.Players, Ratings, false);
+					Command.OnFetched(MoveTemp(Ratings));
+					break;
+				case FOpenSkillTieredStoreCommand::EType::WriteBack:
+					Store.WriteBack(false);
+					break;
+				case FOpenSkillTieredStoreCommand::EType::Flush:
+					Store.WriteBack(true);
+					Command.DoneEvent->Trigger();
+					break;
+				case FOpenSkillTieredStoreCommand::EType::Stop:
+					return 0;
+				}
+			}
+			WorkEvent->Wait();
+		}
+	}
+
+private:
+	FOpenSkillTieredStore& Store;
+	FRunnableThread* Thread = nullptr;
+	FEvent* WorkEvent;
+	TQueue<FOpenSkillTieredStoreCommand, EQueueMode::Mpsc> Commands;
+};
+
+namespace OpenSkillTieredStore
+{
+	void Simulate(const TArray<FString>& Args)
+	{
+		FOpenSkillSimulationConfig Config = FOpenSkillSimulationConfig::FiveVersusFive();
+		if (Args.Num() > 0 && !FOpenSkillSimulationConfig::FromName(Args[0], Config))
+		{
+			UE_LOG(LogOpenSkillTieredStore, Error, TEXT("Unknown match format '%s', expected 1v1, 5v5, Squads or FFA."), *Args[0]);
+			return;
+		}
+		// The simulated population is the active few percent of a much larger registered one.
+		const int64 NumRegistered = Args.Num() > 1 ? FMath::Max<int64>(FCString::Atoi64(*Args[1]), Config.PopulationSize) : 50 * static_cast<int64>(Config.PopulationSize);
+		FOpenSkillTieredStoreConfig StoreConfig;
+		StoreConfig.HotCapacity = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : Config.PopulationSize;
+		// Players are prefetched when they queue up, this many matches before they play.
+		constexpr int32 QueueDepth = 64;
+
+		const FOpenSkillSimulation Simulation(Config);
+		const int64 RowsPerPlayer = NumRegistered / Config.PopulationSize;
+		FOpenSkillUnrealModule Module;
+		const FString Path = FPaths::CreateTempFilename(*FPaths::ProjectSavedDir(), TEXT("OpenSkillPlayers"), TEXT(".bin"));
+		{
+			FOpenSkillTieredStore Store(Module, Path, StoreConfig);
+			if (!Store.IsOpen())
+			{
+				return;
+			}
+
+			const int32 PlayersPerMatch = Config.NumTeams * Config.TeamSize;
+			TArray<FOpenSkillPlayerId> Players;
+			TArray<FOpenSkillRating> Ratings;
+			TArray<TTuple<TArray<FOpenSkillRating>, int>> Teams;
+			Teams.SetNum(Config.NumTeams);
+			const auto GetPlayers = [&](const int32 Match)
+			{
+				Players.Reset();
+				for (const int32 Player : Simulation.GetMatchPlayers(Match))
+				{
+					Players.Add(Player * RowsPerPlayer);
+				}
+			};
+
+			const double StartTime = FPlatformTime::Seconds();
+			for (int32 Match = 0; Match < FMath::Min(QueueDepth, Config.NumMatches); ++Match)
+			{
+				GetPlayers(Match);
+				Store.Prefetch(Players);
+			}
+			for (int32 Match = 0; Match < Config.NumMatches; ++Match)
+			{
+				if (Match + QueueDepth < Config.NumMatches)
+				{
+					GetPlayers(Match + QueueDepth);
+					Store.Prefetch(Players);
+				}
+
+				GetPlayers(Match);
+				Ratings.SetNumUninitialized(PlayersPerMatch);
+				Store.GetRatings(Players, Ratings);
+				for (int32 Team = 0; Team < Config.NumTeams; ++Team)
+				{
+					Teams[Team].Key = TArray<FOpenSkillRating>(&Ratings[Team * Config.TeamSize], Config.TeamSize);
+					Teams[Team].Value = Team;
+				}
+				const TArray<TArray<FOpenSkillRating>> Rated = Module.RateByRank(Teams);
+				for (int32 Team = 0; Team < Config.NumTeams; ++Team)
+				{
+					FMemory::Memcpy(&Ratings[Team * Config.TeamSize], Rated[Team].GetData(), Config.TeamSize * sizeof(FOpenSkillRating));
+				}
+				Store.SetRatings(Players, Ratings);
+			}
+			Store.Flush();
+			const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+			const FOpenSkillTieredStoreStats Stats = Store.GetStats();
+			const uint64 Reads = Stats.Hits + Stats.Misses;
+			UE_LOG(LogOpenSkillTieredStore, Display, TEXT("%d matches in %.3fs, %.0f matches/s, %.1f%% of reads hit memory, %llu prefetched, %llu evicted, %llu written back in %llu batches"),
+			       Config.NumMatches, Seconds, Seconds > 0 ? Config.NumMatches / Seconds : 0.0, Reads > 0 ? 100.0 * Stats.Hits / Reads : 0.0,
+			       Stats.Prefetches, Stats.Evictions, Stats.WriteBacks, Stats.WriteBatches);
+			UE_LOG(LogOpenSkillTieredStore, Display, TEXT("%lld registered players, %d active, %llu bytes in memory against %llu for the whole table"),
+			       NumRegistered, Config.PopulationSize, static_cast<uint64>(Store.GetAllocatedSize()), static_cast<uint64>(NumRegistered * sizeof(FOpenSkillRating)));
+		}
+		FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*Path);
+	}
+
+	FAutoConsoleCommand SimulateCommand(
+		TEXT("OpenSkill.TieredStore"),
+		TEXT("Rate a synthetic active population through a tiered store over a temporary player table. Usage: OpenSkill.TieredStore [1v1|5v5|Squads|FFA] [RegisteredPlayers] [HotCapacity]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&Simulate));
+}
+
+FOpenSkillTieredStore::FOpenSkillTieredStore(const FOpenSkillUnrealModule& Module, const FString& InPath, const FOpenSkillTieredStoreConfig& InConfig)
+	: Path(InPath)
+	, Config(InConfig)
+	, DefaultRating(Module.GetDefaultRating())
+	, NumRows(0)
+{
+	check(Config.HotCapacity > 0 && Config.WriteBackBatchSize > 0)
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	int64 FileSize = PlatformFile.FileSize(*Path);
+	if (FileSize < 0)
+	{
+		delete PlatformFile.OpenWrite(*Path);
+		FileSize = PlatformFile.FileSize(*Path);
+	}
+	if (FileSize < 0)
+	{
+		UE_LOG(LogOpenSkillTieredStore, Error, TEXT("Could not create the player table '%s'."), *Path);
+	}
+	else
+	{
+		bOpen = true;
+		NumRows = FileSize / static_cast<int64>(sizeof(OpenSkillTieredStore::FRow));
+		OpenMapping();
+	}
+	Worker = MakeUnique<FOpenSkillTieredStoreWorker>(*this);
+}
+
+FOpenSkillTieredStore::~FOpenSkillTieredStore()
+{
+	Flush();
+	Worker.Reset();
+	MappedRegion.Reset();
+	MappedFile.Reset();
+}
+
+void FOpenSkillTieredStore::GetRatings(TArrayView<const FOpenSkillPlayerId> Players, TArrayView<FOpenSkillRating> OutRatings)
+{
+	check(Players.Num() == OutRatings.Num())
+	Resolve(Players, OutRatings, false);
+}
+
+FOpenSkillRating FOpenSkillTieredStore::GetRating(const FOpenSkillPlayerId Player)
+{
+	FOpenSkillRating Rating;
+	GetRatings(TArrayView<const FOpenSkillPlayerId>(&Player, 1), TArrayView<FOpenSkillRating>(&Rating, 1));
+	return Rating;
+}
+
+void FOpenSkillTieredStore::SetRatings(TArrayView<const FOpenSkillPlayerId> Players, TArrayView<const FOpenSkillRating> Ratings)
+{
+	check(Players.Num() == Ratings.Num())
+	FScopeLock Lock(&HotLock);
+	for (int32 i = 0; i < Players.Num(); ++i)
+	{
+		// Anything queued for write-back is older than this rating, it is overwritten along with the slot.
+		const int32 Slot = FindOrAddSlot(Players[i], &Ratings[i]);
+		Mus[Slot] = Ratings[i].Mu;
+		Sigmas[Slot] = Ratings[i].Sigma;
+		SlotFlags[Slot] |= SlotReferenced | SlotDirty;
+	}
+}
+
+void FOpenSkillTieredStore::SetRating(const FOpenSkillPlayerId Player, const FOpenSkillRating& Rating)
+{
+	SetRatings(TArrayView<const FOpenSkillPlayerId>(&Player, 1), TArrayView<const FOpenSkillRating>(&Rating, 1));
+}
+
+void FOpenSkillTieredStore::FetchRatings(TArray<FOpenSkillPlayerId> Players, FOnFetched OnFetched)
+{
+	TArray<FOpenSkillRating> Ratings;
+	Ratings.SetNumUninitialized(Players.Num());
+	{
+		FScopeLock Lock(&HotLock);
+		int32 i = 0;
+		for (; i < Players.Num(); ++i)
+		{
+			const int32* Slot = Slots.Find(Players[i]);
+			if (!Slot)
+			{
+				break;
+			}
+			Ratings[i] = FOpenSkillRating(Mus[*Slot], Sigmas[*Slot]);
+		}
+		if (i == Players.Num())
+		{
+			for (const FOpenSkillPlayerId Player : Players)
+			{
+				SlotFlags[Slots[Player]] |= SlotReferenced;
+			}
+			Stats.Hits += Players.Num();
+		}
+		else
+		{
+			Ratings.Reset();
+		}
+	}
+
+	if (Ratings.Num() == Players.Num())
+	{
+		OnFetched(MoveTemp(Ratings));
+		return;
+	}
+	FOpenSkillTieredStoreCommand Command;
+	Command.Type = FOpenSkillTieredStoreCommand::EType::Fetch;
+	Command.Players = MoveTemp(Players);
+	Command.OnFetched = MoveTemp(OnFetched);
+	Worker->Enqueue(MoveTemp(Command));
+}
+
+void FOpenSkillTieredStore::Prefetch(TArrayView<const FOpenSkillPlayerId> Players)
+{
+	if (Players.Num() == 0)
+	{
+		return;
+	}
+	FOpenSkillTieredStoreCommand Command;
+	Command.Type = FOpenSkillTieredStoreCommand::EType::Prefetch;
+	Command.Players = TArray<FOpenSkillPlayerId>(Players.GetData(), Players.Num());
+	Worker->Enqueue(MoveTemp(Command));
+}
+
+void FOpenSkillTieredStore::Flush()
+{
+	FEvent* DoneEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	FOpenSkillTieredStoreCommand Command;
+	Command.Type = FOpenSkillTieredStoreCommand::EType::Flush;
+	Command.DoneEvent = DoneEvent;
+	Worker->Enqueue(MoveTemp(Command));
+	DoneEvent->Wait();
+	FPlatformProcess::ReturnSynchEventToPool(DoneEvent);
+}
+
+FOpenSkillTieredStoreStats FOpenSkillTieredStore::GetStats() const
+{
+	FScopeLock Lock(&HotLock);
+	return Stats;
+}
+
+SIZE_T FOpenSkillTieredStore::GetAllocatedSize() const
+{
+	FScopeLock Lock(&HotLock);
+	return Mus.GetAllocatedSize() + Sigmas.GetAllocatedSize() + SlotPlayers.GetAllocatedSize() + SlotFlags.GetAllocatedSize()
+		+ Slots.GetAllocatedSize() + PendingWrites.GetAllocatedSize() + WritingBatch.GetAllocatedSize();
+}
+
+void FOpenSkillTieredStore::Resolve(TArrayView<const FOpenSkillPlayerId> Players, TArrayView<FOpenSkillRating> OutRatings, const bool bPrefetch)
+{
+	TArray<int32> Misses;
+	uint64 Generation;
+	{
+		FScopeLock Lock(&HotLock);
+		Generation = WriteGeneration;
+		for (int32 i = 0; i < Players.Num(); ++i)
+		{
+			const int32* Found = Slots.Find(Players[i]);
+			if (!Found && !PendingWrites.Contains(Players[i]) && !WritingBatch.Contains(Players[i]))
+			{
+				Misses.Add(i);
+				continue;
+			}
+			const int32 Slot = Found ? *Found : FindOrAddSlot(Players[i], nullptr);
+			OutRatings[i] = FOpenSkillRating(Mus[Slot], Sigmas[Slot]);
+			SlotFlags[Slot] |= SlotReferenced;
+			Stats.Hits += bPrefetch ? 0 : 1;
+		}
+	}
+	if (Misses.Num() == 0)
+	{
+		return;
+	}
+
+	// Read in file order, a batch of queued players then touches the mapping front to back.
+	Misses.Sort([&Players](const int32 Lhs, const int32 Rhs)
+	{
+		return Players[Lhs] < Players[Rhs];
+	});
+	TArray<FOpenSkillPlayerId> MissPlayers;
+	TArray<FOpenSkillRating> Loaded;
+	MissPlayers.SetNumUninitialized(Misses.Num());
+	Loaded.SetNumUninitialized(Misses.Num());
+	for (int32 i = 0; i < Misses.Num(); ++i)
+	{
+		MissPlayers[i] = Players[Misses[i]];
+	}
+
+	for (;;)
+	{
+		ReadCold(MissPlayers, Loaded);
+
+		FScopeLock Lock(&HotLock);
+		// A write-back started since the lookup may have put newer ratings in the file than the ones just read.
+		if (WriteGeneration != Generation)
+		{
+			Generation = WriteGeneration;
+			continue;
+		}
+		// Players written or loaded by another thread since the lookup keep what is in memory.
+		for (int32 i = 0; i < Misses.Num(); ++i)
+		{
+			const int32 Slot = FindOrAddSlot(MissPlayers[i], &Loaded[i]);
+			OutRatings[Misses[i]] = FOpenSkillRating(Mus[Slot], Sigmas[Slot]);
+			SlotFlags[Slot] |= SlotReferenced;
+		}
+		(bPrefetch ? Stats.Prefetches : Stats.Misses) += Misses.Num();
+		return;
+	}
+}
+
+int32 FOpenSkillTieredStore::FindOrAddSlot(const FOpenSkillPlayerId Player, const FOpenSkillRating* Loaded)
+{
+	if (const int32* Found = Slots.Find(Player))
+	{
+		return *Found;
+	}
+
+	// The write-back queue is newer than the file, and the queue is newer than the batch being written.
+	uint8 Flags = 0;
+	FOpenSkillRating Rating = Loaded ? *Loaded : DefaultRating;
+	FOpenSkillRating Queued;
+	if (PendingWrites.RemoveAndCopyValue(Player, Queued))
+	{
+		Rating = Queued;
+		Flags = SlotDirty;
+	}
+	else if (const FOpenSkillRating* Writing = WritingBatch.Find(Player))
+	{
+		Rating = *Writing;
+	}
+
+	const int32 Slot = AllocateSlot();
+	Mus[Slot] = Rating.Mu;
+	Sigmas[Slot] = Rating.Sigma;
+	SlotPlayers[Slot] = Player;
+	SlotFlags[Slot] = Flags;
+	Slots.Add(Player, Slot);
+	return Slot;
+}
+
+int32 FOpenSkillTieredStore::AllocateSlot()
+{
+	if (SlotPlayers.Num() < Config.HotCapacity)
+	{
+		Mus.AddUninitialized();
+		Sigmas.AddUninitialized();
+		SlotPlayers.AddUninitialized();
+		return SlotFlags.Add(0);
+	}
+
+	// Clock sweep, every referenced slot passed over gets a second chance.
+	while (SlotFlags[ClockHand] & SlotReferenced)
+	{
+		SlotFlags[ClockHand] &= ~SlotReferenced;
+		ClockHand = (ClockHand + 1) % SlotFlags.Num();
+	}
+	const int32 Slot = ClockHand;
+	ClockHand = (ClockHand + 1) % SlotFlags.Num();
+
+	Slots.Remove(SlotPlayers[Slot]);
+	if (SlotFlags[Slot] & SlotDirty)
+	{
+		PendingWrites.Add(SlotPlayers[Slot], FOpenSkillRating(Mus[Slot], Sigmas[Slot]));
+		if (bOpen && PendingWrites.Num() >= Config.WriteBackBatchSize && !bWriteBackQueued)
+		{
+			bWriteBackQueued = true;
+			FOpenSkillTieredStoreCommand Command;
+			Command.Type = FOpenSkillTieredStoreCommand::EType::WriteBack;
+			Worker->Enqueue(MoveTemp(Command));
+		}
+	}
+	++Stats.Evictions;
+	return Slot;
+}
+
+void FOpenSkillTieredStore::ReadCold(TArrayView<const FOpenSkillPlayerId> Players, TArrayView<FOpenSkillRating> OutRatings) const
+{
+	using namespace OpenSkillTieredStore;
+	FReadScopeLock Lock(ColdLock);
+	if (MappedRegion.IsValid())
+	{
+		const FRow* Table = reinterpret_cast<const FRow*>(MappedRegion->GetMappedPtr());
+		const int64 MappedRows = MappedRegion->GetMappedSize() / static_cast<int64>(sizeof(FRow));
+		for (int32 i = 0; i < Players.Num(); ++i)
+		{
+			const int64 Row = static_cast<int64>(Players[i]);
+			OutRatings[i] = Row < MappedRows ? FOpenSkillRating(Table[Row].Mu, Table[Row].Sigma) : DefaultRating;
+		}
+		return;
+	}
+
+	// No mapping, one read per player through a file handle of our own.
+	const int64 Rows = NumRows.load(std::memory_order_relaxed);
+	TUniquePtr<IFileHandle> File(bOpen && Rows > 0 ? FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Path) : nullptr);
+	for (int32 i = 0; i < Players.Num(); ++i)
+	{
+		const int64 Row = static_cast<int64>(Players[i]);
+		FRow Data;
+		if (File.IsValid() && Row < Rows && File->Seek(Row * sizeof(FRow)) && File->Read(reinterpret_cast<uint8*>(&Data), sizeof(FRow)))
+		{
+			OutRatings[i] = FOpenSkillRating(Data.Mu, Data.Sigma);
+		}
+		else
+		{
+			OutRatings[i] = DefaultRating;
+		}
+	}
+}
+
+void FOpenSkillTieredStore::OpenMapping()
+{
+	// Callers hold ColdLock for writing or have the store to themselves.
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	if (NumRows.load(std::memory_order_relaxed) == 0)
+	{
+		return;
+	}
+	MappedFile.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Path));
+	if (MappedFile.IsValid())
+	{
+		MappedRegion.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+	}
+	if (!MappedRegion.IsValid())
+	{
+		MappedFile.Reset();
+	}
+}
+
+void FOpenSkillTieredStore::WriteBack(const bool bAll)
+{
+	using namespace OpenSkillTieredStore;
+
+	TArray<TTuple<FOpenSkillPlayerId, FOpenSkillRating>> Batch;
+	{
+		FScopeLock Lock(&HotLock);
+		bWriteBackQueued = false;
+		if (bAll)
+		{
+			for (int32 Slot = 0; Slot < SlotFlags.Num(); ++Slot)
+			{
+				if (SlotFlags[Slot] & SlotDirty)
+				{
+					SlotFlags[Slot] &= ~SlotDirty;
+					WritingBatch.Add(SlotPlayers[Slot], FOpenSkillRating(Mus[Slot], Sigmas[Slot]));
+				}
+			}
+		}
+		else if (PendingWrites.Num() < Config.WriteBackBatchSize)
+		{
+			return;
+		}
+		// Readers find these in WritingBatch until they are in the file.
+		for (const auto& Pending : PendingWrites)
+		{
+			WritingBatch.Add(Pending.Key, Pending.Value);
+		}
+		PendingWrites.Reset();
+		++WriteGeneration;
+		Batch.Reserve(WritingBatch.Num());
+		for (const auto& Writing : WritingBatch)
+		{
+			Batch.Emplace(Writing.Key, Writing.Value);
+		}
+	}
+	if (Batch.Num() == 0)
+	{
+		return;
+	}
+	Batch.Sort([](const TTuple<FOpenSkillPlayerId, FOpenSkillRating>& Lhs, const TTuple<FOpenSkillPlayerId, FOpenSkillRating>& Rhs)
+	{
+		return Lhs.Key < Rhs.Key;
+	});
+
+	bool bWritten = bOpen;
+	if (bOpen)
+	{
+		FWriteScopeLock Lock(ColdLock);
+		// Unmapped while writing, some platforms refuse to open a file for writing while it is mapped.
+		MappedRegion.Reset();
+		MappedFile.Reset();
+
+		TUniquePtr<IFileHandle> File(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*Path, true, true));
+		bWritten = File.IsValid();
+		int64 Rows = NumRows.load(std::memory_order_relaxed);
+		const int64 NeededRows = static_cast<int64>(Batch.Last().Key) + 1;
+		if (bWritten && NeededRows > Rows)
+		{
+			TArray<FRow> Fill;
+			Fill.Init(FRow{DefaultRating.Mu, DefaultRating.Sigma}, static_cast<int32>(FMath::Min(NeededRows - Rows, RowsPerExtend)));
+			bWritten = File->Seek(Rows * sizeof(FRow));
+			while (bWritten && Rows < NeededRows)
+			{
+				const int64 Count = FMath::Min<int64>(NeededRows - Rows, Fill.Num());
+				bWritten = File->Write(reinterpret_cast<const uint8*>(Fill.GetData()), Count * sizeof(FRow));
+				Rows += bWritten ? Count : 0;
+			}
+		}
+
+		// Players next to each other in the file go out in one write.
+		TArray<FRow> Run;
+		for (int32 First = 0; bWritten && First < Batch.Num();)
+		{
+			int32 Last = First;
+			Run.Reset();
+			Run.Add(FRow{Batch[First].Value.Mu, Batch[First].Value.Sigma});
+			while (Last + 1 < Batch.Num() && Batch[Last + 1].Key == Batch[Last].Key + 1)
+			{
+				++Last;
+				Run.Add(FRow{Batch[Last].Value.Mu, Batch[Last].Value.Sigma});
+			}
+			bWritten = File->Seek(static_cast<int64>(Batch[First].Key) * sizeof(FRow)) && File->Write(reinterpret_cast<const uint8*>(Run.GetData()), Run.Num() * sizeof(FRow));
+			First = Last + 1;
+		}
+		if (File.IsValid())
+		{
+			File->Flush();
+			File.Reset();
+		}
+		NumRows = FMath::Max(Rows, NumRows.load(std::memory_order_relaxed));
+		if (!bWritten)
+		{
+			UE_LOG(LogOpenSkillTieredStore, Error, TEXT("Could not write %d ratings back to '%s'."), Batch.Num(), *Path);
+		}
+		OpenMapping();
+	}
+
+	FScopeLock Lock(&HotLock);
+	if (bWritten)
+	{
+		Stats.WriteBacks += Batch.Num();
+		++Stats.WriteBatches;
+	}
+	else
+	{
+		// Queued again so a later batch retries them. A queued rating is newer than the batch, and a player loaded
+		// from the batch in the meantime is marked dirty so its slot writes it back when evicted.
+		for (const auto& Writing : WritingBatch)
+		{
+			if (const int32* Slot = Slots.Find(Writing.Key))
+			{
+				SlotFlags[*Slot] |= SlotDirty;
+			}
+			else if (!PendingWrites.Contains(Writing.Key))
+			{
+				PendingWrites.Add(Writing.Key, Writing.Value);
+			}
+		}
+	}
+	WritingBatch.Reset();
+}
@@ -0,0 +1,315 @@
+﻿#include "OpenSkillTuning.h"
+#include "OpenSkillCompiledOptions.h"
+#include "OpenSkillMatchHistory.h"
+#include "OpenSkillModeling.h"
+#include "OpenSkillSimulation.h"
+#include "OpenSkillStatistics.h"
+#include "OpenSkillTwoTeam.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogOpenSkillTuning, Log, All);
+
+namespace OpenSkillTuning
+{
+	// Candidates sharing one interleaved rating table and one walk over each window.
+	constexpr int32 LanesPerBlock = 8;
+	// Matches every block replays before the blocks sync up again.
+	constexpr int32 MatchesPerWindow = 2048;
+
+	struct FBlock
+	{
+		TArray<EOpenSkillModel> Models;
+		TArray<FOpenSkillCompiledOptions> Options;
+		// NumPlayers * Models.Num() ratings, each player's lanes side by side.
+		TArray<FOpenSkillRating> Ratings;
+		TArray<double> LogLossSums;
+
+		// Per match scratch, reused so the replay does not allocate once warmed up.
+		TArray<TArray<FOpenSkillRating>> Teams;
+		TArray<int> Ranks;
+		TArray<double> TeamMu;
+		TArray<double> TeamSigmaSq;
+	};
+
+	void RateTwoTeams(const EOpenSkillModel Model, TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks, const FOpenSkillOptions& Options)
+	{
+		double Mu[2] = {0, 0};
+		double SigmaSq[2] = {0, 0};
+		for (int Team = 0; Team < 2; ++Team)
+		{
+			for (const FOpenSkillRating& Member : Teams[Team])
+			{
+				Mu[Team] += Member.Mu;
+				SigmaSq[Team] += FMath::Square(Member.Sigma);
+			}
+		}
+
+		// Teams are in rank order, so the first team is never behind.
+		const int RankA = 0;
+		const int RankB = Ranks[1] == Ranks[0] ? 0 : 1;
+		const double GammaC = FOpenSkillTwoTeam::GetGammaC(Model, SigmaSq[0], SigmaSq[1], Options);
+		const double GammaA = Options.Gamma(GammaC, 2, Mu[0], SigmaSq[0], Teams[0], RankA);
+		const double GammaB = Options.Gamma(GammaC, 2, Mu[1], SigmaSq[1], Teams[1], RankB);
+		const FOpenSkillTwoTeamUpdate Update = FOpenSkillTwoTeam::ComputeUpdate(Model, Mu[0], SigmaSq[0], Mu[1], SigmaSq[1], RankA, RankB, GammaA, GammaB, Options);
+
+		const bool bClampSigma = Options.Tau > 0 && Options.PreventSigmaIncrease;
+		const double Omega[2] = {Update.OmegaA, Update.OmegaB};
+		const double Delta[2] = {Update.DeltaA, Update.DeltaB};
+		for (int Team = 0; Team < 2; ++Team)
+		{
+			for (FOpenSkillRating& Member : Teams[Team])
+			{
+				const double PriorSigma = Member.Sigma;
+				const double Share = FMath::Square(Member.Sigma) / SigmaSq[Team];
+				Member.Mu += Share * Omega[Team];
+				Member.Sigma *= FMath::Sqrt(FMath::Max(1 - Share * Delta[Team], Options.Kappa));
+				if (bClampSigma)
+				{
+					Member.Sigma = FMath::Min(Member.Sigma, PriorSigma);
+				}
+			}
+		}
+	}
+
+	void RateTeams(TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks, const FOpenSkillCompiledOptions& Snapshot)
+	{
+		const FOpenSkillOptions& Options = Snapshot.Options;
+		const TArray<TArray<FOpenSkillRating>> NewRatings = Options.Model(Teams, Ranks, Snapshot);
+		const bool bClampSigma = Options.Tau > 0 && Options.PreventSigmaIncrease;
+		for (int Team = 0; Team < Teams.Num(); ++Team)
+		{
+			for (int Member = 0; Member < Teams[Team].Num(); ++Member)
+			{
+				FOpenSkillRating& Rating = Teams[Team][Member];
+				const double PriorSigma = Rating.Sigma;
+				Rating = NewRatings[Team][Member];
+				if (bClampSigma)
+				{
+					Rating.Sigma = FMath::Min(Rating.Sigma, PriorSigma);
+				}
+			}
+		}
+	}
+
+	void ReplayMatch(FBlock& Block, const FOpenSkillMatchHistory& History, const int32 Match)
+	{
+		const int32 NumTeams = History.GetNumTeams(Match);
+		if (NumTeams < 2)
+		{
+			return;
+		}
+
+		const int32 NumLanes = Block.Models.Num();
+		Block.Teams.SetNum(NumTeams);
+		Block.Ranks.Reset();
+		Block.TeamMu.SetNumUninitialized(NumTeams);
+		Block.TeamSigmaSq.SetNumUninitialized(NumTeams);
+		for (int Team = 0; Team < NumTeams; ++Team)
+		{
+			Block.Ranks.Add(History.GetTeamRank(Match, Team));
+		}
+
+		for (int Lane = 0; Lane < NumLanes; ++Lane)
+		{
+			const FOpenSkillCompiledOptions& Snapshot = Block.Options[Lane];
+			const FOpenSkillOptions& Options = Snapshot.Options;
+			for (int Team = 0; Team < NumTeams; ++Team)
+			{
+				TArray<FOpenSkillRating>& Members = Block.Teams[Team];
+				Members.Reset();
+				double Mu = 0;
+				double SigmaSq = 0;
+				for (const int32 Player : History.GetTeamPlayers(Match, Team))
+				{
+					const FOpenSkillRating& Rating = Block.Ratings[Player * NumLanes + Lane];
+					Members.Add(Rating);
+					Mu += Rating.Mu;
+					SigmaSq += FMath::Square(Rating.Sigma);
+				}
+				Block.TeamMu[Team] = Mu;
+				Block.TeamSigmaSq[Team] = SigmaSq;
+			}
+
+			const double Probability = FOpenSkillModeling::GetWinProbability(Block.TeamMu, Block.TeamSigmaSq, 0, Snapshot.BetaSquared);
+			Block.LogLossSums[Lane] -= FMath::Loge(FMath::Clamp(Probability, 1e-12, 1.0));
+
+			if (Options.Tau > 0)
+			{
+				const double TauSquared = Snapshot.TauSquared;
+				for (TArray<FOpenSkillRating>& Members : Block.Teams)
+				{
+					for (FOpenSkillRating& Member : Members)
+					{
+						Member.Sigma = FMath::Sqrt(FMath::Square(Member.Sigma) + TauSquared);
+					}
+				}
+			}
+
+			if (NumTeams == 2)
+			{
+				RateTwoTeams(Block.Models[Lane], Block.Teams, Block.Ranks, Options);
+			}
+			else
+			{
+				RateTeams(Block.Teams, Block.Ranks, Snapshot);
+			}
+
+			for (int Team = 0; Team < NumTeams; ++Team)
+			{
+				const TArrayView<const int32> Players = History.GetTeamPlayers(Match, Team);
+				for (int Member = 0; Member < Players.Num(); ++Member)
+				{
+					Block.Ratings[Players[Member] * NumLanes + Lane] = Block.Teams[Team][Member];
+				}
+			}
+		}
+	}
+
+	void Tune(const TArray<FString>& Args)
+	{
+		FOpenSkillSimulationConfig Config = FOpenSkillSimulationConfig::Duel();
+		if (Args.Num() > 0 && !FOpenSkillSimulationConfig::FromName(Args[0], Config))
+		{
+			UE_LOG(LogOpenSkillTuning, Error, TEXT("Unknown match format '%s', expected 1v1, 5v5, Squads or FFA."), *Args[0]);
+			return;
+		}
+		if (Args.Num() > 1)
+		{
+			Config.Seed = FCString::Atoi(*Args[1]);
+		}
+		if (Args.Num() > 2)
+		{
+			Config.NumMatches = FMath::Max(FCString::Atoi(*Args[2]), 1);
+		}
+
+		const FOpenSkillMatchHistory History = FOpenSkillSimulation(Config).GetHistory();
+
+		const FOpenSkillOptions Defaults;
+		TArray<EOpenSkillModel> Models;
+		for (int Model = 0; Model < static_cast<int>(EOpenSkillModel::Count); ++Model)
+		{
+			Models.Add(static_cast<EOpenSkillModel>(Model));
+		}
+		TArray<double> Betas;
+		for (const double Scale : {0.5, 0.75, 1.0, 1.25, 1.5, 2.0, 2.5, 3.0})
+		{
+			Betas.Add(Defaults.Beta * Scale);
+		}
+		TArray<double> Taus;
+		for (const double Scale : {0.0, 0.5, 1.0, 2.0, 4.0})
+		{
+			Taus.Add(Defaults.Tau * Scale);
+		}
+		const double Kappa = Defaults.Kappa;
+		const TArray<FOpenSkillTuningCandidate> Candidates = FOpenSkillTuning::MakeGrid(Models, Betas, Taus, TArrayView<const double>(&Kappa, 1));
+
+		const double StartTime = FPlatformTime::Seconds();
+		const TArray<FOpenSkillTuningResult> Results = FOpenSkillTuning::Search(History, Candidates, 5);
+		UE_LOG(LogOpenSkillTuning, Display, TEXT("Replayed %d matches under %d option sets in %.2fs"), History.Num(), Candidates.Num(), FPlatformTime::Seconds() - StartTime);
+
+		for (const FOpenSkillTuningResult& Result : Results)
+		{
+			const FOpenSkillTuningCandidate& Candidate = Candidates[Result.Candidate];
+			UE_LOG(LogOpenSkillTuning, Display, TEXT("%-26s beta %.3f  tau %.4f  log loss %.4f"),
+			       FOpenSkillModeling::GetModelName(Candidate.Model), Candidate.Options.Beta, Candidate.Options.Tau, Result.LogLoss);
+		}
+	}
+
+	FAutoConsoleCommand TuneCommand(
+		TEXT("OpenSkill.Tune"),
+		TEXT("Grid search model, beta and tau on a synthetic population. Usage: OpenSkill.Tune [1v1|5v5|Squads|FFA] [Seed] [Matches]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&Tune));
+}
+
+TArray<FOpenSkillTuningResult> FOpenSkillTuning::Search(const FOpenSkillMatchHistory& History, TArrayView<const FOpenSkillTuningCandidate> Candidates, const int32 MaxResults)
+{
+	using namespace OpenSkillTuning;
+
+	const int32 NumPlayers = History.GetNumPlayers();
+	TArray<FBlock> Blocks;
+	Blocks.SetNum(FMath::DivideAndRoundUp(Candidates.Num(), LanesPerBlock));
+	for (int BlockIndex = 0; BlockIndex < Blocks.Num(); ++BlockIndex)
+	{
+		FBlock& Block = Blocks[BlockIndex];
+		const int32 FirstCandidate = BlockIndex * LanesPerBlock;
+		const int32 NumLanes = FMath::Min(LanesPerBlock, Candidates.Num() - FirstCandidate);
+		for (int Lane = 0; Lane < NumLanes; ++Lane)
+		{
+			const FOpenSkillTuningCandidate& Candidate = Candidates[FirstCandidate + Lane];
+			Block.Models.Add(Candidate.Model);
+			FOpenSkillOptions Options = Candidate.Options;
+			Options.Model = FOpenSkillModeling::GetModel(Candidate.Model);
+			Block.Options.Emplace(Options);
+		}
+		Block.LogLossSums.SetNumZeroed(NumLanes);
+		Block.Ratings.SetNumUninitialized(NumPlayers * NumLanes);
+		for (int Player = 0; Player < NumPlayers; ++Player)
+		{
+			for (int Lane = 0; Lane < NumLanes; ++Lane)
+			{
+				Block.Ratings[Player * NumLanes + Lane] = FOpenSkillRating(Block.Options[Lane].Options.Mu, Block.Options[Lane].Options.Sigma);
+			}
+		}
+	}
+
+	int32 NumScored = 0;
+	for (int WindowStart = 0; WindowStart < History.Num(); WindowStart += MatchesPerWindow)
+	{
+		const int32 WindowEnd = FMath::Min(WindowStart + MatchesPerWindow, History.Num());
+		ParallelFor(Blocks.Num(), [&Blocks, &History, WindowStart, WindowEnd](const int32 BlockIndex)
+		{
+			for (int Match = WindowStart; Match < WindowEnd; ++Match)
+			{
+				ReplayMatch(Blocks[BlockIndex], History, Match);
+			}
+		});
+		for (int Match = WindowStart; Match < WindowEnd; ++Match)
+		{
+			NumScored += History.GetNumTeams(Match) >= 2 ? 1 : 0;
+		}
+	}
+
+	TArray<FOpenSkillTuningResult> Results;
+	Results.Reserve(Candidates.Num());
+	for (int BlockIndex = 0; BlockIndex < Blocks.Num(); ++BlockIndex)
+	{
+		const FBlock& Block = Blocks[BlockIndex];
+		for (int Lane = 0; Lane < Block.LogLossSums.Num(); ++Lane)
+		{
+			FOpenSkillTuningResult& Result = Results.AddDefaulted_GetRef();
+			Result.Candidate = BlockIndex * LanesPerBlock + Lane;
+			Result.LogLoss = NumScored > 0 ? Block.LogLossSums[Lane] / NumScored : 0;
+		}
+	}
+	Results.StableSort([](const FOpenSkillTuningResult& Lhs, const FOpenSkillTuningResult& Rhs)
+	{
+		return Lhs.LogLoss < Rhs.LogLoss;
+	});
+	Results.SetNum(FMath::Clamp(MaxResults, 0, Results.Num()));
+	return Results;
+}
+
+TArray<FOpenSkillTuningCandidate> FOpenSkillTuning::MakeGrid(TArrayView<const EOpenSkillModel> Models, TArrayView<const double> Betas, TArrayView<const double> Taus, TArrayView<const double> Kappas)
+{
+	TArray<FOpenSkillTuningCandidate> Candidates;
+	Candidates.Reserve(Models.Num() * Betas.Num() * Taus.Num() * Kappas.Num());
+	for (const EOpenSkillModel Model : Models)
+	{
+		for (const double Beta : Betas)
+		{
+			for (const double Tau : Taus)
+			{
+				for (const double Kappa : Kappas)
+				{
+					FOpenSkillTuningCandidate& Candidate = Candidates.AddDefaulted_GetRef();
+					Candidate.Model = Model;
+					Candidate.Options.Beta = Beta;
+					Candidate.Options.Tau = Tau;
+					Candidate.Options.Kappa = Kappa;
+				}
+			}
+		}
+	}
+	return Candidates;
+}
@@ -0,0 +1,94 @@
+﻿#include "OpenSkillTwoTeam.h"
+#include "OpenSkillModeling.h"
+
+double FOpenSkillTwoTeam::GetGammaC(const EOpenSkillModel Model, const double SigmaSqA, const double SigmaSqB, const FOpenSkillOptions& Options)
+{
+	// With two teams GetC and every pairwise Ciq collapse to the same value, only the partial Thurstone-Mosteller model doubles it.
+	const double C = FMath::Sqrt(SigmaSqA + SigmaSqB + 2 * FMath::Square(Options.Beta));
+	return Model == EOpenSkillModel::ThurstoneMostellerPartial ? 2 * C : C;
+}
+
+FOpenSkillTwoTeamUpdate FOpenSkillTwoTeam::ComputeUpdate(const EOpenSkillModel Model, const double MuA, const double SigmaSqA, const double MuB, const double SigmaSqB,
+                                                         const int RankA, const int RankB, const double GammaA, const double GammaB, const FOpenSkillOptions& Options)
+{
+	const double C = FMath::Sqrt(SigmaSqA + SigmaSqB + 2 * FMath::Square(Options.Beta));
+	FOpenSkillTwoTeamUpdate Update;
+
+	switch (Model)
+	{
+	case EOpenSkillModel::PlackettLuce:
+		{
+			// Probability of each team coming first, the SumQ/A terms of the general model reduce to these for two teams.
+			const double PA = 1 / (1 + FMath::Exp((MuB - MuA) / C));
+			const double PB = 1 - PA;
+			double OmegaSumA;
+			double OmegaSumB;
+			if (RankA == RankB)
+			{
+				OmegaSumA = (PB - PA) / 2;
+				OmegaSumB = (PA - PB) / 2;
+			}
+			else if (RankA < RankB)
+			{
+				OmegaSumA = PB;
+				OmegaSumB = -PB;
+			}
+			else
+			{
+				OmegaSumA = -PA;
+				OmegaSumB = PA;
+			}
+			const double DeltaSum = PA * PB;
+			Update.OmegaA = OmegaSumA * (SigmaSqA / C);
+			Update.OmegaB = OmegaSumB * (SigmaSqB / C);
+			Update.DeltaA = GammaA * DeltaSum * (SigmaSqA / FMath::Square(C));
+			Update.DeltaB = GammaB * DeltaSum * (SigmaSqB / FMath::Square(C));
+			break;
+		}
+	case EOpenSkillModel::ThurstoneMostellerFull:
+	case EOpenSkillModel::ThurstoneMostellerPartial:
+		{
+			const double Ciq = Model == EOpenSkillModel::ThurstoneMostellerPartial ? 2 * C : C;
+			double V;
+			double W;
+			FOpenSkillModeling::ThurstoneMostellerPair((MuA - MuB) / Ciq, Options.Kappa / Ciq, RankA, RankB, V, W);
+			Update.OmegaA = (SigmaSqA / Ciq) * V;
+			Update.OmegaB = -(SigmaSqB / Ciq) * V;
+			Update.DeltaA = ((GammaA * SigmaSqA / Ciq) / Ciq) * W;
+			Update.DeltaB = ((GammaB * SigmaSqB / Ciq) / Ciq) * W;
+			break;
+		}
+	case EOpenSkillModel::BradleyTerryFull:
+	case EOpenSkillModel::BradleyTerryPartial:
+	default:
+		{
+			double PairOmega;
+			double PairDelta;
+			FOpenSkillModeling::BradleyTerryPair(MuA, MuB, C, RankA, RankB, PairOmega, PairDelta);
+			Update.OmegaA = (SigmaSqA / C) * PairOmega;
+			Update.OmegaB = -(SigmaSqB / C) * PairOmega;
+			Update.DeltaA = ((GammaA * SigmaSqA / C) / C) * PairDelta;
+			Update.DeltaB = ((GammaB * SigmaSqB / C) / C) * PairDelta;
+			break;
+		}
+	}
+	return Update;
+}
+
+void FOpenSkillTwoTeam::RateDuels(const EOpenSkillModel Model, TArrayView<FOpenSkillRating> Winners, TArrayView<FOpenSkillRating> Losers, TArrayView<const bool> Draws, const FOpenSkillOptions& Options)
+{
+	check(Winners.Num() == Losers.Num())
+	check(Draws.Num() == 0 || Draws.Num() == Winners.Num())
+
+	for (int i = 0; i < Winners.Num(); ++i)
+	{
+		TStaticArray<FOpenSkillRating, 1> A;
+		TStaticArray<FOpenSkillRating, 1> B;
+		A[0] = Winners[i];
+		B[0] = Losers[i];
+		const bool bDraw = Draws.Num() > 0 && Draws[i];
+		Rate(Model, A, B, 0, bDraw ? 0 : 1, Options);
+		Winners[i] = A[0];
+		Losers[i] = B[0];
+	}
+}
@@ -1,275 +1,544 @@
-﻿// Copyright Epic Games, Inc. All Rights Reserved.
-
-#include "OpenSkillUnreal.h"
-#include "OpenSkillStatistics.h"
-
-#define LOCTEXT_NAMESPACE "FOpenSkillUnrealModule"
-
-TArray<TArray<FOpenSkillRating>> FOpenSkillUnrealModule::RateByOrdinal(const TArray<TArray<FOpenSkillRating>>& Teams) const
-{
-	TArray<TArray<FOpenSkillRating>> ProcessedTeams = Teams;
-	TArray<int> Ranks;
-	Ranks.Reserve(Teams.Num());
-	for (int i = 1; i <= Teams.Num(); ++i)
-	{
-		Ranks.Add(i);
-	}
-	return RateInternal(MoveTemp(ProcessedTeams), MoveTemp(Ranks), {});
-}
-
-TArray<TArray<FOpenSkillRating>> FOpenSkillUnrealModule::RateByRank(const TArray<TTuple<TArray<FOpenSkillRating>, int>>& Teams) const
-{
-	TArray<TArray<FOpenSkillRating>> ProcessedTeams;
-	TArray<int> Ranks;
-	ProcessedTeams.Reserve(Teams.Num());
-	Ranks.Reserve(Teams.Num());
-	for (const TTuple<TArray<FOpenSkillRating>, int>& Team : Teams)
-	{
-		ProcessedTeams.Emplace(Team.Key);
-		Ranks.Emplace(Team.Value);
-	}
-	return RateInternal(MoveTemp(ProcessedTeams), MoveTemp(Ranks), {});
-}
-
-TArray<TArray<FOpenSkillRating>> FOpenSkillUnrealModule::RateByScore(const TArray<TTuple<TArray<FOpenSkillRating>, int>>& Teams) const
-{
-	TArray<TArray<FOpenSkillRating>> ProcessedTeams;
-	TArray<int> InverseScores;
-	ProcessedTeams.Reserve(Teams.Num());
-	InverseScores.Reserve(Teams.Num());
-	for (const TTuple<TArray<FOpenSkillRating>, int>& Team : Teams)
-	{
-		ProcessedTeams.Emplace(Team.Key);
-		InverseScores.Emplace(-Team.Value);
-	}
-	return RateInternal(MoveTemp(ProcessedTeams), MoveTemp(InverseScores), {});
-}
-
-TArray<double> FOpenSkillUnrealModule::PredictWin(const TArray<TArray<FOpenSkillRating>>& Teams) const
-{
-	const double BetaSquared = FMath::Square(Options.Beta);
-	const double N = Teams.Num();
-	const double Denom = (N * (N - 1)) / 2;
-	const TArray<FOpenSkillTeamRating> TeamRatings = FOpenSkillModeling::GetTeamRatings(Teams, {});
-
-	TArray<double> Result;
-	Result.Reserve(Teams.Num());
-
-	for (int i = 0; i < TeamRatings.Num(); ++i)
-	{
-		const FOpenSkillTeamRating& TeamI = TeamRatings[i];
-
-		double Prob = 0;
-		for (int q = 0; q < TeamRatings.Num(); ++q)
-		{
-			if (i == q)
-			{
-				continue;
-			}
-
-			const FOpenSkillTeamRating& TeamQ = TeamRatings[q];
-			Prob += FOpenSkillStatistics::PhiMajor((TeamI.Mu - TeamQ.Mu) / FMath::Sqrt(N * BetaSquared + FMath::Square(TeamI.SigmaSq) + FMath::Square(TeamQ.SigmaSq)));
-		}
-		Result.Emplace(Prob / Denom);
-	}
-	return Result;
-}
-
-
-double FOpenSkillUnrealModule::PredictDraw(const TArray<TArray<FOpenSkillRating>>& Teams) const
-{
-	const double Beta = Options.Beta;
-	const double BetaSquared = FMath::Square(Options.Beta);
-	const double N = Teams.Num();
-
-	if (N == 0)
-	{
-		return 0;
-	}
-	if (N == 1)
-	{
-		return 1;
-	}
-
-	const double Denom = (N * (N - 1)) / (N > 2 ? 1 : 2);
-	const TArray<FOpenSkillTeamRating> TeamRatings = FOpenSkillModeling::GetTeamRatings(Teams, {});
-
-	double PlayerCount = 0;
-	for (const TArray<FOpenSkillRating>& Players : Teams)
-	{
-		PlayerCount += Players.Num();
-	}
-
-	const double DrawMargin = FMath::Sqrt(PlayerCount) * Beta * FOpenSkillStatistics::PhiMajorInverse((1 + 1 / N) / 2);
-
-	double Result = 0;
-
-	for (int i = 0; i < TeamRatings.Num(); ++i)
-	{
-		const FOpenSkillTeamRating& TeamI = TeamRatings[i];
-		for (int q = 0; q < TeamRatings.Num(); ++q)
-		{
-			if (i == q)
-			{
-				continue;
-			}
-			const FOpenSkillTeamRating& TeamQ = TeamRatings[q];
-			const double SigmaBar = FMath::Sqrt(N * BetaSquared + FMath::Square(TeamI.SigmaSq) + FMath::Square(TeamQ.SigmaSq));
-			Result += FOpenSkillStatistics::PhiMajor((DrawMargin - TeamI.Mu + TeamQ.Mu) / SigmaBar) - FOpenSkillStatistics::PhiMajor((TeamI.Mu - TeamQ.Mu - DrawMargin) / SigmaBar);
-		}
-	}
-	return FMath::Abs(Result) / Denom;
-}
-
-TArray<TTuple<int, double>> FOpenSkillUnrealModule::PredictRank(const TArray<TArray<FOpenSkillRating>>& Teams) const
-{
-	if (Teams.Num() == 0)
-	{
-		return {};
-	}
-	if (Teams.Num() == 1)
-	{
-		return {TTuple<int, double>(1, 1.0)};
-	}
-
-	const double Beta = Options.Beta;
-	const double BetaSquared = FMath::Square(Options.Beta);
-
-	double PlayerCount = 0;
-	for (const TArray<FOpenSkillRating>& Players : Teams)
-	{
-		PlayerCount += Players.Num();
-	}
-
-	const double N = Teams.Num();
-	const double Denom = (N * (N - 1)) / 2;
-	const double DrawMargin = FMath::Sqrt(PlayerCount) * Beta * FOpenSkillStatistics::PhiMajorInverse((1 + 1 / N) / 2);
-
-	TArray<double> PairwiseProbabilities;
-	PairwiseProbabilities.Reserve(N * N - N);
-	for (int i = 0; i < Teams.Num(); ++i)
-	{
-		for (int j = 0; j < Teams.Num(); ++j)
-		{
-			if (i == j)
-			{
-				continue;
-			}
-			const FOpenSkillTeamRating TeamIRating = FOpenSkillModeling::GetTeamRating(Teams[i], 0);
-			const FOpenSkillTeamRating TeamJRating = FOpenSkillModeling::GetTeamRating(Teams[j], 0);
-			PairwiseProbabilities.Add(FOpenSkillStatistics::PhiMajor((TeamIRating.Mu - TeamJRating.Mu - DrawMargin) / FMath::Sqrt(N * BetaSquared + FMath::Square(TeamIRating.SigmaSq) + FMath::Square(TeamJRating.SigmaSq))));
-		}
-	}
-	TArray<double> WinProbability;
-	WinProbability.Reserve(PairwiseProbabilities.Num() / (N - 1));
-	for (int i = 0; i < PairwiseProbabilities.Num(); i += N - 1)
-	{
-		double TeamProb = 0;
-		for (int j = 0; j < N - 1; ++j)
-		{
-			TeamProb += PairwiseProbabilities[i + j];
-		}
-		WinProbability.Add(TeamProb / Denom);
-	}
-	for (int i = 0; i < WinProbability.Num(); ++i)
-	{
-		WinProbability[i] = FMath::Abs(WinProbability[i]);
-	}
-	TArray<int> Ranks = RankMinimum(WinProbability);
-	const int MaxOrdinal = FMath::Max(Ranks);
-	for (int i = 0; i < Ranks.Num(); ++i)
-	{
-		Ranks[i] = FMath::Abs(Ranks[i] - MaxOrdinal) + 1;
-	}
-	TArray<TTuple<int, double>> Results;
-	Results.Reserve(Teams.Num());
-
-	for (int i = 0; i < WinProbability.Num(); ++i)
-	{
-		Results.Emplace(Ranks[i], WinProbability[i]);
-	}
-
-	return Results;
-}
-
-double FOpenSkillUnrealModule::GetOrdinal(const FOpenSkillRating& Rating) const
-{
-	return Rating.Mu - Options.Z * Rating.Sigma;
-}
-
-
-TArray<TArray<FOpenSkillRating>> FOpenSkillUnrealModule::RateInternal(TArray<TArray<FOpenSkillRating>>&& Teams, TArray<int>&& Ranks, TArray<int>&& Weights) const
-{
-	if (Options.Tau > 0)
-	{
-		const double TauSquared = FMath::Square(Options.Tau);
-		for (TArray<FOpenSkillRating>& Team : Teams)
-		{
-			for (FOpenSkillRating& Member : Team)
-			{
-				Member.Sigma = FMath::Sqrt(FMath::Square(Member.Sigma) + TauSquared);
-			}
-		}
-	}
-
-	TArray<TArray<FOpenSkillRating>> OrderedTeams;
-	TArray<int> Tenet;
-	FOpenSkillModeling::Unwind(Ranks, Teams, OrderedTeams, Tenet);
-	// Sort ranks because the Teams list got sorted by the value of Ranks during Unwind.
-	// Can be done in-place as it's not going to be used again against the original Teams list.
-	Ranks.Sort();
-
-	const TArray<TArray<FOpenSkillRating>> NewRatings = Options.Model(Teams, Ranks, Options);
-
-	TArray<TArray<FOpenSkillRating>> ReorderedTeams;
-	TArray<int> ReorderedTenet; // Unused.
-	FOpenSkillModeling::Unwind(Tenet, NewRatings, ReorderedTeams, ReorderedTenet);
-
-	if (Options.Tau > 0 && Options.PreventSigmaIncrease)
-	{
-		for (int i = 0; i < ReorderedTeams.Num(); ++i)
-		{
-			TArray<FOpenSkillRating>& Team = ReorderedTeams[i];
-			for (int j = 0; j < Team.Num(); ++j)
-			{
-				FOpenSkillRating& Rating = Team[j];
-				Rating.Sigma = FMath::Min(Rating.Sigma, Teams[i][j].Sigma);
-			}
-		}
-	}
-	return ReorderedTeams;
-}
-
-TArray<int> FOpenSkillUnrealModule::RankMinimum(const TArray<double>& A)
-{
-	const int N = A.Num();
-	TArray<double> SortedA;
-	TArray<int> Tenet;
-	FOpenSkillModeling::UnwindByValue(A, SortedA, Tenet);
-
-	double SumRanks = 0;
-	int DuplicateCount = 0;
-
-	TArray<int> Result;
-	Result.AddZeroed(N);
-
-	for (int i = 0; i < N; ++i)
-	{
-		SumRanks += i;
-		DuplicateCount++;
-		if (i == N - 1 || SortedA[i] != SortedA[i + 1])
-		{
-			for (int j = i - DuplicateCount + 1; j < i + 1; ++j)
-			{
-				Result[Tenet[j]] = i + 1 - DuplicateCount + 1;
-			}
-			SumRanks = 0;
-			DuplicateCount = 0;
-		}
-	}
-	return Result;
-}
-
-#undef LOCTEXT_NAMESPACE
-
-IMPLEMENT_MODULE(FOpenSkillUnrealModule, OpenSkillUnreal)
+﻿// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "OpenSkillUnreal.h"
+#include "OpenSkillStatistics.h"
+#include "OpenSkillLeaderboard.h"
+#include "Async/ParallelFor.h"
+#include "Misc/ScopeLock.h"
+
+#define LOCTEXT_NAMESPACE "FOpenSkillUnrealModule"
+
+FOpenSkillUnrealModule::FOpenSkillUnrealModule()
+	: CompiledOptions(new FOpenSkillCompiledOptions(FOpenSkillOptions()))
+{
+}
+
+FOpenSkillUnrealModule::~FOpenSkillUnrealModule()
+{
+	delete CompiledOptions.load();
+}
+
+void FOpenSkillUnrealModule::SetOptions(const FOpenSkillOptions& InOptions)
+{
+	// Built before taking the lock, readers never take it at all.
+	const FOpenSkillCompiledOptions* Snapshot = new FOpenSkillCompiledOptions(InOptions);
+
+	FScopeLock Lock(&OptionsLock);
+	const FOpenSkillCompiledOptions* Replaced = CompiledOptions.exchange(Snapshot);
+	RetiredOptions.Emplace(FOpenSkillCompiledOptionsPin::Retire(), Replaced);
+	RetiredOptions.RemoveAll([](const FRetiredOptions& Retired)
+	{
+		return FOpenSkillCompiledOptionsPin::CanReclaim(Retired.Epoch);
+	});
+	if (PredictionCache)
+	{
+		PredictionCache->Empty();
+	}
+}
+
+TArray<TArray<FOpenSkillRating>> FOpenSkillUnrealModule::RateByOrdinal(const TArray<TArray<FOpenSkillRating>>& Teams) const
+{
+	return RateByOrdinal(TArray<TArray<FOpenSkillRating>>(Teams));
+}
+
+TArray<TArray<FOpenSkillRating>> FOpenSkillUnrealModule::RateByOrdinal(TArray<TArray<FOpenSkillRating>>&& Teams) const
+{
+	TArray<int> Ranks;
+	Ranks.Reserve(Teams.Num());
+	for (int i = 1; i <= Teams.Num(); ++i)
+	{
+		Ranks.Add(i);
+	}
+	return RateInternal(MoveTemp(Teams), MoveTemp(Ranks), {});
+}
+
+TArray<TArray<FOpenSkillRating>> FOpenSkillUnrealModule::RateByRank(const TArray<TTuple<TArray<FOpenSkillRating>, int>>& Teams) const
+{
+	TArray<TArray<FOpenSkillRating>> ProcessedTeams;
+	TArray<int> Ranks;
+	ProcessedTeams.Reserve(Teams.Num());
+	Ranks.Reserve(Teams.Num());
+	for (const TTuple<TArray<FOpenSkillRating>, int>& Team : Teams)
+	{
+		ProcessedTeams.Emplace(Team.Key);
+		Ranks.Emplace(Team.Value);
+	}
+	return RateInternal(MoveTemp(ProcessedTeams), MoveTemp(Ranks), {});
+}
+
+TArray<TArray<FOpenSkillRating>> FOpenSkillUnrealModule::RateByRank(TArray<TTuple<TArray<FOpenSkillRating>, int>>&& Teams) const
+{
+	TArray<TArray<FOpenSkillRating>> ProcessedTeams;
+	TArray<int> Ranks;
+	ProcessedTeams.Reserve(Teams.Num());
+	Ranks.Reserve(Teams.Num());
+	for (TTuple<TArray<FOpenSkillRating>, int>& Team : Teams)
+	{
+		ProcessedTeams.Emplace(MoveTemp(Team.Key));
+		Ranks.Emplace(Team.Value);
+	}
+	return RateInternal(MoveTemp(ProcessedTeams), MoveTemp(Ranks), {});
+}
+
+TArray<TArray<FOpenSkillRating>> FOpenSkillUnrealModule::RateByScore(const TArray<TTuple<TArray<FOpenSkillRating>, int>>& Teams) const
+{
+	TArray<TArray<FOpenSkillRating>> ProcessedTeams;
+	TArray<int> InverseScores;
+	ProcessedTeams.Reserve(Teams.Num());
+	InverseScores.Reserve(Teams.Num());
+	for (const TTuple<TArray<FOpenSkillRating>, int>& Team : Teams)
+	{
+		ProcessedTeams.Emplace(Team.Key);
+		InverseScores.Emplace(-Team.Value);
+	}
+	return RateInternal(MoveTemp(ProcessedTeams), MoveTemp(InverseScores), {});
+}
+
+TArray<TArray<FOpenSkillRating>> FOpenSkillUnrealModule::RateByScore(TArray<TTuple<TArray<FOpenSkillRating>, int>>&& Teams) const
+{
+	TArray<TArray<FOpenSkillRating>> ProcessedTeams;
+	TArray<int> InverseScores;
+	ProcessedTeams.Reserve(Teams.Num());
+	InverseScores.Reserve(Teams.Num());
+	for (TTuple<TArray<FOpenSkillRating>, int>& Team : Teams)
+	{
+		ProcessedTeams.Emplace(MoveTemp(Team.Key));
+		InverseScores.Emplace(-Team.Value);
+	}
+	return RateInternal(MoveTemp(ProcessedTeams), MoveTemp(InverseScores), {});
+}
+
+void FOpenSkillUnrealModule::RateInPlace(TArrayView<const TArrayView<FOpenSkillRating>> Teams, TArrayView<const int> Ranks) const
+{
+	check(Teams.Num() == Ranks.Num())
+
+	// The models take nested arrays, so the one copy left is the rank ordered input they read from.
+	const TArray<int> Order = GetRankOrder(Ranks);
+	TArray<TArray<FOpenSkillRating>> OrderedTeams;
+	TArray<int> OrderedRanks;
+	OrderedTeams.Reserve(Teams.Num());
+	OrderedRanks.Reserve(Teams.Num());
+	for (const int Index : Order)
+	{
+		OrderedTeams.Emplace(Teams[Index].GetData(), Teams[Index].Num());
+		OrderedRanks.Add(Ranks[Index]);
+	}
+
+	const TArray<TArray<FOpenSkillRating>> NewRatings = RateOrdered(OrderedTeams, OrderedRanks, *GetCompiledOptions());
+	for (int i = 0; i < NewRatings.Num(); ++i)
+	{
+		const TArrayView<FOpenSkillRating>& Team = Teams[Order[i]];
+		for (int j = 0; j < Team.Num(); ++j)
+		{
+			Team[j] = NewRatings[i][j];
+		}
+	}
+}
+
+TArray<double> FOpenSkillUnrealModule::PredictWin(const TArray<TArray<FOpenSkillRating>>& Teams) const
+{
+	const FOpenSkillCompiledOptionsPin Snapshot = GetCompiledOptions();
+	if (!PredictionCache)
+	{
+		return PredictWinInternal(Teams, *Snapshot);
+	}
+
+	const FOpenSkillPredictionKey Key(EOpenSkillPrediction::Win, Teams, Snapshot->Options);
+	FOpenSkillCachedPrediction Prediction;
+	if (!PredictionCache->Find(Key, Prediction))
+	{
+		Prediction.Probabilities = PredictWinInternal(Teams, *Snapshot);
+		PredictionCache->Add(Key, Prediction);
+	}
+	return MoveTemp(Prediction.Probabilities);
+}
+
+double FOpenSkillUnrealModule::PredictDraw(const TArray<TArray<FOpenSkillRating>>& Teams) const
+{
+	const FOpenSkillCompiledOptionsPin Snapshot = GetCompiledOptions();
+	if (!PredictionCache)
+	{
+		return PredictDrawInternal(Teams, *Snapshot);
+	}
+
+	const FOpenSkillPredictionKey Key(EOpenSkillPrediction::Draw, Teams, Snapshot->Options);
+	FOpenSkillCachedPrediction Prediction;
+	if (!PredictionCache->Find(Key, Prediction))
+	{
+		Prediction.Probabilities.Add(PredictDrawInternal(Teams, *Snapshot));
+		PredictionCache->Add(Key, Prediction);
+	}
+	return Prediction.Probabilities[0];
+}
+
+TArray<TTuple<int, double>> FOpenSkillUnrealModule::PredictRank(const TArray<TArray<FOpenSkillRating>>& Teams) const
+{
+	const FOpenSkillCompiledOptionsPin Snapshot = GetCompiledOptions();
+	if (!PredictionCache)
+	{
+		return PredictRankInternal(Teams, *Snapshot);
+	}
+
+	const FOpenSkillPredictionKey Key(EOpenSkillPrediction::Rank, Teams, Snapshot->Options);
+	FOpenSkillCachedPrediction Prediction;
+	TArray<TTuple<int, double>> Result;
+	if (PredictionCache->Find(Key, Prediction))
+	{
+		Result.Reserve(Prediction.Ranks.Num());
+		for (int i = 0; i < Prediction.Ranks.Num(); ++i)
+		{
+			Result.Emplace(Prediction.Ranks[i], Prediction.Probabilities[i]);
+		}
+		return Result;
+	}
+
+	Result = PredictRankInternal(Teams, *Snapshot);
+	Prediction.Ranks.Reserve(Result.Num());
+	Prediction.Probabilities.Reserve(Result.Num());
+	for (const TTuple<int, double>& Rank : Result)
+	{
+		Prediction.Ranks.Add(Rank.Key);
+		Prediction.Probabilities.Add(Rank.Value);
+	}
+	PredictionCache->Add(Key, Prediction);
+	return Result;
+}
+
+TArray<double> FOpenSkillUnrealModule::PredictWinInternal(const TArray<TArray<FOpenSkillRating>>& Teams, const FOpenSkillCompiledOptions& Snapshot) const
+{
+	const TArray<FOpenSkillTeamRating> TeamRatings = FOpenSkillModeling::GetTeamRatings(Teams, {});
+	TArray<double> TeamMu;
+	TArray<double> TeamSigmaSq;
+	TeamMu.Reserve(TeamRatings.Num());
+	TeamSigmaSq.Reserve(TeamRatings.Num());
+	for (const FOpenSkillTeamRating& TeamRating : TeamRatings)
+	{
+		TeamMu.Add(TeamRating.Mu);
+		TeamSigmaSq.Add(TeamRating.SigmaSq);
+	}
+
+	TArray<double> Result;
+	Result.Reserve(Teams.Num());
+	for (int i = 0; i < TeamRatings.Num(); ++i)
+	{
+		Result.Emplace(FOpenSkillModeling::GetWinProbability(TeamMu, TeamSigmaSq, i, Snapshot.BetaSquared));
+	}
+	return Result;
+}
+
+
+double FOpenSkillUnrealModule::PredictDrawInternal(const TArray<TArray<FOpenSkillRating>>& Teams, const FOpenSkillCompiledOptions& Snapshot) const
+{
+	const double BetaSquared = Snapshot.BetaSquared;
+	const double N = Teams.Num();
+
+	if (N == 0)
+	{
+		return 0;
+	}
+	if (N == 1)
+	{
+		return 1;
+	}
+
+	const double Denom = (N * (N - 1)) / (N > 2 ? 1 : 2);
+	const TArray<FOpenSkillTeamRating> TeamRatings = FOpenSkillModeling::GetTeamRatings(Teams, {});
+
+	double PlayerCount = 0;
+	for (const TArray<FOpenSkillRating>& Players : Teams)
+	{
+		PlayerCount += Players.Num();
+	}
+
+	const double DrawMargin = FMath::Sqrt(PlayerCount) * Snapshot.GetDrawMarginScale(Teams.Num());
+
+	double Result = 0;
+
+	for (int i = 0; i < TeamRatings.Num(); ++i)
+	{
+		const FOpenSkillTeamRating& TeamI = TeamRatings[i];
+		for (int q = 0; q < TeamRatings.Num(); ++q)
+		{
+			if (i == q)
+			{
+				continue;
+			}
+			const FOpenSkillTeamRating& TeamQ = TeamRatings[q];
+			const double SigmaBar = FMath::Sqrt(N * BetaSquared + FMath::Square(TeamI.SigmaSq) + FMath::Square(TeamQ.SigmaSq));
+			Result += FOpenSkillStatistics::PhiMajor((DrawMargin - TeamI.Mu + TeamQ.Mu) / SigmaBar) - FOpenSkillStatistics::PhiMajor((TeamI.Mu - TeamQ.Mu - DrawMargin) / SigmaBar);
+		}
+	}
+	return FMath::Abs(Result) / Denom;
+}
+
+void FOpenSkillUnrealModule::PredictDrawBatch(const FOpenSkillLobbyBatch& Lobbies, TArrayView<const FOpenSkillRating> Ratings, TArrayView<double> OutQuality) const
+{
+	check(OutQuality.Num() == Lobbies.GetNumLobbies())
+	constexpr int32 ItemsPerTask = 256;
+
+	// Team sums first, once per team no matter how many lobbies use it.
+	const int32 NumTeams = Lobbies.GetNumTeams();
+	TArray<double> TeamMu;
+	TArray<double> TeamSigmaSq;
+	TeamMu.SetNumUninitialized(NumTeams);
+	TeamSigmaSq.SetNumUninitialized(NumTeams);
+	ParallelFor(FMath::DivideAndRoundUp(NumTeams, ItemsPerTask), [&](const int32 Task)
+	{
+		const int32 End = FMath::Min((Task + 1) * ItemsPerTask, NumTeams);
+		for (int32 Team = Task * ItemsPerTask; Team < End; ++Team)
+		{
+			double Mu = 0;
+			double SigmaSq = 0;
+			for (int32 i = Lobbies.TeamOffsets[Team]; i < Lobbies.TeamOffsets[Team + 1]; ++i)
+			{
+				const FOpenSkillRating& Rating = Ratings[Lobbies.TeamPlayers[i]];
+				Mu += Rating.Mu;
+				SigmaSq += FMath::Square(Rating.Sigma);
+			}
+			TeamMu[Team] = Mu;
+			TeamSigmaSq[Team] = SigmaSq;
+		}
+	});
+
+	const FOpenSkillCompiledOptionsPin Snapshot = GetCompiledOptions();
+	const double BetaSquared = Snapshot->BetaSquared;
+	ParallelFor(FMath::DivideAndRoundUp(Lobbies.GetNumLobbies(), ItemsPerTask), [&](const int32 Task)
+	{
+		const int32 End = FMath::Min((Task + 1) * ItemsPerTask, Lobbies.GetNumLobbies());
+		for (int32 Lobby = Task * ItemsPerTask; Lobby < End; ++Lobby)
+		{
+			const int32* Teams = Lobbies.LobbyTeams.GetData() + Lobbies.LobbyOffsets[Lobby];
+			const int32 N = Lobbies.LobbyOffsets[Lobby + 1] - Lobbies.LobbyOffsets[Lobby];
+			if (N < 2)
+			{
+				OutQuality[Lobby] = N;
+				continue;
+			}
+
+			// Same sum as PredictDraw, each unordered pair shares its SigmaBar.
+			int32 PlayerCount = 0;
+			for (int32 i = 0; i < N; ++i)
+			{
+				PlayerCount += Lobbies.TeamOffsets[Teams[i] + 1] - Lobbies.TeamOffsets[Teams[i]];
+			}
+			const double DrawMargin = FMath::Sqrt(static_cast<double>(PlayerCount)) * Snapshot->GetDrawMarginScale(N);
+			const double NBetaSquared = N * BetaSquared;
+			double Result = 0;
+			for (int32 i = 0; i < N; ++i)
+			{
+				const double MuI = TeamMu[Teams[i]];
+				const double SigmaSqI = TeamSigmaSq[Teams[i]];
+				for (int32 q = i + 1; q < N; ++q)
+				{
+					const double DeltaMu = MuI - TeamMu[Teams[q]];
+					const double SigmaBar = FMath::Sqrt(NBetaSquared + FMath::Square(SigmaSqI) + FMath::Square(TeamSigmaSq[Teams[q]]));
+					Result += FOpenSkillStatistics::PhiMajor((DrawMargin - DeltaMu) / SigmaBar) - FOpenSkillStatistics::PhiMajor((DeltaMu - DrawMargin) / SigmaBar);
+					Result += FOpenSkillStatistics::PhiMajor((DrawMargin + DeltaMu) / SigmaBar) - FOpenSkillStatistics::PhiMajor((-DeltaMu - DrawMargin) / SigmaBar);
+				}
+			}
+			const double Denom = (static_cast<double>(N) * (N - 1)) / (N > 2 ? 1 : 2);
+			OutQuality[Lobby] = FMath::Abs(Result) / Denom;
+		}
+	});
+}
+
+TArray<TTuple<int, double>> FOpenSkillUnrealModule::PredictRankInternal(const TArray<TArray<FOpenSkillRating>>& Teams, const FOpenSkillCompiledOptions& Snapshot) const
+{
+	if (Teams.Num() == 0)
+	{
+		return {};
+	}
+	if (Teams.Num() == 1)
+	{
+		return {TTuple<int, double>(1, 1.0)};
+	}
+
+	const double BetaSquared = Snapshot.BetaSquared;
+
+	double PlayerCount = 0;
+	for (const TArray<FOpenSkillRating>& Players : Teams)
+	{
+		PlayerCount += Players.Num();
+	}
+
+	const double N = Teams.Num();
+	const double Denom = (N * (N - 1)) / 2;
+	const double DrawMargin = FMath::Sqrt(PlayerCount) * Snapshot.GetDrawMarginScale(Teams.Num());
+
+	TArray<double> PairwiseProbabilities;
+	PairwiseProbabilities.Reserve(N * N - N);
+	for (int i = 0; i < Teams.Num(); ++i)
+	{
+		for (int j = 0; j < Teams.Num(); ++j)
+		{
+			if (i == j)
+			{
+				continue;
+			}
+			const FOpenSkillTeamRating TeamIRating = FOpenSkillModeling::GetTeamRating(Teams[i], 0);
+			const FOpenSkillTeamRating TeamJRating = FOpenSkillModeling::GetTeamRating(Teams[j], 0);
+			PairwiseProbabilities.Add(FOpenSkillStatistics::PhiMajor((TeamIRating.Mu - TeamJRating.Mu - DrawMargin) / FMath::Sqrt(N * BetaSquared + FMath::Square(TeamIRating.SigmaSq) + FMath::Square(TeamJRating.SigmaSq))));
+		}
+	}
+	TArray<double> WinProbability;
+	WinProbability.Reserve(PairwiseProbabilities.Num() / (N - 1));
+	for (int i = 0; i < PairwiseProbabilities.Num(); i += N - 1)
+	{
+		double TeamProb = 0;
+		for (int j = 0; j < N - 1; ++j)
+		{
+			TeamProb += PairwiseProbabilities[i + j];
+		}
+		WinProbability.Add(TeamProb / Denom);
+	}
+	for (int i = 0; i < WinProbability.Num(); ++i)
+	{
+		WinProbability[i] = FMath::Abs(WinProbability[i]);
+	}
+	TArray<int> Ranks = RankMinimum(WinProbability);
+	const int MaxOrdinal = FMath::Max(Ranks);
+	for (int i = 0; i < Ranks.Num(); ++i)
+	{
+		Ranks[i] = FMath::Abs(Ranks[i] - MaxOrdinal) + 1;
+	}
+	TArray<TTuple<int, double>> Results;
+	Results.Reserve(Teams.Num());
+
+	for (int i = 0; i < WinProbability.Num(); ++i)
+	{
+		Results.Emplace(Ranks[i], WinProbability[i]);
+	}
+
+	return Results;
+}
+
+FOpenSkillPlacementMatrix FOpenSkillUnrealModule::PredictPlacements(const TArray<TArray<FOpenSkillRating>>& Teams, const FOpenSkillPlacementConfig& Config) const
+{
+	const double BetaSquared = GetCompiledOptions()->BetaSquared;
+	TArray<double> Mu;
+	TArray<double> Variance;
+	Mu.Reserve(Teams.Num());
+	Variance.Reserve(Teams.Num());
+	for (const TArray<FOpenSkillRating>& Team : Teams)
+	{
+		const FOpenSkillTeamRating TeamRating = FOpenSkillModeling::GetTeamRating(Team, 0);
+		Mu.Add(TeamRating.Mu);
+		Variance.Add(TeamRating.SigmaSq + BetaSquared);
+	}
+	return FOpenSkillPlacement::Sample(Mu, Variance, Config);
+}
+
+double FOpenSkillUnrealModule::GetOrdinal(const FOpenSkillRating& Rating) const
+{
+	return Rating.Mu - GetCompiledOptions()->Options.Z * Rating.Sigma;
+}
+
+void FOpenSkillUnrealModule::GetOrdinals(TArrayView<const double> Mu, TArrayView<const double> Sigma, TArrayView<double> OutOrdinals) const
+{
+	FOpenSkillLeaderboard::ComputeOrdinals(Mu, Sigma, GetCompiledOptions()->Options.Z, OutOrdinals);
+}
+
+
+TArray<TArray<FOpenSkillRating>> FOpenSkillUnrealModule::RateInternal(TArray<TArray<FOpenSkillRating>>&& Teams, TArray<int>&& Ranks, TArray<int>&& Weights) const
+{
+	const TArray<int> Order = GetRankOrder(Ranks);
+	TArray<TArray<FOpenSkillRating>> OrderedTeams;
+	TArray<int> OrderedRanks;
+	OrderedTeams.Reserve(Teams.Num());
+	OrderedRanks.Reserve(Teams.Num());
+	for (const int Index : Order)
+	{
+		OrderedTeams.Emplace(MoveTemp(Teams[Index]));
+		OrderedRanks.Add(Ranks[Index]);
+	}
+
+	TArray<TArray<FOpenSkillRating>> NewRatings = RateOrdered(OrderedTeams, OrderedRanks, *GetCompiledOptions());
+
+	// The teams were moved out of Teams above, refill it in the caller's order and hand it back.
+	for (int i = 0; i < NewRatings.Num(); ++i)
+	{
+		Teams[Order[i]] = MoveTemp(NewRatings[i]);
+	}
+	return MoveTemp(Teams);
+}
+
+TArray<TArray<FOpenSkillRating>> FOpenSkillUnrealModule::RateOrdered(TArray<TArray<FOpenSkillRating>>& OrderedTeams, const TArray<int>& OrderedRanks, const FOpenSkillCompiledOptions& Snapshot) const
+{
+	const FOpenSkillOptions& Options = Snapshot.Options;
+	if (Options.Tau > 0)
+	{
+		const double TauSquared = Snapshot.TauSquared;
+		for (TArray<FOpenSkillRating>& Team : OrderedTeams)
+		{
+			for (FOpenSkillRating& Member : Team)
+			{
+				Member.Sigma = FMath::Sqrt(FMath::Square(Member.Sigma) + TauSquared);
+			}
+		}
+	}
+
+	TArray<TArray<FOpenSkillRating>> NewRatings = Options.Model(OrderedTeams, OrderedRanks, Snapshot);
+
+	if (Options.Tau > 0 && Options.PreventSigmaIncrease)
+	{
+		for (int i = 0; i < NewRatings.Num(); ++i)
+		{
+			TArray<FOpenSkillRating>& Team = NewRatings[i];
+			for (int j = 0; j < Team.Num(); ++j)
+			{
+				FOpenSkillRating& Rating = Team[j];
+				Rating.Sigma = FMath::Min(Rating.Sigma, OrderedTeams[i][j].Sigma);
+			}
+		}
+	}
+	return NewRatings;
+}
+
+TArray<int> FOpenSkillUnrealModule::GetRankOrder(TArrayView<const int> Ranks)
+{
+	TArray<int> Order;
+	Order.Reserve(Ranks.Num());
+	for (int i = 0; i < Ranks.Num(); ++i)
+	{
+		Order.Add(i);
+	}
+	Order.StableSort([&Ranks](const int Lhs, const int Rhs)
+	{
+		return Ranks[Lhs] < Ranks[Rhs];
+	});
+	return Order;
+}
+
+TArray<int> FOpenSkillUnrealModule::RankMinimum(const TArray<double>& A)
+{
+	const int N = A.Num();
+	TArray<double> SortedA;
+	TArray<int> Tenet;
+	FOpenSkillModeling::UnwindByValue(A, SortedA, Tenet);
+
+	double SumRanks = 0;
+	int DuplicateCount = 0;
+
+	TArray<int> Result;
+	Result.AddZeroed(N);
+
+	for (int i = 0; i < N; ++i)
+	{
+		SumRanks += i;
+		DuplicateCount++;
+		if (i == N - 1 || SortedA[i] != SortedA[i + 1])
+		{
+			for (int j = i - DuplicateCount + 1; j < i + 1; ++j)
+			{
+				Result[Tenet[j]] = i + 1 - DuplicateCount + 1;
+			}
+			SumRanks = 0;
+			DuplicateCount = 0;
+		}
+	}
+	return Result;
+}
+
+#undef LOCTEXT_NAMESPACE
+
+IMPLEMENT_MODULE(FOpenSkillUnrealModule, OpenSkillUnreal)
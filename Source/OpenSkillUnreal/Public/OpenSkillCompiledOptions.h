@@ -0,0 +1,81 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenSkillOptions.h"
+#include <atomic>
+
+/**
+ * FOpenSkillOptions frozen together with the constants the module derives from them. A snapshot is never modified
+ * after it is built, so a call that pins one sees the same options from start to finish however often they are swapped.
+ * The models take a snapshot rather than the raw options so none of them re-derives these per match.
+ */
+struct OPENSKILLUNREAL_API FOpenSkillCompiledOptions
+{
+	explicit FOpenSkillCompiledOptions(const FOpenSkillOptions& InOptions);
+
+	FOpenSkillOptions Options;
+	double BetaSquared;
+	double TwoBetaSquared;
+	double TauSquared;
+
+	/**
+	 * @brief The part of the draw margin that only depends on the number of teams, Beta * PhiMajorInverse((1 + 1 / N) / 2).
+	 * @param NumTeams Two or more teams.
+	 * @return The scale, multiplied by the square root of the player count to give the draw margin.
+	 */
+	double GetDrawMarginScale(const int32 NumTeams) const
+	{
+		return NumTeams < DrawMarginScales.Num() ? DrawMarginScales[NumTeams] : ComputeDrawMarginScale(NumTeams);
+	}
+
+private:
+	// Team counts below this are looked up instead of calling PhiMajorInverse.
+	static constexpr int32 NumPrecomputedDrawMargins = 128;
+
+	TArray<double> DrawMarginScales;
+
+	double ComputeDrawMarginScale(int32 NumTeams) const;
+};
+
+/**
+ * Keeps a published snapshot alive for as long as it is held, without a lock or a shared reference count.
+ *
+ * Pinning records the current reclamation epoch in a slot owned by the calling thread, then reads the published pointer.
+ * A replaced snapshot is retired with the epoch it was unpublished in and only freed once no thread holds a pin from that
+ * epoch or earlier, see Retire and CanReclaim. Pins nest, and must be released on the thread that took them.
+ */
+class OPENSKILLUNREAL_API FOpenSkillCompiledOptionsPin
+{
+public:
+	explicit FOpenSkillCompiledOptionsPin(const std::atomic<const FOpenSkillCompiledOptions*>& Published);
+	FOpenSkillCompiledOptionsPin(FOpenSkillCompiledOptionsPin&& Other);
+	~FOpenSkillCompiledOptionsPin();
+
+	FOpenSkillCompiledOptionsPin(const FOpenSkillCompiledOptionsPin&) = delete;
+	FOpenSkillCompiledOptionsPin& operator=(const FOpenSkillCompiledOptionsPin&) = delete;
+	FOpenSkillCompiledOptionsPin& operator=(FOpenSkillCompiledOptionsPin&&) = delete;
+
+	const FOpenSkillCompiledOptions& operator*() const
+	{
+		return *Snapshot;
+	}
+
+	const FOpenSkillCompiledOptions* operator->() const
+	{
+		return Snapshot;
+	}
+
+	/**
+	 * @brief Advance the epoch, called after a snapshot has been unpublished.
+	 * @return The epoch to retire the snapshot with, pins taken in it may still be reading the snapshot.
+	 */
+	static uint64 Retire();
+
+	/**
+	 * @return Whether every pin taken in RetiredEpoch or earlier has been released.
+	 */
+	static bool CanReclaim(uint64 RetiredEpoch);
+
+private:
+	const FOpenSkillCompiledOptions* Snapshot;
+};
@@ -0,0 +1,215 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenSkillTypes.h"
+
+class FOpenSkillUnrealModule;
+
+/**
+ * Ratings keyed by player ID. Players get a dense slot when first seen and their ratings are stored by slot, the ID
+ * index is an open addressing table of ID and slot pairs whose bucket for an ID can be computed, and prefetched,
+ * before it is probed.
+ */
+class OPENSKILLUNREAL_API FOpenSkillRatingTable
+{
+public:
+	/**
+	 * @param InDefaultRating The rating of players added without one.
+	 */
+	explicit FOpenSkillRatingTable(const FOpenSkillRating& InDefaultRating);
+
+	int32 Num() const
+	{
+		return Ratings.Num();
+	}
+
+	/**
+	 * @brief Make room for this many players in total, so adding them does not rehash the index or reallocate the table.
+	 */
+	void Reserve(const int32 NumPlayers);
+
+	/**
+	 * @return The player's slot, INDEX_NONE if the player has never been added.
+	 */
+	int32 Find(const FOpenSkillPlayerId Player) const;
+
+	/**
+	 * @return The player's slot, adding the player at the default rating if needed.
+	 */
+	int32 FindOrAdd(const FOpenSkillPlayerId Player);
+
+	/**
+	 * @brief FindOrAdd for many players, prefetching each player's bucket a few players ahead of probing it.
+	 * @param Players The players to look up.
+	 * @param OutSlots Receives one slot per player.
+	 */
+	void FindOrAddBatch(TArrayView<const FOpenSkillPlayerId> Players, TArrayView<int32> OutSlots);
+
+	FOpenSkillRating& GetRating(const int32 Slot)
+	{
+		return Ratings[Slot];
+	}
+
+	const FOpenSkillRating& GetRating(const int32 Slot) const
+	{
+		return Ratings[Slot];
+	}
+
+	FOpenSkillPlayerId GetPlayer(const int32 Slot) const
+	{
+		return Players[Slot];
+	}
+
+	TOptional<FOpenSkillRating> FindRating(const FOpenSkillPlayerId Player) const
+	{
+		const int32 Slot = Find(Player);
+		return Slot != INDEX_NONE ? TOptional<FOpenSkillRating>(Ratings[Slot]) : TOptional<FOpenSkillRating>();
+	}
+
+	void SetRating(const FOpenSkillPlayerId Player, const FOpenSkillRating& Rating)
+	{
+		Ratings[FindOrAdd(Player)] = Rating;
+	}
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return Buckets.GetAllocatedSize() + Ratings.GetAllocatedSize() + Players.GetAllocatedSize();
+	}
+
+private:
+	struct FBucket
+	{
+		FOpenSkillPlayerId Player;
+		// INDEX_NONE for an empty bucket.
+		int32 Slot;
+	};
+
+	FOpenSkillRating DefaultRating;
+	// A power of two, at most half full.
+	TArray<FBucket> Buckets;
+	int32 BucketShift = 64;
+	TArray<FOpenSkillRating> Ratings;
+	TArray<FOpenSkillPlayerId> Players;
+
+	uint32 GetBucketIndex(const FOpenSkillPlayerId Player) const
+	{
+		// Fibonacci hashing, so sequential IDs still spread evenly.
+		return static_cast<uint32>((Player * 0x9E3779B97F4A7C15ull) >> BucketShift);
+	}
+
+	// Grows only the index. Adding players lets Ratings and Players grow geometrically, an exact Reserve there would
+	// reallocate on every add.
+	void ReserveIndex(int32 NumPlayers);
+	// The index must already have room for one more player.
+	int32 FindOrAddInIndex(const FOpenSkillPlayerId Player);
+	void Rehash(int32 NumBuckets);
+};
+
+/**
+ * A window of match results keyed by player ID, stored flat like FOpenSkillLobbyBatch.
+ */
+struct OPENSKILLUNREAL_API FOpenSkillMatchWindow
+{
+	// Player IDs, team after team.
+	TArray<FOpenSkillPlayerId> TeamPlayers;
+	// One entry per team plus a terminator, where each team starts in TeamPlayers.
+	TArray<int32> TeamOffsets;
+	// One rank per team, lower values mean better placement.
+	TArray<int> TeamRanks;
+	// One entry per match plus a terminator, where each match's teams start.
+	TArray<int32> MatchOffsets;
+
+	FOpenSkillMatchWindow()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		TeamPlayers.Reset();
+		TeamOffsets.Reset();
+		TeamOffsets.Add(0);
+		TeamRanks.Reset();
+		MatchOffsets.Reset();
+		MatchOffsets.Add(0);
+	}
+
+	/**
+	 * @brief Add a match result.
+	 * @param Teams An array of team and rank tuples, see FOpenSkillUnrealModule::RateByRank. A player may only appear once per match.
+	 */
+	void AddMatch(const TArray<TTuple<TArray<FOpenSkillPlayerId>, int>>& Teams);
+
+	int32 GetNumMatches() const
+	{
+		return MatchOffsets.Num() - 1;
+	}
+
+	int32 GetNumTeams() const
+	{
+		return TeamOffsets.Num() - 1;
+	}
+};
+
+struct OPENSKILLUNREAL_API FOpenSkillIngestionStats
+{
+	int64 Windows = 0;
+	int64 Matches = 0;
+	// Player appearances, and the distinct players among them summed over windows.
+	int64 Appearances = 0;
+	int64 UniquePlayers = 0;
+	double ResolveSeconds = 0;
+	double GatherSeconds = 0;
+	double RateSeconds = 0;
+	double ScatterSeconds = 0;
+};
+
+/**
+ * Rates windows of ID-keyed match results against a FOpenSkillRatingTable without a random table access per player
+ * appearance. Each window is rated in four stages:
+ *
+ * Resolve: every player ID in the window is looked up in one batched pass with its bucket prefetched ahead of the
+ * probe, then the appearances are sorted by slot to find the distinct players.
+ * Gather: the distinct players' ratings are copied into a contiguous buffer, walking the table in slot order with
+ * software prefetch.
+ * Rate: the matches are rated in window order with RateInPlace against the buffer, so a player appearing in several
+ * matches sees their rating from the previous one.
+ * Scatter: the buffer is written back into the table in one pass in slot order.
+ *
+ * An instance keeps its buffers between windows and must only be used by one thread at a time.
+ */
+class OPENSKILLUNREAL_API FOpenSkillIngestion
+{
+public:
+	/**
+	 * @param InModule The module used to rate matches, it must outlive the ingestion.
+	 */
+	explicit FOpenSkillIngestion(const FOpenSkillUnrealModule& InModule);
+
+	/**
+	 * @brief Rate every match in a window, in order, and write the new ratings to the table.
+	 * @param Window The match results.
+	 * @param Table The ratings, players never seen before are added at the table's default rating.
+	 */
+	void RateWindow(const FOpenSkillMatchWindow& Window, FOpenSkillRatingTable& Table);
+
+	const FOpenSkillIngestionStats& GetStats() const
+	{
+		return Stats;
+	}
+
+private:
+	const FOpenSkillUnrealModule& Module;
+	FOpenSkillIngestionStats Stats;
+
+	// Every appearance's slot, and the same slots packed above the appearance index for sorting.
+	TArray<int32> AppearanceSlots;
+	TArray<uint64> SortKeys;
+	// The distinct players' slots in ascending order, the order the table is walked in, and where each appearance finds its player.
+	TArray<int32> UniqueSlots;
+	TArray<int32> AppearanceToUnique;
+	TArray<FOpenSkillRating> Buffer;
+	// One match at a time, team after team.
+	TArray<FOpenSkillRating> MatchRatings;
+	TArray<TArrayView<FOpenSkillRating>> MatchTeams;
+};
@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenSkillTypes.h"
+
+class FOpenSkillMatchHistory;
+class FOpenSkillUnrealModule;
+
+/**
+ * Keeps the ratings produced by replaying a match history and repairs them when matches are voided or restored.
+ *
+ * Every player appearance (slot) checkpoints the rating the player went into the match with and the one they came out
+ * with. Voiding a match turns it into a pass-through for its players, and only the matches reachable forwards from it
+ * through a player whose rating actually changed are rated again, in history order, starting from those checkpoints.
+ * Players outside that cone are never touched. Not thread-safe.
+ */
+class OPENSKILLUNREAL_API FOpenSkillInvalidation
+{
+public:
+	/**
+	 * @brief Rate the whole history once to fill the checkpoints.
+	 * @param InHistory The matches, it must outlive this object.
+	 * @param InModule Rates the matches and supplies the starting rating, it must outlive this object.
+	 * @param InTolerance A repaired rating whose Mu and Sigma both moved by no more than this does not carry the change
+	 *                    further. 0 repairs exactly, a small value stops the cone from spreading through the whole population.
+	 */
+	FOpenSkillInvalidation(const FOpenSkillMatchHistory& InHistory, const FOpenSkillUnrealModule& InModule, const double InTolerance = 0);
+
+	/**
+	 * @brief Void matches and fix every rating downstream of them.
+	 * @param Matches The matches to void, already voided ones are ignored.
+	 * @param OutAffectedPlayers Receives every player whose rating changed, in no particular order.
+	 * @return The number of matches visited, voided ones included.
+	 */
+	int32 VoidMatches(TArrayView<const int32> Matches, TArray<int32>& OutAffectedPlayers);
+
+	/**
+	 * @brief Undo VoidMatches, e.g. when a ban is overturned.
+	 */
+	int32 RestoreMatches(TArrayView<const int32> Matches, TArray<int32>& OutAffectedPlayers);
+
+	bool IsVoided(const int32 Match) const
+	{
+		return Voided[Match];
+	}
+
+	/**
+	 * @brief A player's rating after their last match, or the module's default rating if they never played.
+	 */
+	FOpenSkillRating GetRating(const int32 Player) const;
+
+	/**
+	 * @brief A player's rating right after one of their matches, see FOpenSkillMatchHistory::GetFirstSlot.
+	 */
+	const FOpenSkillRating& GetSlotRating(const int32 Slot) const
+	{
+		return Post[Slot];
+	}
+
+private:
+	const FOpenSkillMatchHistory& History;
+	const FOpenSkillUnrealModule& Module;
+	const double Tolerance;
+
+	TArray<bool> Voided;
+	// Per slot: the match, the same player's previous and next slot, the rating before and after the match.
+	TArray<int32> SlotMatches;
+	TArray<int32> PrevSlot;
+	TArray<int32> NextSlot;
+	TArray<FOpenSkillRating> Pre;
+	TArray<FOpenSkillRating> Post;
+	TArray<int32> LastSlot;
+
+	int32 SetVoided(TArrayView<const int32> Matches, const bool bVoided, TArray<int32>& OutAffectedPlayers);
+
+	// Refresh a match's checkpoints from its players' previous slots, OutChanged flags each slot whose result changed.
+	// Options is pinned once by the caller for the whole replay.
+	void RateMatch(const int32 Match, const FOpenSkillOptions& Options, TArray<bool>& OutChanged);
+};
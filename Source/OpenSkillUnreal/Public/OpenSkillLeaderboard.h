@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Bulk helpers for building leaderboards and tier assignments over a whole population.
+ * Ratings are passed as structure-of-arrays columns so they can be processed several players at a time.
+ */
+class OPENSKILLUNREAL_API FOpenSkillLeaderboard
+{
+public:
+	/**
+	 * @brief Compute `Mu - Z * Sigma` for every player.
+	 * @param Mu The Mu column.
+	 * @param Sigma The Sigma column, same length as Mu.
+	 * @param Z The number of standard deviations to subtract, usually FOpenSkillOptions::Z.
+	 * @param OutOrdinals Receives one ordinal per player, same length as Mu.
+	 */
+	static void ComputeOrdinals(TArrayView<const double> Mu, TArrayView<const double> Sigma, const double Z, TArrayView<double> OutOrdinals);
+
+	/**
+	 * @brief Sort players by ordinal, highest first, with a parallel radix sort.
+	 * @param Ordinals The ordinals to sort.
+	 * @param OutPermutation Receives the player indices in leaderboard order. Equal ordinals keep their index order.
+	 */
+	static void SortByOrdinal(TArrayView<const double> Ordinals, TArray<int32>& OutPermutation);
+
+	/**
+	 * @brief Assign percentile tiers (e.g. Bronze..Grandmaster) from a leaderboard order in a single pass.
+	 * @param Permutation Player indices in leaderboard order, as returned by SortByOrdinal.
+	 * @param TierPercentiles Ascending lower percentile bound of each tier in [0, 1), the first entry is normally 0.
+	 * @param OutTiers Receives the tier index of every player, indexed by player.
+	 */
+	static void AssignTiers(TArrayView<const int32> Permutation, TArrayView<const double> TierPercentiles, TArrayView<uint8> OutTiers);
+
+	/**
+	 * @brief Compute ordinals, leaderboard order and tiers for a whole population.
+	 * @param Mu The Mu column.
+	 * @param Sigma The Sigma column, same length as Mu.
+	 * @param Z The number of standard deviations to subtract, usually FOpenSkillOptions::Z.
+	 * @param TierPercentiles Ascending lower percentile bound of each tier, see AssignTiers.
+	 * @param OutOrdinals Receives one ordinal per player.
+	 * @param OutPermutation Receives the player indices in leaderboard order.
+	 * @param OutTiers Receives the tier index of every player.
+	 */
+	static void Build(TArrayView<const double> Mu, TArrayView<const double> Sigma, const double Z, TArrayView<const double> TierPercentiles,
+	                  TArray<double>& OutOrdinals, TArray<int32>& OutPermutation, TArray<uint8>& OutTiers);
+};
@@ -0,0 +1,112 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenSkillSimulation.h"
+
+class FOpenSkillUnrealModule;
+
+enum class EOpenSkillLoadTestOperation : uint8
+{
+	RateByRank,
+	RateByScore,
+	PredictWin,
+	PredictDraw,
+	PredictRank,
+	Count
+};
+
+/**
+ * A latency histogram in the spirit of HdrHistogram. Values are bucketed by their power of two and every power is split
+ * into 2^SubBucketBits linear steps, so any value from nanoseconds to hours is kept to within about 3% in a fixed 15KB.
+ */
+class OPENSKILLUNREAL_API FOpenSkillLatencyHistogram
+{
+public:
+	static constexpr int32 SubBucketBits = 5;
+
+	FOpenSkillLatencyHistogram();
+
+	void Record(uint64 Nanoseconds);
+	void Merge(const FOpenSkillLatencyHistogram& Other);
+
+	/**
+	 * @brief The value below which the given share of the recorded values fall.
+	 * @param Percentile From 0 to 100.
+	 * @return The upper end of the bucket holding that value in nanoseconds, never more than the largest value recorded.
+	 */
+	uint64 GetPercentile(double Percentile) const;
+
+	uint64 GetCount() const
+	{
+		return Count;
+	}
+
+	uint64 GetMax() const
+	{
+		return Max;
+	}
+
+	double GetMean() const
+	{
+		return Count > 0 ? static_cast<double>(Sum) / Count : 0;
+	}
+
+private:
+	static constexpr int32 SubBucketCount = 1 << SubBucketBits;
+	static constexpr int32 NumBuckets = SubBucketCount + (64 - SubBucketBits) * SubBucketCount;
+
+	TArray<uint64> Counts;
+	uint64 Count;
+	uint64 Sum;
+	uint64 Max;
+
+	static int32 GetBucket(uint64 Value);
+	static uint64 GetBucketUpperBound(int32 Bucket);
+};
+
+struct OPENSKILLUNREAL_API FOpenSkillLoadTestConfig
+{
+	// The shape of every match. Each thread rates its own table of PopulationSize players, NumMatches is not used.
+	FOpenSkillSimulationConfig Match = FOpenSkillSimulationConfig::FiveVersusFive();
+	int32 NumThreads = 32;
+	double DurationSeconds = 10;
+	// Requests per second across all threads. Each thread issues its share on a fixed schedule whether or not its earlier requests finished in time.
+	double RequestsPerSecond = 20000;
+	// Relative weight of each operation in the mix, indexed by EOpenSkillLoadTestOperation.
+	TStaticArray<double, static_cast<uint32>(EOpenSkillLoadTestOperation::Count)> Weights;
+
+	FOpenSkillLoadTestConfig();
+};
+
+struct OPENSKILLUNREAL_API FOpenSkillLoadTestReport
+{
+	double Seconds = 0;
+	uint64 Requests = 0;
+	double RequestsPerSecond = 0;
+	// Requests still waiting to be sent when the test ran out of time, non-zero means the module could not keep up with the rate.
+	uint64 MissedRequests = 0;
+	// Latencies are measured from the time a request was scheduled to go out, so a thread falling behind shows up as latency rather than as fewer requests.
+	TArray<FOpenSkillLatencyHistogram> Latencies;
+	FOpenSkillLatencyHistogram TotalLatency;
+};
+
+/**
+ * Drives the module from many threads at once with a fixed rate of mixed rating and prediction requests, the way game
+ * servers reporting results and matchmakers scoring lobbies would, and records the latency of every request.
+ */
+class OPENSKILLUNREAL_API FOpenSkillLoadTest
+{
+public:
+	/**
+	 * @brief Run a load test and block until it is over.
+	 * @param Module The module to call, used from all threads at once.
+	 * @param Config The workload.
+	 * @return Throughput and latency percentiles per operation.
+	 */
+	static FOpenSkillLoadTestReport Run(const FOpenSkillUnrealModule& Module, const FOpenSkillLoadTestConfig& Config);
+
+	static const TCHAR* GetOperationName(EOpenSkillLoadTestOperation Operation);
+
+	// Write a report to the log, one line per operation that was issued.
+	static void LogReport(const FOpenSkillLoadTestReport& Report);
+};
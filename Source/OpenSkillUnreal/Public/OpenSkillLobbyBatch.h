@@ -0,0 +1,73 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Candidate lobbies for FOpenSkillUnrealModule::PredictDrawBatch, stored flat. Teams are lists of indices into a
+ * rating table and lobbies are lists of team indices, so a team shared by many candidate lobbies is stored and
+ * aggregated once.
+ */
+struct OPENSKILLUNREAL_API FOpenSkillLobbyBatch
+{
+	// Indices into the rating table, team after team.
+	TArray<int32> TeamPlayers;
+	// One entry per team plus a terminator, where each team starts in TeamPlayers.
+	TArray<int32> TeamOffsets;
+	// Indices into the teams, lobby after lobby.
+	TArray<int32> LobbyTeams;
+	// One entry per lobby plus a terminator, where each lobby starts in LobbyTeams.
+	TArray<int32> LobbyOffsets;
+
+	FOpenSkillLobbyBatch()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		TeamPlayers.Reset();
+		TeamOffsets.Reset();
+		TeamOffsets.Add(0);
+		LobbyTeams.Reset();
+		LobbyOffsets.Reset();
+		LobbyOffsets.Add(0);
+	}
+
+	/**
+	 * @return The index of the new team, for AddLobby.
+	 */
+	int32 AddTeam(TArrayView<const int32> Players)
+	{
+		TeamPlayers.Append(Players.GetData(), Players.Num());
+		TeamOffsets.Add(TeamPlayers.Num());
+		return GetNumTeams() - 1;
+	}
+
+	/**
+	 * @return The index of the new lobby, its quality lands at this index.
+	 */
+	int32 AddLobby(TArrayView<const int32> Teams)
+	{
+		LobbyTeams.Append(Teams.GetData(), Teams.Num());
+		LobbyOffsets.Add(LobbyTeams.Num());
+		return GetNumLobbies() - 1;
+	}
+
+	int32 GetNumTeams() const
+	{
+		return TeamOffsets.Num() - 1;
+	}
+
+	int32 GetNumLobbies() const
+	{
+		return LobbyOffsets.Num() - 1;
+	}
+
+	/**
+	 * @brief Pick the highest quality lobbies.
+	 * @param Quality One value per lobby, as filled in by PredictDrawBatch.
+	 * @param Count The number of lobbies to pick.
+	 * @return Up to Count lobby indices, best first, ties going to the lower index.
+	 */
+	static TArray<int32> SelectBest(TArrayView<const double> Quality, const int32 Count);
+};
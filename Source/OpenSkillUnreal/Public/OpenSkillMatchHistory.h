@@ -0,0 +1,78 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * An append-only log of matches between players identified by dense indices. Everything is stored flat: one array of
+ * player indices, team offsets into it and match offsets into the teams, so replaying the log walks contiguous memory.
+ * Teams are stored sorted by rank, best first, the order the models expect them in.
+ */
+class OPENSKILLUNREAL_API FOpenSkillMatchHistory
+{
+public:
+	FOpenSkillMatchHistory();
+
+	/**
+	 * @brief Append a match.
+	 * @param Teams An array of team and rank tuples like FOpenSkillUnrealModule::RateByRank takes, with player indices in place of ratings.
+	 * @return The index of the new match.
+	 */
+	int32 AddMatch(const TArray<TTuple<TArray<int32>, int>>& Teams);
+
+	void Empty();
+
+	int32 Num() const
+	{
+		return MatchOffsets.Num() - 1;
+	}
+
+	// One more than the highest player index seen.
+	int32 GetNumPlayers() const
+	{
+		return NumPlayers;
+	}
+
+	int32 GetNumTeams(const int32 Match) const
+	{
+		return MatchOffsets[Match + 1] - MatchOffsets[Match];
+	}
+
+	// The players of a match's team, teams are numbered in rank order.
+	TArrayView<const int32> GetTeamPlayers(const int32 Match, const int32 Team) const
+	{
+		const int32 TeamIndex = MatchOffsets[Match] + Team;
+		return TArrayView<const int32>(Players.GetData() + TeamOffsets[TeamIndex], TeamOffsets[TeamIndex + 1] - TeamOffsets[TeamIndex]);
+	}
+
+	int GetTeamRank(const int32 Match, const int32 Team) const
+	{
+		return TeamRanks[MatchOffsets[Match] + Team];
+	}
+
+	// Every player of a match, team after team in rank order.
+	TArrayView<const int32> GetMatchPlayers(const int32 Match) const
+	{
+		const int32 First = TeamOffsets[MatchOffsets[Match]];
+		return TArrayView<const int32>(Players.GetData() + First, TeamOffsets[MatchOffsets[Match + 1]] - First);
+	}
+
+	// Slots number every player appearance, match after match in the order GetMatchPlayers lists them.
+	int32 GetNumSlots() const
+	{
+		return Players.Num();
+	}
+
+	int32 GetFirstSlot(const int32 Match) const
+	{
+		return TeamOffsets[MatchOffsets[Match]];
+	}
+
+private:
+	TArray<int32> Players;
+	// One entry per team plus a terminator, the start of the team's players.
+	TArray<int32> TeamOffsets;
+	TArray<int> TeamRanks;
+	// One entry per match plus a terminator, the match's first team.
+	TArray<int32> MatchOffsets;
+	int32 NumPlayers;
+};
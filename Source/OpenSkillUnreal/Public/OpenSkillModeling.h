@@ -1,117 +1,186 @@
-﻿#pragma once
-#include "Containers/Array.h"
-
-struct FOpenSkillRating;
-struct FOpenSkillTeamRating;
-struct FOpenSkillOptions;
-
-class OPENSKILLUNREAL_API FOpenSkillModeling
-{
-public:
-	// Models, reference these as part of the Options struct
-	static TArray<TArray<FOpenSkillRating>> PlackettLuce(const TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks, const FOpenSkillOptions& Options);
-	static TArray<TArray<FOpenSkillRating>> ThurstoneMostellerFull(const TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks, const FOpenSkillOptions& Options);
-	static TArray<TArray<FOpenSkillRating>> ThurstoneMostellerPartial(const TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks, const FOpenSkillOptions& Options);
-	static TArray<TArray<FOpenSkillRating>> BradleyTerryFull(const TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks, const FOpenSkillOptions& Options);
-	static TArray<TArray<FOpenSkillRating>> BradleyTerryPartial(const TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks, const FOpenSkillOptions& Options);
-
-	// The default Gamma function, provide a different function if necessary in the Options struct
-	static double DefaultGamma(const double C, const double K, const double Mu, const double SigmaSq, const TArray<FOpenSkillRating>& Team, const double Rank)
-	{
-		return FMath::Sqrt(SigmaSq) / C;
-	}
-
-	static double GetScore(double Q, double I);
-	static TArray<int> GetRankings(const TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks);
-	static FOpenSkillTeamRating GetTeamRating(const TArray<FOpenSkillRating>& Team, const int Rank);
-	static TArray<FOpenSkillTeamRating> GetTeamRatings(const TArray<TArray<FOpenSkillRating>>& Game, const TArray<int>& Ranks);
-
-	template <typename ElementType>
-	static TArray<TArray<ElementType>> GetLadderPairs(const TArray<ElementType>& Ranks);
-
-	static double GetC(const TArray<FOpenSkillTeamRating>& TeamRatings, const FOpenSkillOptions& Options);
-	static TArray<double> GetSumQ(const TArray<FOpenSkillTeamRating>& TeamRatings, double C);
-	static TArray<double> GetA(const TArray<FOpenSkillTeamRating>& TeamRatings);
-
-	template <typename ElementType>
-	static void Unwind(const TArray<int>& Ranks, const TArray<ElementType>& SourceArray, TArray<ElementType>& SortedArray, TArray<int>& Tenet);
-
-	template <typename ElementType>
-	static void UnwindByValue(const TArray<ElementType>& SourceArray, TArray<ElementType>& SortedArray, TArray<int>& Tenet);
-};
-
-template <typename ElementType>
-TArray<TArray<ElementType>> FOpenSkillModeling::GetLadderPairs(const TArray<ElementType>& Ranks)
-{
-	const int ZipSize = Ranks.Num() - 1;
-	if (ZipSize < 1)
-	{
-		return {{}};
-	}
-	TArray<TArray<ElementType>> Result;
-	for (int i = 0; i < Ranks.Num(); ++i)
-	{
-		int Left = i - 1;
-		int Right = i + 1;
-		if (i == 0)
-		{
-			Result.Add({Ranks[Right]});
-		}
-		else if (i == Ranks.Num() - 1)
-		{
-			Result.Add({Ranks[Left]});
-		}
-		else
-		{
-			Result.Add({Ranks[Left], Ranks[Right]});
-		}
-	}
-	return Result;
-}
-
-template <typename ElementType>
-void FOpenSkillModeling::Unwind(const TArray<int>& Ranks, const TArray<ElementType>& SourceArray, TArray<ElementType>& SortedArray, TArray<int>& Tenet)
-{
-	check(Ranks.Num() == SourceArray.Num())
-	TArray<TTuple<int, int, ElementType>> Zipped;
-	Zipped.Reserve(SourceArray.Num());
-
-	for (int i = 0; i < SourceArray.Num(); ++i)
-	{
-		Zipped.Emplace(Ranks[i], i, SourceArray[i]);
-	}
-	Zipped.Sort([](const TTuple<int, int, ElementType>& Lhs, const TTuple<int, int, ElementType>& Rhs)
-	{
-		return Lhs.template Get<0>() < Rhs.template Get<0>();
-	});
-	SortedArray.Empty(SourceArray.Num());
-	Tenet.Empty(Ranks.Num());
-	for (const auto& Item : Zipped)
-	{
-		Tenet.Add(Item.template Get<1>());
-		SortedArray.Add(Item.template Get<2>());
-	}
-}
-
-template <typename ElementType>
-void FOpenSkillModeling::UnwindByValue(const TArray<ElementType>& SourceArray, TArray<ElementType>& SortedArray, TArray<int>& Tenet)
-{
-	TArray<TTuple<int, ElementType>> Zipped;
-	Zipped.Reserve(SourceArray.Num());
-
-	for (int i = 0; i < SourceArray.Num(); ++i)
-	{
-		Zipped.Emplace(i, SourceArray[i]);
-	}
-	Zipped.Sort([](const TTuple<int, ElementType>& Lhs, const TTuple<int, ElementType>& Rhs)
-	{
-		return Lhs.template Get<1>() < Rhs.template Get<1>();
-	});
-	SortedArray.Empty(SourceArray.Num());
-	Tenet.Empty(SourceArray.Num());
-	for (const auto& Item : Zipped)
-	{
-		Tenet.Add(Item.template Get<0>());
-		SortedArray.Add(Item.template Get<1>());
-	}
-}
+﻿#pragma once
+#include "Containers/Array.h"
+#include "Async/ParallelFor.h"
+#include "OpenSkillTypes.h"
+
+struct FOpenSkillRating;
+struct FOpenSkillTeamRating;
+struct FOpenSkillOptions;
+struct FOpenSkillCompiledOptions;
+
+class OPENSKILLUNREAL_API FOpenSkillModeling
+{
+public:
+	// Models, reference these as part of the Options struct. They read Beta and Tau through the snapshot's precomputed squares.
+	static TArray<TArray<FOpenSkillRating>> PlackettLuce(const TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks, const FOpenSkillCompiledOptions& Snapshot);
+	static TArray<TArray<FOpenSkillRating>> ThurstoneMostellerFull(const TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks, const FOpenSkillCompiledOptions& Snapshot);
+	static TArray<TArray<FOpenSkillRating>> ThurstoneMostellerPartial(const TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks, const FOpenSkillCompiledOptions& Snapshot);
+	static TArray<TArray<FOpenSkillRating>> BradleyTerryFull(const TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks, const FOpenSkillCompiledOptions& Snapshot);
+	static TArray<TArray<FOpenSkillRating>> BradleyTerryPartial(const TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks, const FOpenSkillCompiledOptions& Snapshot);
+	static FOpenSkillModel GetModel(const EOpenSkillModel Model);
+	static const TCHAR* GetModelName(const EOpenSkillModel Model);
+
+	// The default Gamma function, provide a different function if necessary in the Options struct
+	static double DefaultGamma(const double C, const double K, const double Mu, const double SigmaSq, const TArray<FOpenSkillRating>& Team, const double Rank)
+	{
+		return FMath::Sqrt(SigmaSq) / C;
+	}
+
+	static double GetScore(double Q, double I);
+	static TArray<int> GetRankings(const TArray<TArray<FOpenSkillRating>>& Teams, const TArray<int>& Ranks);
+	static FOpenSkillTeamRating GetTeamRating(const TArray<FOpenSkillRating>& Team, const int Rank);
+	static TArray<FOpenSkillTeamRating> GetTeamRatings(const TArray<TArray<FOpenSkillRating>>& Game, const TArray<int>& Ranks);
+
+	template <typename ElementType>
+	static TArray<TArray<ElementType>> GetLadderPairs(const TArray<ElementType>& Ranks);
+
+	// The probability PredictWin gives one team from every team's Mu and SigmaSq sums, shared with the tuner so both always agree.
+	static double GetWinProbability(TArrayView<const double> TeamMu, TArrayView<const double> TeamSigmaSq, const int Team, const double BetaSquared);
+
+	static double GetC(const TArray<FOpenSkillTeamRating>& TeamRatings, const double BetaSquared);
+	static TArray<double> GetSumQ(const TArray<FOpenSkillTeamRating>& TeamRatings, double C);
+	static TArray<double> GetA(const TArray<FOpenSkillTeamRating>& TeamRatings);
+
+	// Per-pair terms shared by the models, written from team I's point of view. Team Q's terms are the same with the sign of V/Omega flipped.
+	static void ThurstoneMostellerPair(const double DeltaMu, const double Epsilon, const double RankI, const double RankQ, double& OutV, double& OutW);
+	static void BradleyTerryPair(const double MuI, const double MuQ, const double Ciq, const double RankI, const double RankQ, double& OutOmega, double& OutDelta);
+
+	/**
+	 * Visit every unordered team pair (i < q) once with its shared Ciq and sum the contributions into per-team Omega and Delta.
+	 * PairFunction(i, q, Ciq, OmegaI, DeltaI, OmegaQ, DeltaQ) adds its terms for both sides of the pair.
+	 * Large games are split into interleaved row blocks with their own accumulators so the pairs can be processed in parallel.
+	 */
+	template <typename PairFunctionType>
+	static void AccumulatePairwise(const TArray<FOpenSkillTeamRating>& TeamRatings, const double TwoBetaSq, const PairFunctionType& PairFunction, TArray<double>& OutOmega, TArray<double>& OutDelta);
+
+	// Spread a team level Omega/Delta update over the members in proportion to their share of the team variance.
+	static TArray<FOpenSkillRating> ApplyTeamUpdate(const FOpenSkillTeamRating& Team, const double Omega, const double Delta, const double Kappa);
+
+	template <typename ElementType>
+	static void Unwind(const TArray<int>& Ranks, const TArray<ElementType>& SourceArray, TArray<ElementType>& SortedArray, TArray<int>& Tenet);
+
+	template <typename ElementType>
+	static void UnwindByValue(const TArray<ElementType>& SourceArray, TArray<ElementType>& SortedArray, TArray<int>& Tenet);
+};
+
+template <typename ElementType>
+TArray<TArray<ElementType>> FOpenSkillModeling::GetLadderPairs(const TArray<ElementType>& Ranks)
+{
+	const int ZipSize = Ranks.Num() - 1;
+	if (ZipSize < 1)
+	{
+		return {{}};
+	}
+	TArray<TArray<ElementType>> Result;
+	for (int i = 0; i < Ranks.Num(); ++i)
+	{
+		int Left = i - 1;
+		int Right = i + 1;
+		if (i == 0)
+		{
+			Result.Add({Ranks[Right]});
+		}
+		else if (i == Ranks.Num() - 1)
+		{
+			Result.Add({Ranks[Left]});
+		}
+		else
+		{
+			Result.Add({Ranks[Left], Ranks[Right]});
+		}
+	}
+	return Result;
+}
+
+template <typename PairFunctionType>
+void FOpenSkillModeling::AccumulatePairwise(const TArray<FOpenSkillTeamRating>& TeamRatings, const double TwoBetaSq, const PairFunctionType& PairFunction, TArray<double>& OutOmega, TArray<double>& OutDelta)
+{
+	// Below this many teams a game is too small to be worth spreading over threads.
+	constexpr int MinTeamsForParallelPairs = 64;
+	constexpr int RowsPerBlock = 16;
+
+	const int N = TeamRatings.Num();
+	const int NumBlocks = N < MinTeamsForParallelPairs ? 1 : FMath::DivideAndRoundUp(N, RowsPerBlock);
+	OutOmega.SetNumZeroed(N);
+	OutDelta.SetNumZeroed(N);
+
+	TArray<double> BlockOmega;
+	TArray<double> BlockDelta;
+	if (NumBlocks > 1)
+	{
+		BlockOmega.SetNumZeroed(NumBlocks * N);
+		BlockDelta.SetNumZeroed(NumBlocks * N);
+	}
+
+	// Rows are dealt out round-robin, row i owns the N - 1 - i pairs to its right, so the blocks end up with similar amounts of work.
+	ParallelFor(NumBlocks, [&](const int Block)
+	{
+		double* Omega = NumBlocks > 1 ? BlockOmega.GetData() + Block * N : OutOmega.GetData();
+		double* Delta = NumBlocks > 1 ? BlockDelta.GetData() + Block * N : OutDelta.GetData();
+		for (int i = Block; i < N; i += NumBlocks)
+		{
+			const FOpenSkillTeamRating& TeamI = TeamRatings[i];
+			for (int q = i + 1; q < N; ++q)
+			{
+				const double Ciq = FMath::Sqrt(TeamI.SigmaSq + TeamRatings[q].SigmaSq + TwoBetaSq);
+				PairFunction(i, q, Ciq, Omega[i], Delta[i], Omega[q], Delta[q]);
+			}
+		}
+	}, NumBlocks == 1);
+
+	for (int Block = 0; Block < NumBlocks && NumBlocks > 1; ++Block)
+	{
+		for (int i = 0; i < N; ++i)
+		{
+			OutOmega[i] += BlockOmega[Block * N + i];
+			OutDelta[i] += BlockDelta[Block * N + i];
+		}
+	}
+}
+
+template <typename ElementType>
+void FOpenSkillModeling::Unwind(const TArray<int>& Ranks, const TArray<ElementType>& SourceArray, TArray<ElementType>& SortedArray, TArray<int>& Tenet)
+{
+	check(Ranks.Num() == SourceArray.Num())
+	TArray<TTuple<int, int, ElementType>> Zipped;
+	Zipped.Reserve(SourceArray.Num());
+
+	for (int i = 0; i < SourceArray.Num(); ++i)
+	{
+		Zipped.Emplace(Ranks[i], i, SourceArray[i]);
+	}
+	Zipped.Sort([](const TTuple<int, int, ElementType>& Lhs, const TTuple<int, int, ElementType>& Rhs)
+	{
+		return Lhs.template Get<0>() < Rhs.template Get<0>();
+	});
+	SortedArray.Empty(SourceArray.Num());
+	Tenet.Empty(Ranks.Num());
+	for (const auto& Item : Zipped)
+	{
+		Tenet.Add(Item.template Get<1>());
+		SortedArray.Add(Item.template Get<2>());
+	}
+}
+
+template <typename ElementType>
+void FOpenSkillModeling::UnwindByValue(const TArray<ElementType>& SourceArray, TArray<ElementType>& SortedArray, TArray<int>& Tenet)
+{
+	TArray<TTuple<int, ElementType>> Zipped;
+	Zipped.Reserve(SourceArray.Num());
+
+	for (int i = 0; i < SourceArray.Num(); ++i)
+	{
+		Zipped.Emplace(i, SourceArray[i]);
+	}
+	Zipped.Sort([](const TTuple<int, ElementType>& Lhs, const TTuple<int, ElementType>& Rhs)
+	{
+		return Lhs.template Get<1>() < Rhs.template Get<1>();
+	});
+	SortedArray.Empty(SourceArray.Num());
+	Tenet.Empty(SourceArray.Num());
+	for (const auto& Item : Zipped)
+	{
+		Tenet.Add(Item.template Get<0>());
+		SortedArray.Add(Item.template Get<1>());
+	}
+}
@@ -0,0 +1,121 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenSkillOptions.h"
+#include "OpenSkillTypes.h"
+
+/**
+ * Ratings in several game modes per player, e.g. solo, duo, squad and ranked, with how strongly a match in one mode
+ * moves each of the others. A player's modes sit side by side, padded to a whole number of vector lanes, so the
+ * update of every mode of a player is one pass over contiguous memory.
+ */
+class OPENSKILLUNREAL_API FOpenSkillMultiModeTable
+{
+public:
+	static constexpr int32 LaneWidth = 4;
+
+	/**
+	 * @param InNumModes The number of modes every player is rated in.
+	 * @param InDefaultRating The rating of new players in every mode.
+	 */
+	FOpenSkillMultiModeTable(const int32 InNumModes, const FOpenSkillRating& InDefaultRating);
+
+	/**
+	 * @brief Add players at the default rating in every mode.
+	 * @return The index of the first new player.
+	 */
+	int32 AddPlayers(const int32 Count);
+
+	int32 Num() const
+	{
+		return Mus.Num() / Stride;
+	}
+
+	int32 GetNumModes() const
+	{
+		return NumModes;
+	}
+
+	// NumModes rounded up to LaneWidth, the distance between two players' modes.
+	int32 GetStride() const
+	{
+		return Stride;
+	}
+
+	FOpenSkillRating GetRating(const int32 Player, const int32 Mode) const
+	{
+		return FOpenSkillRating(Mus[Player * Stride + Mode], Sigmas[Player * Stride + Mode]);
+	}
+
+	void SetRating(const int32 Player, const int32 Mode, const FOpenSkillRating& Rating)
+	{
+		Mus[Player * Stride + Mode] = Rating.Mu;
+		Sigmas[Player * Stride + Mode] = Rating.Sigma;
+	}
+
+	/**
+	 * @brief Set how far a match played in one mode moves another, as a share of a full update. Every mode starts at 1 for itself and 0 for the rest.
+	 * @param PrimaryMode The mode the match was played in.
+	 * @param Mode The mode to update.
+	 * @param Weight From 0, untouched, to 1, rated as if the match had been played in Mode.
+	 */
+	void SetWeight(const int32 PrimaryMode, const int32 Mode, const double Weight)
+	{
+		Weights[PrimaryMode * Stride + Mode] = Weight;
+	}
+
+	double GetWeight(const int32 PrimaryMode, const int32 Mode) const
+	{
+		return Weights[PrimaryMode * Stride + Mode];
+	}
+
+	// A player's Stride Mu values, then the matching Sigma values, padding lanes hold the default rating.
+	double* GetMuData(const int32 Player)
+	{
+		return Mus.GetData() + Player * Stride;
+	}
+
+	double* GetSigmaData(const int32 Player)
+	{
+		return Sigmas.GetData() + Player * Stride;
+	}
+
+	// The Stride weights of a match played in PrimaryMode, padding lanes are 0.
+	const double* GetWeightData(const int32 PrimaryMode) const
+	{
+		return Weights.GetData() + PrimaryMode * Stride;
+	}
+
+private:
+	int32 NumModes;
+	int32 Stride;
+	FOpenSkillRating DefaultRating;
+	TArray<double> Mus;
+	TArray<double> Sigmas;
+	TArray<double> Weights;
+};
+
+/**
+ * Rates a match in every mode of a FOpenSkillMultiModeTable at once. Each mode's update is the model's usual update
+ * with Omega, Delta and Tau scaled by the mode's weight, so the primary mode at weight 1 comes out the same as
+ * RateByRank with that model. The team sums, the model's team level math and the update of every member run with
+ * the modes as the innermost, contiguous loop, one pass for all modes instead of one rating call per mode.
+ *
+ * Options.Gamma and Options.Model are not used, the model is passed in and gamma is always DefaultGamma, as with
+ * FOpenSkillTwoTeam.
+ */
+class OPENSKILLUNREAL_API FOpenSkillMultiMode
+{
+public:
+	/**
+	 * @brief Rate a match in place.
+	 * @param Model The model to use.
+	 * @param Table The players' ratings, updated in place.
+	 * @param Teams The players of every team, as indices into Table. A player may only appear once per match.
+	 * @param Ranks One rank per team. Multiple teams may have the same rank, lower values mean better placement in the ranking.
+	 * @param PrimaryMode The mode the match was played in, the table's weights for it decide how much every mode moves.
+	 * @param Options Mu/Sigma defaults, Gamma and Model are unused, everything else applies as in RateByRank.
+	 */
+	static void Rate(const EOpenSkillModel Model, FOpenSkillMultiModeTable& Table, TArrayView<const TArrayView<const int32>> Teams, TArrayView<const int> Ranks,
+	                 const int32 PrimaryMode, const FOpenSkillOptions& Options);
+};
@@ -0,0 +1,62 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+struct OPENSKILLUNREAL_API FOpenSkillPlacementConfig
+{
+	// Sampling stops after this many simulated matches.
+	int64 MaxSamples = 1000000;
+	// Sampling stops early once every 95% interval is at most this wide either side of its estimate, 0 always runs MaxSamples.
+	double TargetError = 0;
+	// The same seed and sample count give the same matrix however many threads take part.
+	uint64 Seed = 0;
+};
+
+/**
+ * P(team i finishes in place k) for every team and place, estimated by sampling, with 95% Wilson score intervals.
+ */
+struct OPENSKILLUNREAL_API FOpenSkillPlacementMatrix
+{
+	int32 NumTeams = 0;
+	int64 NumSamples = 0;
+	// Row major, Team * NumTeams + Place, place 0 is first.
+	TArray<double> Probabilities;
+	TArray<double> LowerBounds;
+	TArray<double> UpperBounds;
+
+	double GetProbability(const int32 Team, const int32 Place) const
+	{
+		return Probabilities[Team * NumTeams + Place];
+	}
+
+	double GetLowerBound(const int32 Team, const int32 Place) const
+	{
+		return LowerBounds[Team * NumTeams + Place];
+	}
+
+	double GetUpperBound(const int32 Team, const int32 Place) const
+	{
+		return UpperBounds[Team * NumTeams + Place];
+	}
+
+	// The widest distance between an estimate and either end of its interval.
+	double GetMaxError() const;
+};
+
+/**
+ * Monte Carlo estimate of the full placement distribution of a match. Each sample draws every team's performance from
+ * N(Mu, Variance) and places the teams by it. Normals come from a counter-based Philox4x32-10 generator through
+ * Box-Muller in batches, keyed by sample index so chunks of samples can run on any thread in any order.
+ */
+class OPENSKILLUNREAL_API FOpenSkillPlacement
+{
+public:
+	/**
+	 * @brief Sample the placements of a match.
+	 * @param Mu The mean performance of every team.
+	 * @param Variance The performance variance of every team, same length as Mu.
+	 * @param Config Sample count, accuracy target and seed.
+	 * @return The placement matrix.
+	 */
+	static FOpenSkillPlacementMatrix Sample(TArrayView<const double> Mu, TArrayView<const double> Variance, const FOpenSkillPlacementConfig& Config);
+};
@@ -0,0 +1,98 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/LruCache.h"
+#include "OpenSkillTypes.h"
+#include <atomic>
+
+struct FOpenSkillOptions;
+
+enum class EOpenSkillPrediction : uint8
+{
+	Win,
+	Draw,
+	Rank
+};
+
+/**
+ * Identifies one prediction: its kind, the Beta it was made with and every player's Mu/Sigma, team by team.
+ * Keying on the rating values means an entry stops matching as soon as any member's rating changes.
+ */
+struct OPENSKILLUNREAL_API FOpenSkillPredictionKey
+{
+	FOpenSkillPredictionKey(const EOpenSkillPrediction InKind, const TArray<TArray<FOpenSkillRating>>& Teams, const FOpenSkillOptions& Options);
+
+	// Up to ten players, e.g. 5v5, are stored inline so building a key for a lookup never allocates.
+	static constexpr int32 InlinePlayers = 10;
+	static constexpr int32 InlineTeams = 4;
+
+	EOpenSkillPrediction Kind;
+	// Beta followed by Mu, Sigma of every player.
+	TArray<double, TInlineAllocator<1 + InlinePlayers * 2>> Values;
+	TArray<int32, TInlineAllocator<InlineTeams>> TeamSizes;
+	// Of Kind, TeamSizes and Values, checked before any value is compared.
+	uint64 Hash;
+
+	bool operator==(const FOpenSkillPredictionKey& Other) const
+	{
+		return Hash == Other.Hash && Kind == Other.Kind && TeamSizes == Other.TeamSizes && Values == Other.Values;
+	}
+
+	friend uint32 GetTypeHash(const FOpenSkillPredictionKey& Key)
+	{
+		return static_cast<uint32>(Key.Hash);
+	}
+};
+
+struct FOpenSkillCachedPrediction
+{
+	// Win: one probability per team. Draw: a single probability. Rank: one probability per team.
+	TArray<double> Probabilities;
+	// Rank only: one rank per team.
+	TArray<int> Ranks;
+};
+
+/**
+ * A bounded, thread-safe least recently used cache of Predict* results.
+ */
+class OPENSKILLUNREAL_API FOpenSkillPredictionCache
+{
+public:
+	explicit FOpenSkillPredictionCache(const int32 InMaxEntries);
+
+	/**
+	 * @brief Copy a cached prediction into OutPrediction and mark it as recently used.
+	 * @return False on a miss.
+	 */
+	bool Find(const FOpenSkillPredictionKey& Key, FOpenSkillCachedPrediction& OutPrediction);
+
+	void Add(const FOpenSkillPredictionKey& Key, const FOpenSkillCachedPrediction& Prediction);
+
+	void Empty();
+
+	int32 Num() const;
+
+	int32 GetMaxEntries() const
+	{
+		return MaxEntries;
+	}
+
+	uint64 GetHits() const
+	{
+		return Hits.load(std::memory_order_relaxed);
+	}
+
+	uint64 GetMisses() const
+	{
+		return Misses.load(std::memory_order_relaxed);
+	}
+
+	void ResetStats();
+
+private:
+	const int32 MaxEntries;
+	mutable FCriticalSection Lock;
+	TLruCache<FOpenSkillPredictionKey, FOpenSkillCachedPrediction> Entries;
+	std::atomic<uint64> Hits;
+	std::atomic<uint64> Misses;
+};
@@ -0,0 +1,144 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenSkillTypes.h"
+
+struct FOpenSkillRatingHistoryPoint
+{
+	int64 Time = 0;
+	FOpenSkillRating Rating;
+};
+
+// One chart bucket of a downsampled read.
+struct FOpenSkillRatingHistoryBucket
+{
+	int64 StartTime = 0;
+	int32 NumPoints = 0;
+	double MinMu = 0;
+	double MaxMu = 0;
+	// The rating at the end of the bucket, carried over from earlier buckets when this one has no points.
+	FOpenSkillRating Rating;
+};
+
+/**
+ * The rating history of one player, stored compressed for progression graphs. Ratings are quantized to a fixed
+ * resolution and points are packed into blocks of up to PointsPerBlock: the block header holds the first time plus
+ * the last point and min/max summaries, the block's bit stream starts with the first Mu/Sigma and time gap, then codes every
+ * further point as the timestamp delta-of-delta and the Mu/Sigma deltas, each with an adaptive Golomb-Rice code.
+ * Every block decodes on its own with one forward scan, so range reads only touch the blocks they overlap.
+ */
+class OPENSKILLUNREAL_API FOpenSkillRatingHistory
+{
+public:
+	static constexpr int32 PointsPerBlock = 256;
+
+	/**
+	 * @param InMuResolution Mu is stored rounded to a multiple of this.
+	 * @param InSigmaResolution Sigma is stored rounded to a multiple of this.
+	 */
+	explicit FOpenSkillRatingHistory(double InMuResolution = 0.01, double InSigmaResolution = 0.01);
+
+	/**
+	 * @brief Record a rating, timestamps are in whatever unit the caller picks and coarser units compress better.
+	 * @param Time Must not be earlier than the last appended point.
+	 * @param Rating The rating as of Time.
+	 */
+	void Append(int64 Time, const FOpenSkillRating& Rating);
+
+	/**
+	 * @brief Decode every point with Start <= Time < End, oldest first.
+	 * @param Start First time to include.
+	 * @param End First time to exclude.
+	 * @param OutPoints Cleared, then filled with the points.
+	 */
+	void GetRange(int64 Start, int64 End, TArray<FOpenSkillRatingHistoryPoint>& OutPoints) const;
+
+	/**
+	 * @brief Split [Start, End) into equal buckets and summarize each one, blocks that fall inside a single bucket are summarized from their headers without being decoded.
+	 * @param Start First time to include.
+	 * @param End First time to exclude.
+	 * @param NumBuckets How many buckets to split the range into.
+	 * @param OutBuckets Cleared, then filled with NumBuckets buckets.
+	 */
+	void GetDownsampled(int64 Start, int64 End, int32 NumBuckets, TArray<FOpenSkillRatingHistoryBucket>& OutBuckets) const;
+
+	/**
+	 * @brief Look up the rating a player had at a given time.
+	 * @param Time The time to look at.
+	 * @return The last point at or before Time, unset if the history starts later.
+	 */
+	TOptional<FOpenSkillRating> GetRatingAt(int64 Time) const;
+
+	void Empty();
+
+	// Release the slack left by appending, worth doing before a history goes idle.
+	void Shrink();
+
+	int32 Num() const
+	{
+		return NumPoints;
+	}
+
+	// Bytes held by the encoded points and block headers.
+	SIZE_T GetAllocatedSize() const
+	{
+		return Data.GetAllocatedSize() + Blocks.GetAllocatedSize();
+	}
+
+private:
+	// 40 bytes, the point count is implied since only the last block is ever partly filled.
+	struct FBlock
+	{
+		int64 FirstTime;
+		int64 LastTime;
+		int32 DataOffset;
+		// Quantized values.
+		int32 LastMu;
+		int32 LastSigma;
+		int32 MinMu;
+		int32 MaxMu;
+		// Rice parameters the block's codes start from, carried over from the end of the previous block.
+		uint8 TimeK;
+		uint8 MuK;
+		uint8 SigmaK;
+	};
+
+	// Running mean of the values coded so far, which sets the Rice parameter of the next one.
+	struct FRiceState
+	{
+		uint64 Sum = 0;
+		uint32 Count = 0;
+	};
+
+	double MuResolution;
+	double SigmaResolution;
+	TArray<uint8> Data;
+	TArray<FBlock> Blocks;
+	int32 NumPoints;
+	// Encoder state of the last block, mirrored by DecodeBlock.
+	FRiceState TimeState;
+	FRiceState MuState;
+	FRiceState SigmaState;
+	// The gap the next delta-of-delta is taken against, only moved by gaps that were not escaped so a one-off break
+	// between sessions does not cost a second escape on the way back.
+	int64 ReferenceTimeDelta;
+	// Bits of the last byte of Data not written yet.
+	int32 NumFreeBits;
+
+	int32 GetBlockNumPoints(const int32 BlockIndex) const
+	{
+		return BlockIndex < Blocks.Num() - 1 ? PointsPerBlock : NumPoints - BlockIndex * PointsPerBlock;
+	}
+
+	// Index of the first block that ends at or after Time, Blocks.Num() if none do.
+	int32 FindFirstBlock(int64 Time) const;
+
+	// Decode a whole block, calling Visitor(Time, QuantizedMu, QuantizedSigma) for each point in order.
+	template <typename VisitorType>
+	void DecodeBlock(int32 BlockIndex, const VisitorType& Visitor) const;
+
+	FOpenSkillRating Dequantize(int32 Mu, int32 Sigma) const
+	{
+		return FOpenSkillRating(Mu * MuResolution, Sigma * SigmaResolution);
+	}
+};
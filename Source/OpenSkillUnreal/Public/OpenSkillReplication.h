@@ -0,0 +1,214 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenSkillTypes.h"
+#include "Containers/Queue.h"
+#include "Misc/ScopeRWLock.h"
+
+class FEvent;
+class FOpenSkillReplicationTransport;
+
+/**
+ * Rating replication stream.
+ *
+ * The stream is a sequence of frames: a type byte, the varint payload size, then the payload. Every frame carries a
+ * sequence number and a list of (player ID, version, Mu, Sigma) entries sorted by player ID, with the IDs delta encoded
+ * and IDs, versions and counts as varints. A delta frame holds one commit's changed ratings and advances the sequence by
+ * one, a snapshot frame holds the whole table as of its sequence number.
+ */
+class OPENSKILLUNREAL_API FOpenSkillReplicationPublisher
+{
+public:
+	/**
+	 * Receives every encoded frame, in sequence order, on the publisher's transport thread and never under its lock, so it
+	 * may block. Return false if the frame could not be sent whole: the stream is then treated as broken, the frames queued
+	 * behind it are dropped and the next frame sent is a snapshot.
+	 */
+	typedef TFunction<bool(TArrayView<const uint8> Frame)> FOnFrame;
+
+	explicit FOpenSkillReplicationPublisher(FOnFrame InOnFrame);
+
+	/** Sends whatever is still queued, so the receiving end must keep draining until it returns. */
+	~FOpenSkillReplicationPublisher();
+
+	FOpenSkillReplicationPublisher(const FOpenSkillReplicationPublisher&) = delete;
+	FOpenSkillReplicationPublisher& operator=(const FOpenSkillReplicationPublisher&) = delete;
+
+	/**
+	 * @brief Commit new ratings to the authoritative table and queue them as one delta frame. Safe to call from any thread,
+	 * matches FOpenSkillShardedStore::FOnRatingsCommitted so it can be hooked straight into a store.
+	 * @param Players The players whose ratings changed.
+	 * @param Ratings Their new ratings, same length as Players.
+	 */
+	void Publish(TArrayView<const FOpenSkillPlayerId> Players, TArrayView<const FOpenSkillRating> Ratings);
+
+	/**
+	 * @brief Publish every rating of a match, e.g. from RateByRank's result.
+	 */
+	void PublishMatch(const TArray<TArray<FOpenSkillPlayerId>>& Players, const TArray<TArray<FOpenSkillRating>>& Ratings);
+
+	/**
+	 * @brief Queue a snapshot frame in line with the deltas, e.g. when a replica asks for a resync.
+	 */
+	void PublishSnapshot();
+
+	/**
+	 * @brief Encode a snapshot frame without emitting it, for replicas that resync out of band.
+	 */
+	TArray<uint8> MakeSnapshot() const;
+
+	/**
+	 * @brief Block until every queued frame has been handed to OnFrame.
+	 * @param WaitMs How long to wait at most.
+	 * @return False if the queue was still not empty after WaitMs.
+	 */
+	bool Flush(const uint32 WaitMs = MAX_uint32);
+
+	uint64 GetSequence() const;
+
+	// Bytes of frames queued for OnFrame so far.
+	uint64 GetBytesPublished() const;
+
+	// The number of frames OnFrame failed to send.
+	int32 GetNumBrokenStreams() const;
+
+private:
+	friend class FOpenSkillReplicationTransport;
+
+	struct FEntry
+	{
+		FOpenSkillRating Rating = FOpenSkillRating(0, 0);
+		uint64 Version = 0;
+	};
+
+	FOnFrame OnFrame;
+	mutable FCriticalSection Lock;
+	TMap<FOpenSkillPlayerId, FEntry> Entries;
+	uint64 Sequence = 0;
+	uint64 BytesPublished = 0;
+
+	// Encoded frames waiting for the transport thread. Only enqueued under Lock, so the queue order is the sequence order.
+	TQueue<TArray<uint8>, EQueueMode::Spsc> Outbound;
+
+	// Frames queued but not yet handed to OnFrame. IdleEvent is manual reset and triggered exactly while NumQueued is 0,
+	// both only change under Lock.
+	int32 NumQueued = 0;
+	FEvent* IdleEvent;
+
+	// Set when OnFrame failed, the next frame queued is then a snapshot.
+	bool bStreamBroken = false;
+	int32 NumBrokenStreams = 0;
+
+	TUniquePtr<FOpenSkillReplicationTransport> Transport;
+
+	TArray<uint8> EncodeSnapshot() const;
+	void QueueFrame(TArray<uint8>&& Frame);
+	void SendQueued();
+};
+
+/**
+ * A read replica of a publisher's table, fed with the raw bytes of its stream in order. A missing sequence number
+ * or a corrupt frame marks the replica out of sync and asks for a snapshot, the deltas that arrive meanwhile are
+ * kept and applied on top of it. Byte integrity is left to the transport (pipes, TCP), frames are only checked for
+ * being well formed. Ratings can be read from any thread while the stream is being received.
+ */
+class OPENSKILLUNREAL_API FOpenSkillReplica
+{
+public:
+	/** Called on the receiving thread when the replica needs a snapshot, with the last sequence number it applied. */
+	typedef TFunction<void(uint64 Sequence)> FOnSnapshotNeeded;
+
+	explicit FOpenSkillReplica(FOnSnapshotNeeded InOnSnapshotNeeded = nullptr);
+
+	/**
+	 * @brief Feed the next bytes of the stream, frames may be split across calls at any byte. Call from one thread at a time.
+	 * @return False if the stream was corrupt, the buffered bytes are dropped and a snapshot is requested.
+	 */
+	bool Receive(TArrayView<const uint8> Bytes);
+
+	/**
+	 * @brief Drop a partly received frame once the transport has been re-established after a failed write, the stream
+	 * then restarts at the publisher's next frame, which is a snapshot.
+	 */
+	void Reconnect();
+
+	TOptional<FOpenSkillRating> FindRating(const FOpenSkillPlayerId Player) const;
+
+	int32 Num() const;
+
+	// The sequence number of the last applied frame.
+	uint64 GetSequence() const;
+
+	bool IsSynchronized() const;
+
+	// The number of times the replica fell out of sync.
+	int32 GetNumResyncs() const;
+
+private:
+	struct FEntry
+	{
+		FOpenSkillRating Rating = FOpenSkillRating(0, 0);
+		uint64 Version = 0;
+	};
+
+	FOnSnapshotNeeded OnSnapshotNeeded;
+
+	// Guards the table and the sync state, the receive buffers are only touched by the receiving thread.
+	mutable FRWLock Lock;
+	TMap<FOpenSkillPlayerId, FEntry> Entries;
+	uint64 Sequence = 0;
+	bool bSynchronized = true;
+	int32 NumResyncs = 0;
+
+	TArray<uint8> Buffer;
+	// Delta payloads received while waiting for a snapshot.
+	TArray<TArray<uint8>> Pending;
+
+	bool HandleDelta(TArray<uint8>&& Payload);
+	bool HandleSnapshot(const TArray<uint8>& Payload);
+	void RequestSnapshot();
+};
+
+/**
+ * An anonymous pipe carrying a replication stream, for replicas in the same process or a child process.
+ */
+class OPENSKILLUNREAL_API FOpenSkillReplicationPipe
+{
+public:
+	FOpenSkillReplicationPipe();
+	~FOpenSkillReplicationPipe();
+
+	FOpenSkillReplicationPipe(const FOpenSkillReplicationPipe&) = delete;
+	FOpenSkillReplicationPipe& operator=(const FOpenSkillReplicationPipe&) = delete;
+
+	bool IsValid() const
+	{
+		return ReadPipe != nullptr && WritePipe != nullptr;
+	}
+
+	/**
+	 * @brief Write a whole frame, e.g. from a publisher's OnFrame.
+	 * @return False if the pipe stopped accepting data.
+	 */
+	bool Write(TArrayView<const uint8> Frame);
+
+	/**
+	 * @brief Forward every byte waiting in the pipe to the replica without blocking.
+	 * @return The number of bytes forwarded.
+	 */
+	int32 Pump(FOpenSkillReplica& Replica);
+
+	void* GetReadPipe() const
+	{
+		return ReadPipe;
+	}
+
+	void* GetWritePipe() const
+	{
+		return WritePipe;
+	}
+
+private:
+	void* ReadPipe = nullptr;
+	void* WritePipe = nullptr;
+};
@@ -0,0 +1,93 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenSkillTypes.h"
+#include <atomic>
+
+class FOpenSkillUnrealModule;
+class FOpenSkillStoreShard;
+class FEvent;
+
+/**
+ * A rating table partitioned by player ID hash into shards, each owned and written by exactly one worker thread.
+ *
+ * Matches are applied with a two-phase protocol: every shard holding one of the players gathers that player's current
+ * rating, the last shard to finish rates the match, then every involved shard applies the new ratings. Submissions are
+ * sequenced so all shards see matches in the same order, a player gathered by a match still in flight is held back
+ * until that match has been applied, so concurrent matches never lose an update and no per-player locks are needed.
+ */
+class OPENSKILLUNREAL_API FOpenSkillShardedStore
+{
+public:
+	/** Called on a shard thread once a match has been applied. Players and ratings are in the order the teams were submitted. */
+	typedef TFunction<void(const TArray<TArray<FOpenSkillPlayerId>>& Players, const TArray<TArray<FOpenSkillRating>>& Ratings)> FOnMatchApplied;
+
+	/** Called on a shard thread with ratings that shard just wrote. A player's writes are always reported in the order they happened. */
+	typedef TFunction<void(TArrayView<const FOpenSkillPlayerId> Players, TArrayView<const FOpenSkillRating> Ratings)> FOnRatingsCommitted;
+
+	/**
+	 * @param InModule The module used to rate matches, it must outlive the store.
+	 * @param NumShards The number of shards and worker threads.
+	 */
+	FOpenSkillShardedStore(const FOpenSkillUnrealModule& InModule, const int32 NumShards);
+	~FOpenSkillShardedStore();
+
+	FOpenSkillShardedStore(const FOpenSkillShardedStore&) = delete;
+	FOpenSkillShardedStore& operator=(const FOpenSkillShardedStore&) = delete;
+
+	/**
+	 * @brief Queue an overwrite of a player's rating, e.g. when loading the table. Players never set start at the module's default rating.
+	 */
+	void SetRating(const FOpenSkillPlayerId Player, const FOpenSkillRating& Rating);
+
+	/**
+	 * @brief Observe every rating write, e.g. to feed FOpenSkillReplicationPublisher::Publish. Set it before queuing any work.
+	 */
+	void SetOnRatingsCommitted(FOnRatingsCommitted InOnRatingsCommitted)
+	{
+		OnRatingsCommitted = MoveTemp(InOnRatingsCommitted);
+	}
+
+	/**
+	 * @brief Queue a match for rating. Safe to call from any thread.
+	 * @param Teams An array of team and rank tuples, see FOpenSkillUnrealModule::RateByRank. A player may only appear once per match.
+	 * @param OnApplied Optional callback once the new ratings have been written. A match without players is applied at once, on the calling thread.
+	 */
+	void SubmitMatch(const TArray<TTuple<TArray<FOpenSkillPlayerId>, int>>& Teams, FOnMatchApplied OnApplied = nullptr);
+
+	/**
+	 * @brief Block until every queued rating and match has been applied.
+	 */
+	void Flush();
+
+	/**
+	 * @brief Read a player's rating. Only valid while no work is in flight, i.e. after Flush and before the next submission.
+	 */
+	TOptional<FOpenSkillRating> FindRating(const FOpenSkillPlayerId Player) const;
+
+	int32 GetNumShards() const
+	{
+		return Shards.Num();
+	}
+
+	int32 GetShardIndex(const FOpenSkillPlayerId Player) const;
+
+private:
+	friend class FOpenSkillStoreShard;
+
+	const FOpenSkillUnrealModule& Module;
+	TArray<TUniquePtr<FOpenSkillStoreShard>> Shards;
+	FOnRatingsCommitted OnRatingsCommitted;
+
+	// Serializes enqueueing so every shard sees submissions in the same global order.
+	FCriticalSection SubmitLock;
+
+	// Work submitted but not yet applied. IdleEvent is manual reset and triggered exactly while InFlight is 0, both
+	// only change under IdleLock.
+	FCriticalSection IdleLock;
+	int32 InFlight;
+	FEvent* IdleEvent;
+
+	void AddWork();
+	void CompleteWork();
+};
@@ -0,0 +1,97 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenSkillMatchHistory.h"
+
+class FOpenSkillUnrealModule;
+
+/**
+ * Describes a synthetic population and the matches played by it.
+ */
+struct OPENSKILLUNREAL_API FOpenSkillSimulationConfig
+{
+	// Everything generated by the simulation is derived from this seed.
+	int32 Seed = 1;
+	int32 PopulationSize = 10000;
+	int32 NumMatches = 50000;
+	int32 NumTeams = 2;
+	int32 TeamSize = 1;
+	// Hidden true skills are drawn from N(SkillMean, SkillDeviation^2).
+	double SkillMean = 25.0;
+	double SkillDeviation = 8.0;
+	// Per-player, per-match performance noise around the true skill.
+	double PerformanceDeviation = 4.0;
+
+	static FOpenSkillSimulationConfig Duel();
+	static FOpenSkillSimulationConfig FiveVersusFive();
+	static FOpenSkillSimulationConfig Squads();
+	static FOpenSkillSimulationConfig FreeForAll();
+
+	/**
+	 * @brief Look up one of the preset match formats by name.
+	 * @param Name One of "1v1", "5v5", "Squads" or "FFA".
+	 * @param OutConfig Receives the preset.
+	 * @return False if the name is unknown.
+	 */
+	static bool FromName(const FString& Name, FOpenSkillSimulationConfig& OutConfig);
+};
+
+struct OPENSKILLUNREAL_API FOpenSkillSimulationReport
+{
+	int32 Matches = 0;
+	// Time spent inside the rating calls only.
+	double Seconds = 0;
+	double MatchesPerSecond = 0;
+	// Mean negative log of the probability PredictWin gave the actual winner, before the match was rated.
+	double LogLoss = 0;
+	// Spearman correlation between the final ordinals and the hidden true skills.
+	double RankCorrelation = 0;
+};
+
+/**
+ * Generates a population with hidden true skills and a deterministic stream of matches between them,
+ * then replays the matches through a module to measure speed and prediction accuracy.
+ */
+class OPENSKILLUNREAL_API FOpenSkillSimulation
+{
+public:
+	explicit FOpenSkillSimulation(const FOpenSkillSimulationConfig& InConfig);
+
+	/**
+	 * @brief Rate every generated match through the module, starting from its default ratings.
+	 * @param Module The module to rate with, its options decide the model.
+	 * @return Throughput and accuracy of the run.
+	 */
+	FOpenSkillSimulationReport Run(const FOpenSkillUnrealModule& Module) const;
+
+	const FOpenSkillSimulationConfig& GetConfig() const
+	{
+		return Config;
+	}
+
+	const TArray<double>& GetTrueSkills() const
+	{
+		return TrueSkills;
+	}
+
+	/**
+	 * @brief The players of a generated match, team by team in finishing order (the winners first).
+	 */
+	TArrayView<const int32> GetMatchPlayers(const int32 Match) const;
+
+	/**
+	 * @brief The generated matches as a match history, with the population's indices as player indices.
+	 */
+	FOpenSkillMatchHistory GetHistory() const;
+
+	/**
+	 * @brief Spearman rank correlation of two equally sized columns, ties get their average rank.
+	 */
+	static double RankCorrelation(TArrayView<const double> A, TArrayView<const double> B);
+
+private:
+	FOpenSkillSimulationConfig Config;
+	TArray<double> TrueSkills;
+	// NumMatches * NumTeams * TeamSize player indices.
+	TArray<int32> MatchPlayers;
+};
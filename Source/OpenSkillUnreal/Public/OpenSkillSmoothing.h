@@ -0,0 +1,116 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenSkillCompiledOptions.h"
+
+class FOpenSkillMatchHistory;
+
+// A Gaussian in natural parameters, so messages multiply and divide by adding and subtracting.
+struct FOpenSkillGaussianMessage
+{
+	// 1 / Sigma^2, 0 for the uniform message.
+	double Pi = 0;
+	// Mu / Sigma^2.
+	double Tau = 0;
+
+	static FOpenSkillGaussianMessage FromRating(const FOpenSkillRating& Rating)
+	{
+		const double InvVariance = 1 / FMath::Square(Rating.Sigma);
+		return {InvVariance, Rating.Mu * InvVariance};
+	}
+
+	FOpenSkillRating ToRating() const
+	{
+		return FOpenSkillRating(Tau / Pi, FMath::Sqrt(1 / Pi));
+	}
+
+	FOpenSkillGaussianMessage operator*(const FOpenSkillGaussianMessage& Other) const
+	{
+		return {Pi + Other.Pi, Tau + Other.Tau};
+	}
+
+	FOpenSkillGaussianMessage operator/(const FOpenSkillGaussianMessage& Other) const
+	{
+		return {Pi - Other.Pi, Tau - Other.Tau};
+	}
+};
+
+/**
+ * Smooths ratings over a whole match history, so early ratings also benefit from later evidence.
+ *
+ * Every player appearance (slot) carries three messages: the forward message from the player's past, the backward
+ * message from their future and the likelihood of the match itself, with Options.Tau of drift between consecutive
+ * matches. A match's likelihood is refreshed by running the model on each player's cavity, the forward times backward
+ * message, and dividing the model's posterior by it. Sweeps alternate forwards and backwards in time until no posterior
+ * moves by more than the tolerance; the first forward sweep reproduces rating the history online.
+ *
+ * The player/time graph is kept flat: per-slot links to the same player's previous and next slot, and a per-player
+ * slot list. Matches are grouped into levels, one past the highest level of any of their players' previous matches,
+ * so the matches of a level never share a player and are updated in parallel.
+ */
+class OPENSKILLUNREAL_API FOpenSkillSmoothing
+{
+public:
+	/**
+	 * @param InHistory The matches to smooth, it must outlive the smoother.
+	 * @param InOptions Mu/Sigma are every player's prior, Tau the drift between matches and Model the update. PreventSigmaIncrease is ignored.
+	 */
+	FOpenSkillSmoothing(const FOpenSkillMatchHistory& InHistory, const FOpenSkillOptions& InOptions);
+
+	/**
+	 * @brief Run forward/backward sweeps until converged.
+	 * @param MaxIterations The most forward/backward sweep pairs to run.
+	 * @param Tolerance Stop once no posterior Mu moved by more than this during a sweep pair.
+	 * @return The number of sweep pairs run.
+	 */
+	int32 Run(const int32 MaxIterations = 30, const double Tolerance = 1e-3);
+
+	/**
+	 * @brief A player's smoothed rating at one of their matches.
+	 * @param Slot See FOpenSkillMatchHistory::GetFirstSlot.
+	 */
+	FOpenSkillRating GetSlotRating(const int32 Slot) const;
+
+	/**
+	 * @brief A player's smoothed rating after their last match, or the prior if they never played.
+	 */
+	FOpenSkillRating GetRating(const int32 Player) const;
+
+	/**
+	 * @brief A player's slots in time order.
+	 */
+	TArrayView<const int32> GetPlayerSlots(const int32 Player) const
+	{
+		return TArrayView<const int32>(PlayerSlots.GetData() + PlayerSlotOffsets[Player], PlayerSlotOffsets[Player + 1] - PlayerSlotOffsets[Player]);
+	}
+
+	int32 GetNumLevels() const
+	{
+		return LevelOffsets.Num() - 1;
+	}
+
+private:
+	const FOpenSkillMatchHistory& History;
+	FOpenSkillCompiledOptions Snapshot;
+
+	// Per slot, the same player's previous and next slot or INDEX_NONE.
+	TArray<int32> PrevSlot;
+	TArray<int32> NextSlot;
+	TArray<FOpenSkillGaussianMessage> Forward;
+	TArray<FOpenSkillGaussianMessage> Backward;
+	TArray<FOpenSkillGaussianMessage> Likelihood;
+
+	TArray<int32> PlayerSlotOffsets;
+	TArray<int32> PlayerSlots;
+
+	// Matches grouped by level, LevelOffsets indexes LevelMatches.
+	TArray<int32> LevelOffsets;
+	TArray<int32> LevelMatches;
+
+	FOpenSkillGaussianMessage GetPrior() const;
+	FOpenSkillGaussianMessage Drift(const FOpenSkillGaussianMessage& Message) const;
+
+	// Refresh one level's incoming messages and likelihoods, returns the largest change of a posterior Mu.
+	double SweepLevel(const int32 Level, const bool bForward);
+	double UpdateMatch(const int32 Match, const bool bForward, TArray<TArray<FOpenSkillRating>>& Teams, TArray<int>& Ranks, TArray<FOpenSkillGaussianMessage>& Cavities);
+};
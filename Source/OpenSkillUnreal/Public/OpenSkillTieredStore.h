@@ -0,0 +1,178 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenSkillTypes.h"
+#include <atomic>
+
+class FOpenSkillUnrealModule;
+class FOpenSkillTieredStoreWorker;
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+struct OPENSKILLUNREAL_API FOpenSkillTieredStoreConfig
+{
+	// Players held in memory at once, everyone else stays in the file.
+	int32 HotCapacity = 1 << 20;
+	// Evicted ratings are written back once this many are waiting, sorted by player so a batch runs through the file in order.
+	int32 WriteBackBatchSize = 4096;
+};
+
+struct OPENSKILLUNREAL_API FOpenSkillTieredStoreStats
+{
+	// Reads answered from memory.
+	uint64 Hits = 0;
+	// Reads that had to go to the file, on the calling thread for GetRatings and on the worker for FetchRatings.
+	uint64 Misses = 0;
+	// Players loaded into memory by Prefetch before anyone asked for them.
+	uint64 Prefetches = 0;
+	uint64 Evictions = 0;
+	// Ratings written to the file and the number of batches they took.
+	uint64 WriteBacks = 0;
+	uint64 WriteBatches = 0;
+};
+
+/**
+ * Every registered player's rating in a file, fronted by a fixed size in-memory tier holding only the players who are
+ * currently playing, so memory follows the active population rather than the registered one.
+ *
+ * The file is a flat table of 16 byte Mu and Sigma pairs indexed by player, so player IDs must be dense row numbers.
+ * Rows past the end of the file read as the module's default rating, and the file grows when they are written back.
+ * Reads go through a read-only memory mapping, or plain file reads on platforms without one.
+ *
+ * The hot tier keeps Mu and Sigma in separate contiguous slabs with a referenced and a dirty flag per slot, and makes
+ * room with the clock algorithm. Dirty players pushed out are queued for write-back, and a background worker writes
+ * them in batches, dropping the mapping for the length of a batch so the same code runs on platforms that cannot write
+ * to a mapped file. The worker also loads players ahead of time for Prefetch and answers FetchRatings misses.
+ *
+ * All methods are safe to call from any thread. A player's latest rating is always the one returned, whether it is in
+ * memory, waiting for write-back or in the file.
+ */
+class OPENSKILLUNREAL_API FOpenSkillTieredStore
+{
+public:
+	/** Called with the ratings in the order the players were passed, on the calling thread if all were in memory, otherwise on the worker. */
+	typedef TFunction<void(TArray<FOpenSkillRating>&& Ratings)> FOnFetched;
+
+	/**
+	 * @param Module Supplies the default rating of players the file does not hold yet.
+	 * @param InPath The player table, created if it does not exist.
+	 * @param InConfig Hot tier size and write-back batching.
+	 */
+	FOpenSkillTieredStore(const FOpenSkillUnrealModule& Module, const FString& InPath, const FOpenSkillTieredStoreConfig& InConfig = FOpenSkillTieredStoreConfig());
+	~FOpenSkillTieredStore();
+
+	FOpenSkillTieredStore(const FOpenSkillTieredStore&) = delete;
+	FOpenSkillTieredStore& operator=(const FOpenSkillTieredStore&) = delete;
+
+	/**
+	 * @brief Whether the file could be opened. If not the store still works, but anything pushed out of memory stays queued in memory.
+	 */
+	bool IsOpen() const
+	{
+		return bOpen;
+	}
+
+	/**
+	 * @brief The number of rows in the file, players past it have never been written back.
+	 */
+	int64 GetNumPlayers() const
+	{
+		return NumRows.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Read ratings, loading any player not in memory from the file on this thread.
+	 * @param Players The players to read.
+	 * @param OutRatings Receives one rating per player.
+	 */
+	void GetRatings(TArrayView<const FOpenSkillPlayerId> Players, TArrayView<FOpenSkillRating> OutRatings);
+
+	FOpenSkillRating GetRating(const FOpenSkillPlayerId Player);
+
+	/**
+	 * @brief Overwrite ratings in memory, they reach the file when pushed out or on Flush.
+	 * @param Players The players to write.
+	 * @param Ratings One rating per player.
+	 */
+	void SetRatings(TArrayView<const FOpenSkillPlayerId> Players, TArrayView<const FOpenSkillRating> Ratings);
+
+	void SetRating(const FOpenSkillPlayerId Player, const FOpenSkillRating& Rating);
+
+	/**
+	 * @brief Read ratings without blocking on the file. Players not in memory are loaded by the worker.
+	 * @param Players The players to read.
+	 * @param OnFetched Receives the ratings.
+	 */
+	void FetchRatings(TArray<FOpenSkillPlayerId> Players, FOnFetched OnFetched);
+
+	/**
+	 * @brief Start loading players into memory, e.g. as they enter the matchmaking queue, so the match they end up in hits.
+	 */
+	void Prefetch(TArrayView<const FOpenSkillPlayerId> Players);
+
+	/**
+	 * @brief Block until every queued fetch is done and every rating changed so far is in the file.
+	 */
+	void Flush();
+
+	FOpenSkillTieredStoreStats GetStats() const;
+
+	/**
+	 * @brief Memory held by the hot tier and the write-back queue, the file and its mapping are not counted.
+	 */
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	friend class FOpenSkillTieredStoreWorker;
+
+	enum : uint8
+	{
+		SlotReferenced = 1 << 0,
+		SlotDirty = 1 << 1
+	};
+
+	const FString Path;
+	const FOpenSkillTieredStoreConfig Config;
+	const FOpenSkillRating DefaultRating;
+	bool bOpen = false;
+
+	// Hot tier and write-back queue.
+	mutable FCriticalSection HotLock;
+	TArray<double> Mus;
+	TArray<double> Sigmas;
+	TArray<FOpenSkillPlayerId> SlotPlayers;
+	TArray<uint8> SlotFlags;
+	TMap<FOpenSkillPlayerId, int32> Slots;
+	int32 ClockHand = 0;
+	// Ratings pushed out of memory but not written yet, and the batch the worker is writing now.
+	TMap<FOpenSkillPlayerId, FOpenSkillRating> PendingWrites;
+	TMap<FOpenSkillPlayerId, FOpenSkillRating> WritingBatch;
+	bool bWriteBackQueued = false;
+	// Bumped whenever a write-back batch starts, so a file read that raced one is retried.
+	uint64 WriteGeneration = 0;
+	FOpenSkillTieredStoreStats Stats;
+
+	// Cold tier, the mapping is dropped and remade around every write-back batch.
+	mutable FRWLock ColdLock;
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	std::atomic<int64> NumRows;
+
+	TUniquePtr<FOpenSkillTieredStoreWorker> Worker;
+
+	/**
+	 * Answer what the hot tier and write-back queue can and load the rest from the file. Must not hold HotLock.
+	 * @param bPrefetch Count loads as prefetches and do not count hits.
+	 */
+	void Resolve(TArrayView<const FOpenSkillPlayerId> Players, TArrayView<FOpenSkillRating> OutRatings, bool bPrefetch);
+
+	// HotLock must be held. Returns the player's slot, bringing the latest rating into memory from the queue or Loaded.
+	int32 FindOrAddSlot(const FOpenSkillPlayerId Player, const FOpenSkillRating* Loaded);
+	int32 AllocateSlot();
+
+	void ReadCold(TArrayView<const FOpenSkillPlayerId> Players, TArrayView<FOpenSkillRating> OutRatings) const;
+	void OpenMapping();
+
+	// Worker only. Moves every dirty slot into the write-back queue when bAll is set.
+	void WriteBack(bool bAll);
+};
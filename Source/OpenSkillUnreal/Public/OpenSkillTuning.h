@@ -0,0 +1,47 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenSkillOptions.h"
+
+class FOpenSkillMatchHistory;
+
+/**
+ * One option set to evaluate. Model replaces Options.Model, the rest of Options is used as is.
+ */
+struct OPENSKILLUNREAL_API FOpenSkillTuningCandidate
+{
+	EOpenSkillModel Model = EOpenSkillModel::PlackettLuce;
+	FOpenSkillOptions Options;
+};
+
+struct OPENSKILLUNREAL_API FOpenSkillTuningResult
+{
+	// Index into the candidates passed to Search.
+	int32 Candidate = INDEX_NONE;
+	// Mean negative log of the probability PredictWin gave the best placed team, before the match was rated.
+	double LogLoss = 0;
+};
+
+/**
+ * Replays a match history under many option sets at once. Every candidate keeps its own rating column, candidates are
+ * evaluated in blocks whose columns sit interleaved per player, and the blocks advance through the history together one
+ * window of matches at a time, so the match data is read once per window for all of them while the blocks run in parallel.
+ */
+class OPENSKILLUNREAL_API FOpenSkillTuning
+{
+public:
+	/**
+	 * @brief Score every candidate by predictive log loss over the history.
+	 * @param History The matches to replay, every player starts at the candidate's Mu/Sigma.
+	 * @param Candidates The option sets to evaluate.
+	 * @param MaxResults The number of results to return, the best first.
+	 * @return The best candidates by ascending log loss.
+	 */
+	static TArray<FOpenSkillTuningResult> Search(const FOpenSkillMatchHistory& History, TArrayView<const FOpenSkillTuningCandidate> Candidates, const int32 MaxResults);
+
+	/**
+	 * @brief Build the cross product of the given values on top of the default options.
+	 * @return Models.Num() * Betas.Num() * Taus.Num() * Kappas.Num() candidates.
+	 */
+	static TArray<FOpenSkillTuningCandidate> MakeGrid(TArrayView<const EOpenSkillModel> Models, TArrayView<const double> Betas, TArrayView<const double> Taus, TArrayView<const double> Kappas);
+};
@@ -0,0 +1,139 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/StaticArray.h"
+#include "OpenSkillOptions.h"
+#include "OpenSkillTypes.h"
+
+// Gamma for the fixed-arity kernels, the same as FOpenSkillModeling::DefaultGamma but over a view of the team so no array has to be built.
+struct FOpenSkillDefaultTeamGamma
+{
+	double operator()(const double C, const double K, const double Mu, const double SigmaSq, TArrayView<const FOpenSkillRating> Team, const double Rank) const
+	{
+		return FMath::Sqrt(SigmaSq) / C;
+	}
+};
+
+// Team level result of a two team update, spread over the members like FOpenSkillModeling::ApplyTeamUpdate.
+struct FOpenSkillTwoTeamUpdate
+{
+	double OmegaA = 0;
+	double DeltaA = 0;
+	double OmegaB = 0;
+	double DeltaB = 0;
+};
+
+/**
+ * Closed-form kernels for matches between exactly two teams. They produce the same ratings as RateByRank with the
+ * same model, without the nested arrays, sorting or model dispatch of the general path and without allocating.
+ * Options.Gamma cannot be called without building an array, so a gamma functor is passed instead, defaulting to DefaultGamma.
+ */
+class OPENSKILLUNREAL_API FOpenSkillTwoTeam
+{
+public:
+	/**
+	 * @brief Rate a two team match in place.
+	 * @param Model The model to use.
+	 * @param TeamA The first team, updated in place.
+	 * @param TeamB The second team, updated in place.
+	 * @param RankA The first team's rank, lower is better.
+	 * @param RankB The second team's rank, equal ranks are a draw.
+	 * @param Options Mu/Sigma defaults are unused, everything else applies as in RateByRank.
+	 * @param Gamma Called as Gamma(C, 2, TeamMu, TeamSigmaSq, TeamView, TeamRank).
+	 */
+	template <uint32 SizeA, uint32 SizeB, typename GammaType = FOpenSkillDefaultTeamGamma>
+	static void Rate(const EOpenSkillModel Model, TStaticArray<FOpenSkillRating, SizeA>& TeamA, TStaticArray<FOpenSkillRating, SizeB>& TeamB,
+	                 const int RankA, const int RankB, const FOpenSkillOptions& Options, const GammaType& Gamma = GammaType());
+
+	/**
+	 * @brief Rate a stream of independent 1v1 matches in place.
+	 * @param Model The model to use.
+	 * @param Winners The first player of every duel.
+	 * @param Losers The second player of every duel, same length as Winners.
+	 * @param Draws Optional, one flag per duel that ended in a draw. Empty means no draws.
+	 * @param Options The options, as in RateByRank.
+	 */
+	static void RateDuels(const EOpenSkillModel Model, TArrayView<FOpenSkillRating> Winners, TArrayView<FOpenSkillRating> Losers, TArrayView<const bool> Draws, const FOpenSkillOptions& Options);
+
+	/**
+	 * @brief The team level Omega/Delta for two teams from their summed Mu and SigmaSq.
+	 * @param RankA 0 if team A placed first or drew, 1 otherwise. RankB likewise.
+	 * @param GammaA Team A's gamma, evaluated at GetGammaC.
+	 */
+	static FOpenSkillTwoTeamUpdate ComputeUpdate(const EOpenSkillModel Model, const double MuA, const double SigmaSqA, const double MuB, const double SigmaSqB,
+	                                             const int RankA, const int RankB, const double GammaA, const double GammaB, const FOpenSkillOptions& Options);
+
+	// The C the model passes to gamma for two teams whose summed variances are SigmaSqA and SigmaSqB.
+	static double GetGammaC(const EOpenSkillModel Model, const double SigmaSqA, const double SigmaSqB, const FOpenSkillOptions& Options);
+
+private:
+	template <uint32 Size>
+	static void SumTeam(TStaticArray<FOpenSkillRating, Size>& Team, const FOpenSkillOptions& Options, double& OutMu, double& OutSigmaSq, TStaticArray<double, Size>& OutPriorSigma);
+
+	template <uint32 Size>
+	static void ApplyUpdate(TStaticArray<FOpenSkillRating, Size>& Team, const double TeamSigmaSq, const double Omega, const double Delta,
+	                        const FOpenSkillOptions& Options, const TStaticArray<double, Size>& PriorSigma);
+};
+
+template <uint32 SizeA, uint32 SizeB, typename GammaType>
+void FOpenSkillTwoTeam::Rate(const EOpenSkillModel Model, TStaticArray<FOpenSkillRating, SizeA>& TeamA, TStaticArray<FOpenSkillRating, SizeB>& TeamB,
+                             const int RankA, const int RankB, const FOpenSkillOptions& Options, const GammaType& Gamma)
+{
+	double MuA;
+	double SigmaSqA;
+	double MuB;
+	double SigmaSqB;
+	TStaticArray<double, SizeA> PriorSigmaA;
+	TStaticArray<double, SizeB> PriorSigmaB;
+	SumTeam(TeamA, Options, MuA, SigmaSqA, PriorSigmaA);
+	SumTeam(TeamB, Options, MuB, SigmaSqB, PriorSigmaB);
+
+	// Same ranks GetRankings hands the models once the teams are sorted.
+	const int ModelRankA = RankA <= RankB ? 0 : 1;
+	const int ModelRankB = RankB <= RankA ? 0 : 1;
+
+	const double GammaC = GetGammaC(Model, SigmaSqA, SigmaSqB, Options);
+	const double GammaA = Gamma(GammaC, 2, MuA, SigmaSqA, TArrayView<const FOpenSkillRating>(TeamA.GetData(), SizeA), ModelRankA);
+	const double GammaB = Gamma(GammaC, 2, MuB, SigmaSqB, TArrayView<const FOpenSkillRating>(TeamB.GetData(), SizeB), ModelRankB);
+
+	const FOpenSkillTwoTeamUpdate Update = ComputeUpdate(Model, MuA, SigmaSqA, MuB, SigmaSqB, ModelRankA, ModelRankB, GammaA, GammaB, Options);
+	ApplyUpdate(TeamA, SigmaSqA, Update.OmegaA, Update.DeltaA, Options, PriorSigmaA);
+	ApplyUpdate(TeamB, SigmaSqB, Update.OmegaB, Update.DeltaB, Options, PriorSigmaB);
+}
+
+template <uint32 Size>
+void FOpenSkillTwoTeam::SumTeam(TStaticArray<FOpenSkillRating, Size>& Team, const FOpenSkillOptions& Options, double& OutMu, double& OutSigmaSq, TStaticArray<double, Size>& OutPriorSigma)
+{
+	const double TauSquared = Options.Tau > 0 ? FMath::Square(Options.Tau) : 0;
+	OutMu = 0;
+	OutSigmaSq = 0;
+	for (uint32 i = 0; i < Size; ++i)
+	{
+		FOpenSkillRating& Member = Team[i];
+		if (Options.Tau > 0)
+		{
+			Member.Sigma = FMath::Sqrt(FMath::Square(Member.Sigma) + TauSquared);
+		}
+		OutPriorSigma[i] = Member.Sigma;
+		OutMu += Member.Mu;
+		OutSigmaSq += FMath::Square(Member.Sigma);
+	}
+}
+
+template <uint32 Size>
+void FOpenSkillTwoTeam::ApplyUpdate(TStaticArray<FOpenSkillRating, Size>& Team, const double TeamSigmaSq, const double Omega, const double Delta,
+                                    const FOpenSkillOptions& Options, const TStaticArray<double, Size>& PriorSigma)
+{
+	const bool bClampSigma = Options.Tau > 0 && Options.PreventSigmaIncrease;
+	for (uint32 i = 0; i < Size; ++i)
+	{
+		FOpenSkillRating& Member = Team[i];
+		const double Share = FMath::Square(Member.Sigma) / TeamSigmaSq;
+		Member.Mu += Share * Omega;
+		Member.Sigma *= FMath::Sqrt(FMath::Max(1 - Share * Delta, Options.Kappa));
+		if (bClampSigma)
+		{
+			Member.Sigma = FMath::Min(Member.Sigma, PriorSigma[i]);
+		}
+	}
+}
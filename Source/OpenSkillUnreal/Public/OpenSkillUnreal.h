@@ -1,82 +1,198 @@
-﻿// Copyright Epic Games, Inc. All Rights Reserved.
-
-#pragma once
-
-#include "CoreMinimal.h"
-#include "OpenSkillTypes.h"
-#include "OpenSkillOptions.h"
-#include "Modules/ModuleManager.h"
-
-class OPENSKILLUNREAL_API FOpenSkillUnrealModule : public IModuleInterface
-{
-public:
-	static FOpenSkillUnrealModule& Get()
-	{
-		return FModuleManager::LoadModuleChecked<FOpenSkillUnrealModule>("OpenSkillUnreal");
-	}
-
-	const FOpenSkillOptions& GetOptions() const
-	{
-		return Options;
-	}
-
-	void SetOptions(const FOpenSkillOptions& InOptions)
-	{
-		this->Options = InOptions;
-	}
-
-	/**
-	 * @brief Rate applies match results to team members and returns their new skill scores.
-	 * @param Teams The teams in place order (Teams[0] = 1st place, Teams[1] = 2nd place, etc.)
-	 * @return The adjusted skill scoring based on placement.
-	 */
-	TArray<TArray<FOpenSkillRating>> RateByOrdinal(const TArray<TArray<FOpenSkillRating>>& Teams) const;
-	/**
-	 * @brief Rate applies match results to team members and returns their new skill scores.
-	 * @param Teams An array of team and rank tuples. Multiple teams may have the same rank, lower values mean better placement in the ranking.
-	 * @return The adjusted skill scoring based on placement.
-	 */
-	TArray<TArray<FOpenSkillRating>> RateByRank(const TArray<TTuple<TArray<FOpenSkillRating>, int>>& Teams) const;
-
-	/**
-	 * @brief Rate applies match results to team members and returns their new skill scores.
-	 * @param Teams An array of team and game score tuples. Multiple teams may have the same score, higher values mean better placement in the ranking.
-	 * @return The adjusted skill scoring based on placement.
-	 */
-	TArray<TArray<FOpenSkillRating>> RateByScore(const TArray<TTuple<TArray<FOpenSkillRating>, int>>& Teams) const;
-
-	/**
-	 * @brief PredictWin predicts how likely a match up against teams of one or more agents will go.
-	 * @param Teams Two or more teams to evaluate.
-	 * @return The probabilities of each team winning.
-	 */
-	TArray<double> PredictWin(const TArray<TArray<FOpenSkillRating>>& Teams) const;
-
-	/**
-	 * @brief Predict how likely a match up against teams of one or more agents will draw. This is unlikely to actually end in a draw unless game rules permit such, but can be used as a proxy of skill evenness.
-	 * @param Teams Two or more teams to evaluate.
-	 * @return  the probability of the teams drawing.
-	 */
-	double PredictDraw(const TArray<TArray<FOpenSkillRating>>& Teams) const;
-
-	/**
-	 * @brief Predict the shape of a match outcome.
-	 * @param Teams Two or more teams to evaluate.
-	 * @return A list of team ranks with their probabilities.
-	 */
-	TArray<TTuple<int, double>> PredictRank(const TArray<TArray<FOpenSkillRating>>& Teams) const;
-
-	/**
-	 * @brief Convert `mu` and `sigma` into a single value for sorting purposes.
-	 * @param Rating The rating object.
-	 * @return A number that represents a 1 dimensional value for a rating.
-	 */
-	double GetOrdinal(const FOpenSkillRating& Rating) const;
-
-private:
-	FOpenSkillOptions Options;
-
-	TArray<TArray<FOpenSkillRating>> RateInternal(TArray<TArray<FOpenSkillRating>>&& Teams, TArray<int>&& Ranks, TArray<int>&& Weights) const;
-
-	static TArray<int> RankMinimum(const TArray<double>& A);
-};
+﻿// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "OpenSkillTypes.h"
+#include "OpenSkillOptions.h"
+#include "OpenSkillCompiledOptions.h"
+#include "OpenSkillPredictionCache.h"
+#include "OpenSkillLobbyBatch.h"
+#include "OpenSkillPlacement.h"
+#include "Modules/ModuleManager.h"
+#include <atomic>
+
+class OPENSKILLUNREAL_API FOpenSkillUnrealModule : public IModuleInterface
+{
+public:
+	static FOpenSkillUnrealModule& Get()
+	{
+		return FModuleManager::LoadModuleChecked<FOpenSkillUnrealModule>("OpenSkillUnreal");
+	}
+
+	FOpenSkillUnrealModule();
+	~FOpenSkillUnrealModule();
+
+	/**
+	 * @brief A copy of the current options, it does not change if SetOptions is called afterwards. Hot paths should read
+	 * GetCompiledOptions()->Options instead, copying the options copies the Model and Gamma functions.
+	 */
+	FOpenSkillOptions GetOptions() const
+	{
+		return GetCompiledOptions()->Options;
+	}
+
+	/**
+	 * @brief The rating new players start at, Mu and Sigma of the current options.
+	 */
+	FOpenSkillRating GetDefaultRating() const
+	{
+		const FOpenSkillCompiledOptionsPin Snapshot = GetCompiledOptions();
+		return FOpenSkillRating(Snapshot->Options.Mu, Snapshot->Options.Sigma);
+	}
+
+	/**
+	 * @brief Pin the current options snapshot without taking a lock. Every rating and prediction call holds one for its whole duration, a snapshot replaced by SetOptions is freed once every pin that could see it is released.
+	 */
+	FOpenSkillCompiledOptionsPin GetCompiledOptions() const
+	{
+		return FOpenSkillCompiledOptionsPin(CompiledOptions);
+	}
+
+	/**
+	 * @brief Publish new options. Safe to call while other threads are rating or predicting, calls already running finish with the options they started with.
+	 * @param InOptions The options to use from now on.
+	 */
+	void SetOptions(const FOpenSkillOptions& InOptions);
+
+	/**
+	 * @brief Put a bounded LRU cache in front of PredictWin, PredictDraw and PredictRank. Not thread-safe, call during setup.
+	 * @param MaxEntries The number of predictions to keep, 0 disables the cache.
+	 */
+	void SetPredictionCacheSize(const int32 MaxEntries)
+	{
+		PredictionCache.Reset(MaxEntries > 0 ? new FOpenSkillPredictionCache(MaxEntries) : nullptr);
+	}
+
+	/**
+	 * @brief The prediction cache, for its hit and miss counters. Null unless enabled with SetPredictionCacheSize.
+	 */
+	const FOpenSkillPredictionCache* GetPredictionCache() const
+	{
+		return PredictionCache.Get();
+	}
+
+	/**
+	 * @brief Rate applies match results to team members and returns their new skill scores.
+	 * @param Teams The teams in place order (Teams[0] = 1st place, Teams[1] = 2nd place, etc.)
+	 * @return The adjusted skill scoring based on placement.
+	 */
+	TArray<TArray<FOpenSkillRating>> RateByOrdinal(const TArray<TArray<FOpenSkillRating>>& Teams) const;
+	/**
+	 * @brief RateByOrdinal that takes ownership of Teams and reuses its storage for the result instead of copying it.
+	 */
+	TArray<TArray<FOpenSkillRating>> RateByOrdinal(TArray<TArray<FOpenSkillRating>>&& Teams) const;
+	/**
+	 * @brief Rate applies match results to team members and returns their new skill scores.
+	 * @param Teams An array of team and rank tuples. Multiple teams may have the same rank, lower values mean better placement in the ranking.
+	 * @return The adjusted skill scoring based on placement.
+	 */
+	TArray<TArray<FOpenSkillRating>> RateByRank(const TArray<TTuple<TArray<FOpenSkillRating>, int>>& Teams) const;
+	/**
+	 * @brief RateByRank that moves the teams out of Teams instead of copying them.
+	 */
+	TArray<TArray<FOpenSkillRating>> RateByRank(TArray<TTuple<TArray<FOpenSkillRating>, int>>&& Teams) const;
+
+	/**
+	 * @brief Rate applies match results to team members and returns their new skill scores.
+	 * @param Teams An array of team and game score tuples. Multiple teams may have the same score, higher values mean better placement in the ranking.
+	 * @return The adjusted skill scoring based on placement.
+	 */
+	TArray<TArray<FOpenSkillRating>> RateByScore(const TArray<TTuple<TArray<FOpenSkillRating>, int>>& Teams) const;
+	/**
+	 * @brief RateByScore that moves the teams out of Teams instead of copying them.
+	 */
+	TArray<TArray<FOpenSkillRating>> RateByScore(TArray<TTuple<TArray<FOpenSkillRating>, int>>&& Teams) const;
+
+	/**
+	 * @brief Rate a match and write the new skill scores back over the players' current ones, without building the nested arrays RateByRank takes and returns.
+	 * @param Teams A view of each team's ratings, updated in place.
+	 * @param Ranks One rank per team. Multiple teams may have the same rank, lower values mean better placement in the ranking.
+	 */
+	void RateInPlace(TArrayView<const TArrayView<FOpenSkillRating>> Teams, TArrayView<const int> Ranks) const;
+
+	/**
+	 * @brief PredictWin predicts how likely a match up against teams of one or more agents will go.
+	 * @param Teams Two or more teams to evaluate.
+	 * @return The probabilities of each team winning.
+	 */
+	TArray<double> PredictWin(const TArray<TArray<FOpenSkillRating>>& Teams) const;
+
+	/**
+	 * @brief Predict how likely a match up against teams of one or more agents will draw. This is unlikely to actually end in a draw unless game rules permit such, but can be used as a proxy of skill evenness.
+	 * @param Teams Two or more teams to evaluate.
+	 * @return  the probability of the teams drawing.
+	 */
+	double PredictDraw(const TArray<TArray<FOpenSkillRating>>& Teams) const;
+
+	/**
+	 * @brief PredictDraw for many candidate lobbies at once, as a match quality score. Every team's aggregate is computed once however many lobbies share it, then the lobbies are evaluated in parallel.
+	 * @param Lobbies The candidate lobbies, their players index into Ratings.
+	 * @param Ratings The player rating table.
+	 * @param OutQuality Receives the draw probability of every lobby, one per lobby.
+	 */
+	void PredictDrawBatch(const FOpenSkillLobbyBatch& Lobbies, TArrayView<const FOpenSkillRating> Ratings, TArrayView<double> OutQuality) const;
+
+	/**
+	 * @brief Predict the shape of a match outcome.
+	 * @param Teams Two or more teams to evaluate.
+	 * @return A list of team ranks with their probabilities.
+	 */
+	TArray<TTuple<int, double>> PredictRank(const TArray<TArray<FOpenSkillRating>>& Teams) const;
+
+	/**
+	 * @brief Estimate the full placement distribution by sampling every team's performance from N(Mu, SigmaSq + Beta^2), see FOpenSkillPlacement.
+	 * @param Teams Two or more teams to evaluate.
+	 * @param Config Sample count, accuracy target and seed.
+	 * @return P(team i finishes in place k) for every team and place, with 95% confidence bounds.
+	 */
+	FOpenSkillPlacementMatrix PredictPlacements(const TArray<TArray<FOpenSkillRating>>& Teams, const FOpenSkillPlacementConfig& Config = FOpenSkillPlacementConfig()) const;
+
+	/**
+	 * @brief Convert `mu` and `sigma` into a single value for sorting purposes.
+	 * @param Rating The rating object.
+	 * @return A number that represents a 1 dimensional value for a rating.
+	 */
+	double GetOrdinal(const FOpenSkillRating& Rating) const;
+
+	/**
+	 * @brief Convert columns of `mu` and `sigma` into ordinals in bulk, see FOpenSkillLeaderboard for sorting and tiering them.
+	 * @param Mu The Mu column.
+	 * @param Sigma The Sigma column, same length as Mu.
+	 * @param OutOrdinals Receives one ordinal per rating, same length as Mu.
+	 */
+	void GetOrdinals(TArrayView<const double> Mu, TArrayView<const double> Sigma, TArrayView<double> OutOrdinals) const;
+
+private:
+	// Owned by the module, readers pin it through GetCompiledOptions.
+	std::atomic<const FOpenSkillCompiledOptions*> CompiledOptions;
+	// A replaced snapshot and the epoch it was retired in, freed by a later SetOptions once no pin can see it.
+	struct FRetiredOptions
+	{
+		FRetiredOptions(const uint64 InEpoch, const FOpenSkillCompiledOptions* InSnapshot)
+			: Epoch(InEpoch)
+			, Snapshot(InSnapshot)
+		{
+		}
+
+		uint64 Epoch;
+		TUniquePtr<const FOpenSkillCompiledOptions> Snapshot;
+	};
+	TArray<FRetiredOptions> RetiredOptions;
+	// Serializes SetOptions, readers never take it.
+	FCriticalSection OptionsLock;
+	TUniquePtr<FOpenSkillPredictionCache> PredictionCache;
+
+	TArray<double> PredictWinInternal(const TArray<TArray<FOpenSkillRating>>& Teams, const FOpenSkillCompiledOptions& Snapshot) const;
+	double PredictDrawInternal(const TArray<TArray<FOpenSkillRating>>& Teams, const FOpenSkillCompiledOptions& Snapshot) const;
+	TArray<TTuple<int, double>> PredictRankInternal(const TArray<TArray<FOpenSkillRating>>& Teams, const FOpenSkillCompiledOptions& Snapshot) const;
+
+	TArray<TArray<FOpenSkillRating>> RateInternal(TArray<TArray<FOpenSkillRating>>&& Teams, TArray<int>&& Ranks, TArray<int>&& Weights) const;
+	// Applies Tau to teams already sorted by rank, runs the model and clamps sigma, the new ratings come back in the same order.
+	TArray<TArray<FOpenSkillRating>> RateOrdered(TArray<TArray<FOpenSkillRating>>& OrderedTeams, const TArray<int>& OrderedRanks, const FOpenSkillCompiledOptions& Snapshot) const;
+
+	// Team indices stably sorted by rank, so tied teams keep their submission order.
+	static TArray<int> GetRankOrder(TArrayView<const int> Ranks);
+
+	static TArray<int> RankMinimum(const TArray<double>& A);
+};
@@ -0,0 +1,21 @@
+﻿using System.IO;
+using UnrealBuildTool;
+
+public class OpenSkillWorker : ModuleRules
+{
+	public OpenSkillWorker(ReadOnlyTargetRules Target) : base(Target)
+	{
+		// For RequiredProgramMainCPPInclude.h and the engine loop it pulls in.
+		PublicIncludePaths.Add(Path.Combine(EngineDirectory, "Source/Runtime/Launch/Public"));
+		PrivateIncludePaths.Add(Path.Combine(EngineDirectory, "Source/Runtime/Launch/Private"));
+
+		PrivateDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Core",
+				"Projects",
+				"OpenSkillUnreal",
+			}
+		);
+	}
+}
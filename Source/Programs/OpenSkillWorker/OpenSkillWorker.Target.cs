@@ -0,0 +1,26 @@
+﻿using UnrealBuildTool;
+
+[SupportedPlatforms(UnrealPlatformClass.Desktop)]
+public class OpenSkillWorkerTarget : TargetRules
+{
+	public OpenSkillWorkerTarget(TargetInfo Target) : base(Target)
+	{
+		Type = TargetType.Program;
+		LinkType = TargetLinkType.Monolithic;
+		LaunchModuleName = "OpenSkillWorker";
+
+		// Core and the rating module, nothing else.
+		bCompileAgainstEngine = false;
+		bCompileAgainstCoreUObject = false;
+		bCompileAgainstApplicationCore = false;
+		bBuildDeveloperTools = false;
+		bBuildWithEditorOnlyData = false;
+		bUseMallocProfiler = false;
+		bCompileICU = false;
+
+		bCompileWithPluginSupport = true;
+		EnablePlugins.Add("OpenSkillUnreal");
+
+		bIsBuildingConsoleApplication = true;
+	}
+}
@@ -0,0 +1,106 @@
+﻿#include "RequiredProgramMainCPPInclude.h"
+#include "OpenSkillLoadTest.h"
+#include "OpenSkillSimulation.h"
+#include "OpenSkillUnreal.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogOpenSkillWorker, Log, All);
+
+IMPLEMENT_APPLICATION(OpenSkillWorker, "OpenSkillWorker");
+
+namespace OpenSkillWorker
+{
+	bool ParseConfig(const TCHAR* CommandLine, FOpenSkillSimulationConfig& OutConfig)
+	{
+		FString Format;
+		if (FParse::Value(CommandLine, TEXT("Format="), Format) && !FOpenSkillSimulationConfig::FromName(Format, OutConfig))
+		{
+			UE_LOG(LogOpenSkillWorker, Error, TEXT("Unknown match format '%s', expected 1v1, 5v5, Squads or FFA."), *Format);
+			return false;
+		}
+		FParse::Value(CommandLine, TEXT("Seed="), OutConfig.Seed);
+		FParse::Value(CommandLine, TEXT("Matches="), OutConfig.NumMatches);
+		FParse::Value(CommandLine, TEXT("Population="), OutConfig.PopulationSize);
+		return true;
+	}
+
+	int32 Simulate(const TCHAR* CommandLine)
+	{
+		FOpenSkillSimulationConfig Config = FOpenSkillSimulationConfig::Duel();
+		if (!ParseConfig(CommandLine, Config))
+		{
+			return 1;
+		}
+
+		const FOpenSkillSimulation Simulation(Config);
+		for (int Model = 0; Model < static_cast<int>(EOpenSkillModel::Count); ++Model)
+		{
+			FOpenSkillOptions Options;
+			Options.Model = FOpenSkillModeling::GetModel(static_cast<EOpenSkillModel>(Model));
+			FOpenSkillUnrealModule Module;
+			Module.SetOptions(Options);
+
+			const FOpenSkillSimulationReport Report = Simulation.Run(Module);
+			UE_LOG(LogOpenSkillWorker, Display, TEXT("%-26s %9.0f matches/s  log loss %.4f  rank correlation %.4f"),
+			       FOpenSkillModeling::GetModelName(static_cast<EOpenSkillModel>(Model)), Report.MatchesPerSecond, Report.LogLoss, Report.RankCorrelation);
+		}
+		return 0;
+	}
+
+	int32 LoadTest(const TCHAR* CommandLine)
+	{
+		FOpenSkillLoadTestConfig Config;
+		if (!ParseConfig(CommandLine, Config.Match))
+		{
+			return 1;
+		}
+		FParse::Value(CommandLine, TEXT("Threads="), Config.NumThreads);
+		Config.NumThreads = FMath::Max(Config.NumThreads, 1);
+		float Rate = static_cast<float>(Config.RequestsPerSecond);
+		FParse::Value(CommandLine, TEXT("Rate="), Rate);
+		Config.RequestsPerSecond = FMath::Max(Rate, 1.0f);
+		float Seconds = static_cast<float>(Config.DurationSeconds);
+		FParse::Value(CommandLine, TEXT("Seconds="), Seconds);
+		Config.DurationSeconds = FMath::Max(Seconds, 0.1f);
+
+		int32 CacheSize = 0;
+		FParse::Value(CommandLine, TEXT("PredictionCache="), CacheSize);
+		FOpenSkillUnrealModule Module;
+		Module.SetPredictionCacheSize(CacheSize);
+
+		const FOpenSkillLoadTestReport Report = FOpenSkillLoadTest::Run(Module, Config);
+		FOpenSkillLoadTest::LogReport(Report);
+		return Report.MissedRequests > 0 ? 2 : 0;
+	}
+}
+
+/**
+ * OpenSkillWorker -Mode=Simulate [-Format=1v1|5v5|Squads|FFA] [-Seed=N] [-Matches=N] [-Population=N]
+ * OpenSkillWorker -Mode=LoadTest [-Format=...] [-Threads=N] [-Rate=N] [-Seconds=N] [-PredictionCache=N]
+ */
+INT32_MAIN_INT32_ARGC_TCHAR_ARGV()
+{
+	GEngineLoop.PreInit(ArgC, ArgV);
+
+	const TCHAR* CommandLine = FCommandLine::Get();
+	FString Mode = TEXT("Simulate");
+	FParse::Value(CommandLine, TEXT("Mode="), Mode);
+
+	int32 Result = 1;
+	if (Mode.Equals(TEXT("Simulate"), ESearchCase::IgnoreCase))
+	{
+		Result = OpenSkillWorker::Simulate(CommandLine);
+	}
+	else if (Mode.Equals(TEXT("LoadTest"), ESearchCase::IgnoreCase))
+	{
+		Result = OpenSkillWorker::LoadTest(CommandLine);
+	}
+	else
+	{
+		UE_LOG(LogOpenSkillWorker, Error, TEXT("Unknown mode '%s', expected Simulate or LoadTest."), *Mode);
+	}
+
+	FEngineLoop::AppPreExit();
+	FModuleManager::Get().UnloadModulesAtShutdown();
+	FEngineLoop::AppExit();
+	return Result;
+}